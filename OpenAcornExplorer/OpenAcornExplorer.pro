@@ -23,24 +23,20 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 
+include(core.pri)
+
 SOURCES += \
         main.cpp \
-        mainwindow.cpp \
-    discimage.cpp \
-    adfsfreespacemap.cpp \
-    adfsdirectory.cpp \
+    mainwindow.cpp \
     aboutdialog.cpp \
     adfsdirectorymodel.cpp \
-    adfsdirectoryitem.cpp
+    discimageloader.cpp
 
 HEADERS += \
         mainwindow.h \
-    discimage.h \
-    adfsfreespacemap.h \
-    adfsdirectory.h \
     aboutdialog.h \
     adfsdirectorymodel.h \
-    adfsdirectoryitem.h
+    discimageloader.h
 
 FORMS += \
         mainwindow.ui \
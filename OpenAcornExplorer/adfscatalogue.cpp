@@ -0,0 +1,209 @@
+/************************************************************************
+
+    adfscatalogue.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "adfscatalogue.h"
+#include "logcategories.h"
+#include "tracerecorder.h"
+
+#include <QSet>
+
+AdfsCatalogue::AdfsCatalogue()
+{
+    numberOfDirectories = 0;
+}
+
+// Assemble the catalogue from directory records (keyed by directory sector)
+// Note: Directories are assembled breadth-first from the root so that the
+// children of every directory occupy a contiguous range of nodes
+void AdfsCatalogue::build(const QHash<qint64, AdfsDirectoryRecord> &directoryRecordsParam, qint64 rootDirectorySector)
+{
+    TraceScope trace("catalogue", "AdfsCatalogue::build");
+
+    clear();
+    directoryRecords = directoryRecordsParam;
+
+    if (!directoryRecords.contains(rootDirectorySector)) {
+        qCDebug(lcImage) << "AdfsCatalogue::build(): Root directory has not been read";
+        return;
+    }
+
+    // Create the root node from the root directory's own header.  The root is
+    // always named "$" (new format root directories hold the disc name instead)
+    const AdfsDirectoryRecord &rootRecord = directoryRecords[rootDirectorySector];
+    QByteArray rootName("$");
+
+    AdfsDirectoryEntry rootEntry;
+    rootEntry.nameOffset = 0;
+    rootEntry.nameLength = static_cast<quint8>(rootName.size());
+    rootEntry.attributes = AdfsDirectoryEntry::Directory | AdfsDirectoryEntry::Readable;
+    rootEntry.sequenceNumber = static_cast<quint8>(rootRecord.masterSequenceNumber);
+    rootEntry.loadAddress = 0;
+    rootEntry.executionAddress = 0;
+    rootEntry.length = 0;
+    rootEntry.startSector = static_cast<quint32>(rootDirectorySector);
+
+    addNode(&nodes, &nodeNames, rootEntry, rootName, -1, 0);
+
+    // Directories already expanded (a corrupt catalogue could otherwise loop)
+    QSet<qint64> expandedDirectories;
+
+    // Add the children of each directory node in turn (nodes appended whilst
+    // iterating are visited later, giving a breadth-first assembly)
+    for (qint32 nodeNumber = 0; nodeNumber < nodes.size(); nodeNumber++) {
+        if (!nodes[nodeNumber].isDirectory()) continue;
+        numberOfDirectories++;
+
+        // Directories that could not be read have no children
+        qint64 directorySector = nodes[nodeNumber].entry.startSector;
+        if (!directoryRecords.contains(directorySector)) continue;
+        if (expandedDirectories.contains(directorySector)) continue;
+        expandedDirectories.insert(directorySector);
+
+        addChildNodes(&nodes, &nodeNames, nodeNumber, directoryRecords[directorySector]);
+    }
+}
+
+// Remove all nodes from the catalogue
+void AdfsCatalogue::clear()
+{
+    nodes.clear();
+    nodeNames.clear();
+    directoryRecords.clear();
+    numberOfDirectories = 0;
+}
+
+qint64 AdfsCatalogue::getNumberOfNodes() const
+{
+    return nodes.size();
+}
+
+qint64 AdfsCatalogue::getNumberOfDirectories() const
+{
+    return numberOfDirectories;
+}
+
+qint64 AdfsCatalogue::getNumberOfFiles() const
+{
+    return nodes.size() - numberOfDirectories;
+}
+
+const AdfsCatalogueNode &AdfsCatalogue::getNode(qint64 nodeNumber) const
+{
+    return nodes.at(nodeNumber);
+}
+
+const QVector<AdfsCatalogueNode> &AdfsCatalogue::getNodes() const
+{
+    return nodes;
+}
+
+QString AdfsCatalogue::getNodeName(qint64 nodeNumber) const
+{
+    return nodeNames.getName(nodes.at(nodeNumber).entry);
+}
+
+// Get the full ADFS path of a node (e.g. "$.GAMES.ELITE")
+QString AdfsCatalogue::getNodePath(qint64 nodeNumber) const
+{
+    QString path = getNodeName(nodeNumber);
+
+    for (qint64 parent = nodes.at(nodeNumber).parent; parent >= 0; parent = nodes.at(parent).parent) {
+        path = getNodeName(parent) + "." + path;
+    }
+
+    return path;
+}
+
+// Get the directory records the catalogue was assembled from
+const QHash<qint64, AdfsDirectoryRecord> &AdfsCatalogue::getDirectoryRecords() const
+{
+    return directoryRecords;
+}
+
+// Append a node, adding its name to the name table.  The node's children are
+// not populated until added by addChildNodes()
+qint32 AdfsCatalogue::addNode(QVector<AdfsCatalogueNode> *nodes, AdfsNameTable *nodeNames, const AdfsDirectoryEntry &entry,
+                              const QByteArray &entryNames, qint32 parent, qint32 row)
+{
+    AdfsCatalogueNode node;
+    node.entry = entry;
+    node.entry.nameOffset = nodeNames->addName(entryNames.constData() + entry.nameOffset, entry.nameLength);
+    node.parent = parent;
+    node.firstChild = AdfsCatalogueNode::notPopulated;
+    node.childCount = 0;
+    node.row = row;
+
+    nodes->append(node);
+
+    return nodes->size() - 1;
+}
+
+// Append a node for every entry in a directory (so that the directory's
+// children are contiguous) and mark the directory node as populated
+void AdfsCatalogue::addChildNodes(QVector<AdfsCatalogueNode> *nodes, AdfsNameTable *nodeNames, qint32 nodeNumber,
+                                  const AdfsDirectoryRecord &directoryRecord)
+{
+    (*nodes)[nodeNumber].firstChild = nodes->size();
+    (*nodes)[nodeNumber].childCount = directoryRecord.entries.size();
+
+    qint32 row = 0;
+    for (const AdfsDirectoryEntry &entry : directoryRecord.entries) {
+        addNode(nodes, nodeNames, entry, directoryRecord.entryNames, nodeNumber, row++);
+    }
+}
+
+// Add a name to the table, returning the offset of the (possibly existing) name
+quint32 AdfsNameTable::addName(const char *name, qint32 length)
+{
+    QByteArray nameData(name, length);
+
+    QHash<QByteArray, quint32>::const_iterator i = nameOffsets.constFind(nameData);
+    if (i != nameOffsets.constEnd()) return i.value();
+
+    quint32 nameOffset = static_cast<quint32>(names.size());
+    nameOffsets.insert(nameData, nameOffset);
+    names.append(nameData);
+
+    return nameOffset;
+}
+
+QString AdfsNameTable::getName(const AdfsDirectoryEntry &entry) const
+{
+    return QString::fromLatin1(names.constData() + entry.nameOffset, entry.nameLength);
+}
+
+// Get the number of bytes held by the (distinct) names
+qint64 AdfsNameTable::size() const
+{
+    return names.size();
+}
+
+void AdfsNameTable::clear()
+{
+    names.clear();
+    nameOffsets.clear();
+}
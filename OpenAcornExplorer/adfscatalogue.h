@@ -0,0 +1,110 @@
+/************************************************************************
+
+    adfscatalogue.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef ADFSCATALOGUE_H
+#define ADFSCATALOGUE_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QHash>
+#include <QVector>
+
+#include "adfsdirectory.h"
+
+// A file or directory in the catalogue.  The entry's name offset refers to the
+// catalogue's name table; the children of a directory are stored contiguously
+struct AdfsCatalogueNode
+{
+    // First child of a node whose children have not been added (a file, or a
+    // directory that has not been read)
+    static const qint32 notPopulated = -1;
+
+    AdfsDirectoryEntry entry;
+    qint32 parent;          // Index of the parent node (-1 for the root directory)
+    qint32 firstChild;      // Index of the first child node
+    qint32 childCount;      // Number of child nodes
+    qint32 row;             // Position of the node within its parent
+
+    bool isDirectory() const { return entry.isDirectory(); }
+    bool isPopulated() const { return firstChild != notPopulated; }
+};
+
+// Table of the names of catalogue nodes.  Names are interned: each distinct name
+// is held once (catalogues hold many entries with the same name, such as "!Boot"
+// or "!Run") and nodes refer to it by offset and length
+class AdfsNameTable
+{
+public:
+    quint32 addName(const char *name, qint32 length);
+    QString getName(const AdfsDirectoryEntry &entry) const;
+    qint64 size() const;
+    void clear();
+
+private:
+    QByteArray names;
+    QHash<QByteArray, quint32> nameOffsets;
+};
+
+// The complete catalogue of an ADFS disc image, assembled from the directories
+// read from the image into a flat array of nodes.  The root directory is node 0
+// and the children of each directory are stored in directory order, so the
+// catalogue is identical however (and in whatever order) the directories were read
+class AdfsCatalogue
+{
+public:
+    AdfsCatalogue();
+
+    void build(const QHash<qint64, AdfsDirectoryRecord> &directoryRecordsParam, qint64 rootDirectorySector);
+    void clear();
+
+    qint64 getNumberOfNodes() const;
+    qint64 getNumberOfDirectories() const;
+    qint64 getNumberOfFiles() const;
+    const AdfsCatalogueNode &getNode(qint64 nodeNumber) const;
+    const QVector<AdfsCatalogueNode> &getNodes() const;
+    QString getNodeName(qint64 nodeNumber) const;
+    QString getNodePath(qint64 nodeNumber) const;
+
+    const QHash<qint64, AdfsDirectoryRecord> &getDirectoryRecords() const;
+
+    // Node assembly (shared with the directory model, which adds directories as they are read)
+    static qint32 addNode(QVector<AdfsCatalogueNode> *nodes, AdfsNameTable *nodeNames, const AdfsDirectoryEntry &entry,
+                          const QByteArray &entryNames, qint32 parent, qint32 row);
+    static void addChildNodes(QVector<AdfsCatalogueNode> *nodes, AdfsNameTable *nodeNames, qint32 nodeNumber,
+                              const AdfsDirectoryRecord &directoryRecord);
+
+private:
+    QVector<AdfsCatalogueNode> nodes;
+    AdfsNameTable nodeNames;
+    qint64 numberOfDirectories;
+
+    QHash<qint64, AdfsDirectoryRecord> directoryRecords;
+};
+
+Q_DECLARE_METATYPE(AdfsCatalogue)
+
+#endif // ADFSCATALOGUE_H
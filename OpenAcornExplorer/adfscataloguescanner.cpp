@@ -0,0 +1,249 @@
+/************************************************************************
+
+    adfscataloguescanner.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "adfscataloguescanner.h"
+#include "tracerecorder.h"
+
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+
+// Runs a scanner worker on a pool thread
+class AdfsCatalogueScanWorker : public QRunnable
+{
+public:
+    AdfsCatalogueScanWorker(AdfsCatalogueScanner *scannerParam, qint64 workerNumberParam)
+        : scanner(scannerParam), workerNumber(workerNumberParam) {}
+
+    void run() override { scanner->runWorker(workerNumber); }
+
+private:
+    AdfsCatalogueScanner *scanner;
+    qint64 workerNumber;
+};
+
+// Class constructor
+// Note: The ADFS image is shared by the workers, which read it concurrently
+AdfsCatalogueScanner::AdfsCatalogueScanner(AdfsImage *adfsImageParam)
+{
+    adfsImage = adfsImageParam;
+    maximumThreads = QThread::idealThreadCount();
+}
+
+AdfsCatalogueScanner::~AdfsCatalogueScanner()
+{
+    clearWorkQueues();
+}
+
+// Set the maximum number of worker threads (defaults to the number of cores)
+void AdfsCatalogueScanner::setMaximumThreads(qint64 maximumThreadsParam)
+{
+    maximumThreads = qMax(maximumThreadsParam, static_cast<qint64>(1));
+}
+
+// Set a function to be called as each directory is read (for example to report
+// progress); it is called from the worker threads
+void AdfsCatalogueScanner::setDirectoryCallback(DirectoryCallback directoryCallbackParam)
+{
+    directoryCallback = directoryCallbackParam;
+}
+
+// Read the whole catalogue and assemble it into the supplied catalogue object
+// Returns false if the root directory could not be read or the scan was stopped
+bool AdfsCatalogueScanner::scan(AdfsCatalogue *catalogue)
+{
+    TraceScope trace("catalogue", "AdfsCatalogueScanner::scan");
+
+    qint64 rootDirectorySector = adfsImage->getRootDirectorySector();
+
+    // Reset the scan state
+    clearWorkQueues();
+    directoryRecords.clear();
+    foundDirectories.clear();
+    statistics = AdfsCatalogueScanStatistics();
+    directoriesStolen.store(0);
+    stopRequested.store(0);
+
+    qint64 threads = qMax(maximumThreads, static_cast<qint64>(1));
+    for (qint64 workerNumber = 0; workerNumber < threads; workerNumber++) workQueues.append(new WorkQueue);
+
+    // Seed the first worker's queue with the root directory
+    foundDirectories.insert(rootDirectorySector);
+    workQueues[0]->directorySectors.append(rootDirectorySector);
+    pendingDirectories.store(1);
+    queuedDirectories.store(1);
+
+    // Run the workers until every directory has been read
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(static_cast<int>(threads));
+    for (qint64 workerNumber = 0; workerNumber < threads; workerNumber++) {
+        threadPool.start(new AdfsCatalogueScanWorker(this, workerNumber));
+    }
+    threadPool.waitForDone();
+
+    statistics.threads = threads;
+    statistics.directoriesStolen = directoriesStolen.load();
+    statistics.stopped = (stopRequested.load() != 0);
+
+    // Assemble the catalogue
+    catalogue->build(directoryRecords, rootDirectorySector);
+    clearWorkQueues();
+
+    return directoryRecords.contains(rootDirectorySector) && !statistics.stopped;
+}
+
+// Get the statistics for the last scan
+AdfsCatalogueScanStatistics AdfsCatalogueScanner::getStatistics()
+{
+    return statistics;
+}
+
+// Worker loop - read directories until there are none queued or being read (or
+// the scan is stopped)
+void AdfsCatalogueScanner::runWorker(qint64 workerNumber)
+{
+    qint64 directorySector;
+
+    while (!stopRequested.loadAcquire()) {
+        if (takeDirectory(workerNumber, &directorySector)) {
+            scanDirectory(workerNumber, directorySector);
+
+            // Sub-directories have already been counted, so this only reaches zero
+            // once the whole catalogue has been read
+            if (pendingDirectories.fetchAndAddOrdered(-1) == 1) wakeWorkers();
+            continue;
+        }
+
+        // Nothing to take; wait for another worker to queue more, and finish
+        // if no other worker can produce more work
+        QMutexLocker locker(&idleMutex);
+        while (queuedDirectories.loadAcquire() == 0 && pendingDirectories.loadAcquire() != 0 && !stopRequested.loadAcquire()) {
+            workAvailable.wait(&idleMutex);
+        }
+        if (pendingDirectories.loadAcquire() == 0) break;
+    }
+}
+
+// Private methods
+
+// Take a directory from the worker's own queue (most recently queued first), or
+// steal one from another worker's queue (least recently queued first)
+bool AdfsCatalogueScanner::takeDirectory(qint64 workerNumber, qint64 *directorySector)
+{
+    WorkQueue *ownQueue = workQueues[workerNumber];
+    {
+        QMutexLocker locker(&ownQueue->mutex);
+        if (!ownQueue->directorySectors.isEmpty()) {
+            *directorySector = ownQueue->directorySectors.takeLast();
+            queuedDirectories.fetchAndAddOrdered(-1);
+            return true;
+        }
+    }
+
+    for (qint64 offset = 1; offset < workQueues.size(); offset++) {
+        WorkQueue *victimQueue = workQueues[(workerNumber + offset) % workQueues.size()];
+
+        QMutexLocker locker(&victimQueue->mutex);
+        if (!victimQueue->directorySectors.isEmpty()) {
+            *directorySector = victimQueue->directorySectors.takeFirst();
+            queuedDirectories.fetchAndAddOrdered(-1);
+            directoriesStolen.fetchAndAddRelaxed(1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Read a directory, record it and queue any sub-directories not yet found
+void AdfsCatalogueScanner::scanDirectory(qint64 workerNumber, qint64 directorySector)
+{
+    AdfsDirectoryRecord directoryRecord;
+    bool directoryValid = adfsImage->readDirectoryRecord(directorySector, &directoryRecord);
+
+    QList<qint64> subDirectories;
+    {
+        QMutexLocker locker(&resultsMutex);
+
+        if (!directoryValid) {
+            statistics.directoriesInvalid++;
+            return;
+        }
+
+        statistics.directoriesRead++;
+
+        for (const AdfsDirectoryEntry &entry : directoryRecord.entries) {
+            if (entry.isDirectory() && !foundDirectories.contains(entry.startSector)) {
+                foundDirectories.insert(entry.startSector);
+                subDirectories.append(entry.startSector);
+            }
+        }
+
+        directoryRecords.insert(directorySector, directoryRecord);
+
+        if (directoryCallback && !directoryCallback(directoryRecord, statistics.directoriesRead + statistics.directoriesInvalid,
+                                                    foundDirectories.size())) {
+            stopRequested.storeRelease(1);
+        }
+    }
+
+    // Wake the idle workers so that they also stop
+    if (stopRequested.loadAcquire()) {
+        wakeWorkers();
+        return;
+    }
+
+    if (subDirectories.isEmpty()) return;
+
+    // Count the new work before it becomes visible to other workers
+    pendingDirectories.fetchAndAddOrdered(subDirectories.size());
+
+    WorkQueue *ownQueue = workQueues[workerNumber];
+    {
+        QMutexLocker locker(&ownQueue->mutex);
+        ownQueue->directorySectors.append(subDirectories);
+        queuedDirectories.fetchAndAddOrdered(subDirectories.size());
+    }
+
+    wakeWorkers();
+}
+
+// Wake the idle workers, either to take newly queued directories or to finish
+// once every directory has been read (or the scan is stopped).  Taking the idle mutex ensures a worker
+// that has just found nothing to take is already waiting
+void AdfsCatalogueScanner::wakeWorkers()
+{
+    QMutexLocker locker(&idleMutex);
+    workAvailable.wakeAll();
+}
+
+// Delete the per-worker queues
+void AdfsCatalogueScanner::clearWorkQueues()
+{
+    qDeleteAll(workQueues);
+    workQueues.clear();
+}
@@ -0,0 +1,114 @@
+/************************************************************************
+
+    adfscataloguescanner.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef ADFSCATALOGUESCANNER_H
+#define ADFSCATALOGUESCANNER_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInteger>
+
+#include <functional>
+
+#include "adfsimage.h"
+#include "adfscatalogue.h"
+
+// Catalogue scan statistics
+struct AdfsCatalogueScanStatistics
+{
+    qint64 threads = 0;             // Number of worker threads used
+    qint64 directoriesRead = 0;     // Number of directories successfully read
+    qint64 directoriesInvalid = 0;  // Number of directories that could not be read
+    qint64 directoriesStolen = 0;   // Number of directories taken from another worker's queue
+    bool stopped = false;           // The scan was stopped by the directory callback
+};
+
+// Reads the whole catalogue of an ADFS image in parallel.  Each directory is a
+// task; workers take tasks from the back of their own queue and, when that is
+// empty, steal from the front of other workers' queues.  The directories are
+// assembled into the catalogue once all have been read, so the result does not
+// depend on the order in which the workers read them
+class AdfsCatalogueScanner
+{
+public:
+    // Called as each directory is read (by one worker at a time), with the
+    // number of directories read and found so far; returning false stops the scan
+    typedef std::function<bool(const AdfsDirectoryRecord &directoryRecord, qint64 directoriesRead,
+                               qint64 directoriesFound)> DirectoryCallback;
+
+    AdfsCatalogueScanner(AdfsImage *adfsImageParam);
+    ~AdfsCatalogueScanner();
+
+    void setMaximumThreads(qint64 maximumThreadsParam);
+    void setDirectoryCallback(DirectoryCallback directoryCallbackParam);
+    bool scan(AdfsCatalogue *catalogue);
+    AdfsCatalogueScanStatistics getStatistics();
+
+    void runWorker(qint64 workerNumber);
+
+private:
+    Q_DISABLE_COPY(AdfsCatalogueScanner)
+
+    // Per-worker queue of directory sectors waiting to be read
+    struct WorkQueue {
+        QMutex mutex;
+        QList<qint64> directorySectors;
+    };
+
+    AdfsImage *adfsImage;
+    qint64 maximumThreads;
+    DirectoryCallback directoryCallback;
+
+    QVector<WorkQueue *> workQueues;
+    QAtomicInteger<qint64> pendingDirectories;  // Directories queued or being read
+    QAtomicInteger<qint64> queuedDirectories;   // Directories queued (not yet taken)
+    QAtomicInteger<qint64> directoriesStolen;
+    QAtomicInt stopRequested;
+
+    // Idle workers wait until directories are queued or the scan is complete
+    QMutex idleMutex;
+    QWaitCondition workAvailable;
+
+    // Results shared between the workers
+    QMutex resultsMutex;
+    QHash<qint64, AdfsDirectoryRecord> directoryRecords;
+    QSet<qint64> foundDirectories;
+
+    AdfsCatalogueScanStatistics statistics;
+
+    bool takeDirectory(qint64 workerNumber, qint64 *directorySector);
+    void scanDirectory(qint64 workerNumber, qint64 directorySector);
+    void wakeWorkers();
+    void clearWorkQueues();
+};
+
+#endif // ADFSCATALOGUESCANNER_H
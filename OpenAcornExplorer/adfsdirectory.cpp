@@ -25,32 +25,84 @@
 ************************************************************************/
 
 #include "adfsdirectory.h"
+#include "logcategories.h"
+#include "tracerecorder.h"
+
+// Get the attributes of an entry in the usual *INFO order (e.g. "DLR/r")
+QString AdfsDirectoryEntry::getAttributeString() const
+{
+    QString attributeString;
+
+    if (isDirectory()) attributeString += "D";
+    if (isLocked()) attributeString += "L";
+    if (attributes & Executable) attributeString += "E";
+    if (isWritable()) attributeString += "W";
+    if (isReadable()) attributeString += "R";
+    attributeString += "/";
+    if (attributes & PublicWritable) attributeString += "w";
+    if (attributes & PublicReadable) attributeString += "r";
+
+    return attributeString;
+}
 
 AdfsDirectory::AdfsDirectory()
 {
     directoryData = new QByteArray;
     sectorSize = 256;
+    directoryFormat = OldFormat;
+
+    // Old and new format directories hold a maximum of 77 entries of up to 10
+    // characters (big directories reserve space for their entries as they are decoded)
+    entries.reserve(77);
+    entryNames.reserve(77 * 10);
+}
+
+AdfsDirectory::~AdfsDirectory()
+{
+    delete directoryData;
 }
 
 // Note: Should this also need the sector size?
-bool AdfsDirectory::setDirectory(QByteArray directoryDataParam)
+bool AdfsDirectory::setDirectory(const QByteArray &directoryDataParam)
 {
+    TraceScope trace("parse", "AdfsDirectory::setDirectory");
+    trace.setBytes(directoryDataParam.size());
+
     bool directoryValid = false;
 
     // Copy the directory data into the object
     directoryData->clear();
     directoryData->append(directoryDataParam);
+    entries.resize(0);
+    entryNames.resize(0);
+    entryIndex.clear();
 
     // Check the directory identification string
-    qDebug() << "AdfsDirectory::setDirectory(): Directory identification string is" << getIdentificationString();
+    QString identificationString = getIdentificationString();
+    qCDebugHotPath(lcDirectory) << "AdfsDirectory::setDirectory(): Directory identification string is" << identificationString;
+
+    // Old format ("Hugo") directories are 1280 bytes; new format ("Nick")
+    // directories used by D, E and F format discs are 2048 bytes and big
+    // directories ("SBPr") used by E+ and F+ format discs are any multiple of
+    // 2048 bytes
+    if (identificationString == "SBPr") {
+        directoryFormat = BigFormat;
+        directoryValid = true;
+    } else if (identificationString == "Nick" && directoryData->size() == 2048) {
+        directoryFormat = NewFormat;
+        directoryValid = true;
+    } else if (identificationString == "Hugo" && directoryData->size() == 1280) {
+        directoryFormat = OldFormat;
+        directoryValid = true;
+    }
 
-    if (QString::compare(getIdentificationString(), "Hugo", Qt::CaseSensitive) != 0) {
+    if (!directoryValid) {
         // Not a valid ADFS directory
-        directoryValid = false;
-        qDebug() << "AdfsDirectory::setDirectory(): Error, directory identification string is invalid!";
+        qCDebug(lcDirectory) << "AdfsDirectory::setDirectory(): Error, directory identification string is invalid!";
     } else {
         // Valid directory
-        directoryValid = true;
+        directoryValid = decodeEntries();
+        if (directoryValid) buildEntryIndex();
     }
 
     return directoryValid;
@@ -59,17 +111,28 @@ bool AdfsDirectory::setDirectory(QByteArray directoryDataParam)
 qint64 AdfsDirectory::getMasterSequenceNumber()
 {
     // Value is stored as binary-coded decimal
-    return convertBcdToInt(directoryData->at(0)); // Also at 1274
+    return convertBcdToInt(directoryData->at(0)); // Also at the end of the directory
 }
 
 QString AdfsDirectory::getIdentificationString()
 {
+    // Big directories start with "SBPr" after the sequence number and version,
+    // and end with "oven" before the sequence number and check byte.  The
+    // header also holds the size of the directory
+    if (directoryData->size() >= 2048 && directoryData->mid(4, 4) == "SBPr") {
+        if ((directoryData->size() % 2048) == 0 && getLittleEndianInt(12) == directoryData->size() &&
+                directoryData->mid(directoryData->size() - 8, 4) == "oven") return QString("SBPr");
+
+        return QString();
+    }
+
     // Check the directory identification string
     QString startIdentificationString;
     QString endIdentificationString;
 
+    // The end identification string is followed only by the check byte
     startIdentificationString = QString::fromLatin1(directoryData->mid(1, 4));
-    endIdentificationString = QString::fromLatin1(directoryData->mid(1275, 4));
+    endIdentificationString = QString::fromLatin1(directoryData->mid(directoryData->size() - 5, 4));
 
     // Ensure that both strings match
     if (QString::compare(startIdentificationString, endIdentificationString, Qt::CaseSensitive) != 0) {
@@ -80,138 +143,214 @@ QString AdfsDirectory::getIdentificationString()
     return startIdentificationString;
 }
 
-QString AdfsDirectory::getEntryName(qint64 entryNumber)
+// Get the size of the directory in bytes
+qint64 AdfsDirectory::getDirectorySize() const
 {
-    // Entry name starts at byte 5 (each entry is 26 bytes in total)
-    qint64 entryOffset = 5 + (entryNumber * 26);
+    return directoryData->size();
+}
 
-    QByteArray entryNameAndAccess;
-    entryNameAndAccess = directoryData->mid(entryOffset, 10);
+// The master sequence number is held at both the start and the end of the
+// directory; they differ if an update of the directory was interrupted
+bool AdfsDirectory::isMasterSequenceNumberConsistent()
+{
+    if (directoryData->size() < 6) return false;
 
-    // Strip the directory access attributes from the directory name
-    entryNameAndAccess[0] = entryNameAndAccess[0] & 0x7F;
-    entryNameAndAccess[1] = entryNameAndAccess[1] & 0x7F;
-    entryNameAndAccess[2] = entryNameAndAccess[2] & 0x7F;
-    entryNameAndAccess[3] = entryNameAndAccess[3] & 0x7F;
+    qint64 endOffset = directoryData->size() - ((directoryFormat == BigFormat) ? 4 : 6);
+    return directoryData->at(0) == directoryData->at(endOffset);
+}
 
-    return getTerminatedString(entryNameAndAccess, 10);
+// Get the check byte held in the last byte of the directory
+quint8 AdfsDirectory::getCheckByte()
+{
+    if (directoryData->isEmpty()) return 0;
+
+    return static_cast<quint8>(directoryData->at(directoryData->size() - 1));
 }
 
-// Function to return the read flag of a directory entry
-bool AdfsDirectory::isEntryReadable(qint64 entryNumber)
+// Calculate the directory check byte.  Each word of the directory in use (and
+// then each remaining byte of the last entry) is accumulated by rotating the
+// check right 13 bits and exclusive-ORing in the word, followed by the words of
+// the tail excluding the last word that holds the check byte itself.  The check
+// byte is the exclusive-OR of the four bytes of the result
+quint8 AdfsDirectory::calculateCheckByte()
 {
-    bool flag = false;
+    qint64 size = directoryData->size();
+    quint32 check = 0;
+
+    if (directoryFormat == BigFormat) {
+        // The header, entries and name heap are accumulated as words, then the
+        // "oven" tail word and the three tail bytes before the check byte
+        qint64 entriesStart = 28 + ((getLittleEndianInt(8) + 3) & ~3);
+        qint64 end = entriesStart + (getLittleEndianInt(16) * 28) + getLittleEndianInt(20);
+        check = accumulateCheckWords(check, 0, qMin((end + 3) & ~3, size - 8));
+        check = accumulateCheckWords(check, size - 8, size - 4);
+        for (qint64 offset = size - 4; offset < size - 1; offset++) {
+            check = ((check >> 13) | (check << 19)) ^ static_cast<quint8>(directoryData->at(offset));
+        }
+    } else {
+        // The entries in use end with the first unused entry
+        qint64 last = 5 + (entries.size() * 26);
+        check = accumulateCheckWords(check, 0, last & ~3);
+        for (qint64 offset = last & ~3; offset < last; offset++) {
+            check = ((check >> 13) | (check << 19)) ^ static_cast<quint8>(directoryData->at(offset));
+        }
 
-    // Entry access starts at byte 5 (each entry is 26 bytes in total)
-    qint64 entryOffset = 5 + (entryNumber * 26);
+        // The tail words start 40 bytes before the end of the directory
+        check = accumulateCheckWords(check, size - 40, size - 4);
+    }
 
-    QByteArray entryNameAndAccess;
-    entryNameAndAccess = directoryData->mid(entryOffset, 4);
-    if ((entryNameAndAccess[0] & 0x80) == 0x80) flag = true;
+    return static_cast<quint8>(check ^ (check >> 8) ^ (check >> 16) ^ (check >> 24));
+}
 
-    return flag;
+// Check the directory check byte
+// Note: 8-bit ADFS does not calculate the check byte and leaves it zero, so a
+// zero check byte is accepted in old format directories
+bool AdfsDirectory::isCheckByteValid()
+{
+    if (directoryFormat == OldFormat && getCheckByte() == 0) return true;
+
+    return getCheckByte() == calculateCheckByte();
 }
 
-// Function to return the write flag of a directory entry
-bool AdfsDirectory::isEntryWritable(qint64 entryNumber)
+// Get the number of entries in the directory
+qint64 AdfsDirectory::getNumberOfEntries() const
 {
-    bool flag = false;
+    return entries.size();
+}
 
-    // Entry access starts at byte 5 (each entry is 26 bytes in total)
-    qint64 entryOffset = 5 + (entryNumber * 26);
+// Find an entry by name (names are compared without regard to case)
+// Returns the entry number, or -1 if there is no entry with the name
+qint64 AdfsDirectory::findEntry(const QString &name) const
+{
+    return entryIndex.value(name.toUpper(), -1);
+}
 
-    QByteArray entryNameAndAccess;
-    entryNameAndAccess = directoryData->mid(entryOffset, 4);
-    if ((entryNameAndAccess[1] & 0x80) == 0x80) flag = true;
+// Get the index of the entry names (upper case) to entry numbers
+const QHash<QString, qint32> &AdfsDirectory::getEntryIndex() const
+{
+    return entryIndex;
+}
 
-    return flag;
+// Get a decoded directory entry
+const AdfsDirectoryEntry &AdfsDirectory::getEntry(qint64 entryNumber) const
+{
+    return entries.at(entryNumber);
 }
 
-// Function to return the lock flag of a directory entry
-bool AdfsDirectory::isEntryLocked(qint64 entryNumber)
+// Get the table of decoded directory entries
+const QVector<AdfsDirectoryEntry> &AdfsDirectory::getEntries() const
 {
-    bool flag = false;
+    return entries;
+}
 
-    // Entry access starts at byte 5 (each entry is 26 bytes in total)
-    qint64 entryOffset = 5 + (entryNumber * 26);
+// Get the name of a decoded directory entry
+QString AdfsDirectory::getEntryName(const AdfsDirectoryEntry &entry) const
+{
+    return QString::fromLatin1(entryNames.constData() + entry.nameOffset, entry.nameLength);
+}
 
-    QByteArray entryNameAndAccess;
-    entryNameAndAccess = directoryData->mid(entryOffset, 4);
-    if ((entryNameAndAccess[2] & 0x80) == 0x80) flag = true;
+// Iterators over the decoded directory entries
+const AdfsDirectoryEntry *AdfsDirectory::begin() const
+{
+    return entries.constData();
+}
 
-    return flag;
+const AdfsDirectoryEntry *AdfsDirectory::end() const
+{
+    return entries.constData() + entries.size();
+}
+
+// Get the table holding the names of the decoded directory entries
+const QByteArray &AdfsDirectory::getEntryNameTable() const
+{
+    return entryNames;
+}
+
+// Note: Entry numbers beyond the end of the directory return an empty name
+QString AdfsDirectory::getEntryName(qint64 entryNumber)
+{
+    if (entryNumber < 0 || entryNumber >= entries.size()) return QString("");
+
+    return getEntryName(entries.at(entryNumber));
+}
+
+// Function to return the read flag of a directory entry
+bool AdfsDirectory::isEntryReadable(qint64 entryNumber)
+{
+    if (entryNumber < 0 || entryNumber >= entries.size()) return false;
+
+    return entries.at(entryNumber).isReadable();
+}
+
+// Function to return the write flag of a directory entry
+bool AdfsDirectory::isEntryWritable(qint64 entryNumber)
+{
+    if (entryNumber < 0 || entryNumber >= entries.size()) return false;
+
+    return entries.at(entryNumber).isWritable();
+}
+
+// Function to return the lock flag of a directory entry
+bool AdfsDirectory::isEntryLocked(qint64 entryNumber)
+{
+    if (entryNumber < 0 || entryNumber >= entries.size()) return false;
+
+    return entries.at(entryNumber).isLocked();
 }
 
 // Function to return the directory flag of a directory entry
 // Note: true = entry is a directory, false = entry is a file
 bool AdfsDirectory::isEntryDirectory(qint64 entryNumber)
 {
-    bool flag = false;
-
-    // Entry access starts at byte 5 (each entry is 26 bytes in total)
-    qint64 entryOffset = 5 + (entryNumber * 26);
+    if (entryNumber < 0 || entryNumber >= entries.size()) return false;
 
-    QByteArray entryNameAndAccess;
-    entryNameAndAccess = directoryData->mid(entryOffset, 4);
-    if ((entryNameAndAccess[3] & 0x80) == 0x80) flag = true;
-
-    return flag;
+    return entries.at(entryNumber).isDirectory();
 }
 
 qint64 AdfsDirectory::getEntryLoadAddress(qint64 entryNumber)
 {
-    // Entry load address starts at byte 15 (each entry is 26 bytes in total)
-    qint64 entryOffset = 15 + (entryNumber * 26);
+    if (entryNumber < 0 || entryNumber >= entries.size()) return 0;
 
-    return convertBytesToInt(directoryData->at(3 + entryOffset),
-                             directoryData->at(2 + entryOffset),
-                             directoryData->at(1 + entryOffset),
-                             directoryData->at(0 + entryOffset));
+    return entries.at(entryNumber).loadAddress;
 }
 
 qint64 AdfsDirectory::getEntryExecutionAddress(qint64 entryNumber)
 {
-    // Entry execution address starts at byte 19 (each entry is 26 bytes in total)
-    qint64 entryOffset = 19 + (entryNumber * 26);
+    if (entryNumber < 0 || entryNumber >= entries.size()) return 0;
 
-    return convertBytesToInt(directoryData->at(3 + entryOffset),
-                             directoryData->at(2 + entryOffset),
-                             directoryData->at(1 + entryOffset),
-                             directoryData->at(0 + entryOffset));
+    return entries.at(entryNumber).executionAddress;
 }
 
 qint64 AdfsDirectory::getEntryLength(qint64 entryNumber)
 {
-    // Entry length starts at byte 23 (each entry is 26 bytes in total)
-    qint64 entryOffset = 23 + (entryNumber * 26);
+    if (entryNumber < 0 || entryNumber >= entries.size()) return 0;
 
-    return convertBytesToInt(directoryData->at(3 + entryOffset),
-                             directoryData->at(2 + entryOffset),
-                             directoryData->at(1 + entryOffset),
-                             directoryData->at(0 + entryOffset));
+    return entries.at(entryNumber).length;
 }
 
 qint64 AdfsDirectory::getEntryStartSector(qint64 entryNumber)
 {
-    // Entry start sector starts at byte 27 (each entry is 26 bytes in total)
-    qint64 entryOffset = 27 + (entryNumber * 26);
+    if (entryNumber < 0 || entryNumber >= entries.size()) return 0;
 
-    return convertBytesToInt(directoryData->at(2 + entryOffset),
-                             directoryData->at(1 + entryOffset),
-                             directoryData->at(0 + entryOffset));
+    return entries.at(entryNumber).startSector;
 }
 
 qint64 AdfsDirectory::getEntrySequenceNumber(qint64 entryNumber)
 {
-    // Entry name starts at byte 30 (each entry is 26 bytes in total)
-    qint64 entryOffset = 30 + (entryNumber * 26);
+    if (entryNumber < 0 || entryNumber >= entries.size()) return 0;
 
-    // Value is stored as binary-coded decimal
-    return convertBcdToInt(directoryData->at(entryOffset));
+    return entries.at(entryNumber).sequenceNumber;
 }
 
 QString AdfsDirectory::getDirectoryName()
 {
+    // New format and big directory names do not hold the access attributes
+    if (directoryFormat == NewFormat) return getTerminatedString(directoryData->mid(2032, 10), 10);
+    if (directoryFormat == BigFormat) {
+        qint64 nameLength = qMin(getLittleEndianInt(8), static_cast<qint64>(255));
+        return getTerminatedString(directoryData->mid(28, static_cast<int>(nameLength)) + '\r', nameLength);
+    }
+
     QByteArray directoryNameAndAccess;
     directoryNameAndAccess = directoryData->mid(1228, 10);
 
@@ -225,9 +364,11 @@ QString AdfsDirectory::getDirectoryName()
 }
 
 // Function to return the read flag of the directory
+// Note: New format and big directories only hold their attributes in the parent's entry
 bool AdfsDirectory::isDirectoryReadable()
 {
     bool flag = false;
+    if (directoryFormat != OldFormat) return flag;
 
     QByteArray directoryNameAndAccess;
     directoryNameAndAccess = directoryData->mid(1228, 4);
@@ -240,6 +381,7 @@ bool AdfsDirectory::isDirectoryReadable()
 bool AdfsDirectory::isDirectoryWritable()
 {
     bool flag = false;
+    if (directoryFormat != OldFormat) return flag;
 
     QByteArray directoryNameAndAccess;
     directoryNameAndAccess = directoryData->mid(1228, 4);
@@ -252,6 +394,7 @@ bool AdfsDirectory::isDirectoryWritable()
 bool AdfsDirectory::isDirectoryLocked()
 {
     bool flag = false;
+    if (directoryFormat != OldFormat) return flag;
 
     QByteArray directoryNameAndAccess;
     directoryNameAndAccess = directoryData->mid(1228, 4);
@@ -262,14 +405,152 @@ bool AdfsDirectory::isDirectoryLocked()
 
 QString AdfsDirectory::getDirectoryTitle()
 {
+    // Big directories have no title, so are titled with their name
+    if (directoryFormat == BigFormat) return getDirectoryName();
+
     QByteArray title;
-    title = directoryData->mid(1241, 19);
+    title = directoryData->mid((directoryFormat == NewFormat) ? 2013 : 1241, 19);
 
     return getTerminatedString(title, 19);
 }
 
 // Private methods
 
+// Decode the directory entries into the entry table in a single pass
+bool AdfsDirectory::decodeEntries()
+{
+    if (directoryFormat == BigFormat) return decodeBigEntries();
+
+    const uchar *data = reinterpret_cast<const uchar *>(directoryData->constData());
+    bool newFormat = (directoryFormat == NewFormat);
+
+    // Entries start at byte 5 (each entry is 26 bytes in total); old format
+    // directories hold up to 47 entries and new format directories up to 77
+    qint64 maximumEntries = newFormat ? 77 : 47;
+    quint8 nameMask = newFormat ? 0xFF : 0x7F;
+
+    for (qint64 entryNumber = 0; entryNumber < maximumEntries; entryNumber++) {
+        const uchar *entryData = data + 5 + (entryNumber * 26);
+
+        // An empty entry name indicates the end of the directory
+        quint8 firstCharacter = entryData[0] & nameMask;
+        if (firstCharacter == 0x00 || firstCharacter == 0x0D) break;
+
+        AdfsDirectoryEntry entry;
+
+        // Old format directories hold the access attributes (R, W, L, D, E, r, w)
+        // in the top bits of the first 7 name characters; new format directories
+        // hold them in byte 25 in place of the sequence number.  Both map directly
+        // onto the attribute flags
+        entry.attributes = 0;
+        if (newFormat) {
+            entry.attributes = entryData[25] & 0x7F;
+        } else {
+            for (qint64 bit = 0; bit < 7; bit++) {
+                if ((entryData[bit] & 0x80) == 0x80) entry.attributes |= (1 << bit);
+            }
+        }
+
+        // Copy the name (stripped of attributes) into the name table
+        entry.nameOffset = entryNames.size();
+        entry.nameLength = 0;
+        for (qint64 pointer = 0; pointer < 10; pointer++) {
+            char character = entryData[pointer] & nameMask;
+            if (character == 0x0D || character == 0x00) break;
+
+            entryNames.append(character);
+            entry.nameLength++;
+        }
+
+        entry.loadAddress = static_cast<quint32>(convertBytesToInt(entryData[13], entryData[12], entryData[11], entryData[10]));
+        entry.executionAddress = static_cast<quint32>(convertBytesToInt(entryData[17], entryData[16], entryData[15], entryData[14]));
+        entry.length = static_cast<quint32>(convertBytesToInt(entryData[21], entryData[20], entryData[19], entryData[18]));
+        entry.startSector = static_cast<quint32>(convertBytesToInt(entryData[24], entryData[23], entryData[22]));
+
+        // Value is stored as binary-coded decimal
+        entry.sequenceNumber = newFormat ? 0 : static_cast<quint8>(convertBcdToInt(entryData[25]));
+
+        entries.append(entry);
+    }
+
+    return true;
+}
+
+// Decode the entries of a big directory.  The header (28 bytes and the
+// directory name, padded to a word) is followed by the entries (28 bytes each)
+// and then the heap holding the entry names
+bool AdfsDirectory::decodeBigEntries()
+{
+    const uchar *data = reinterpret_cast<const uchar *>(directoryData->constData());
+    qint64 directorySize = directoryData->size();
+
+    qint64 directoryNameLength = getLittleEndianInt(8);
+    qint64 numberOfEntries = getLittleEndianInt(16);
+    qint64 nameHeapSize = getLittleEndianInt(20);
+
+    // The entries and the name heap must fit before the 8 byte tail
+    qint64 entriesStart = 28 + ((directoryNameLength + 3) & ~3);
+    qint64 nameHeapStart = entriesStart + (numberOfEntries * 28);
+    if (directoryNameLength > directorySize || numberOfEntries > directorySize / 28 ||
+            nameHeapStart + nameHeapSize > directorySize - 8) {
+        qCDebug(lcDirectory) << "AdfsDirectory::decodeBigEntries(): Error, directory header is invalid!";
+        return false;
+    }
+
+    entries.reserve(static_cast<int>(numberOfEntries));
+    entryNames.reserve(static_cast<int>(nameHeapSize));
+
+    for (qint64 entryNumber = 0; entryNumber < numberOfEntries; entryNumber++) {
+        const uchar *entryData = data + entriesStart + (entryNumber * 28);
+
+        AdfsDirectoryEntry entry;
+        entry.loadAddress = static_cast<quint32>(convertBytesToInt(entryData[3], entryData[2], entryData[1], entryData[0]));
+        entry.executionAddress = static_cast<quint32>(convertBytesToInt(entryData[7], entryData[6], entryData[5], entryData[4]));
+        entry.length = static_cast<quint32>(convertBytesToInt(entryData[11], entryData[10], entryData[9], entryData[8]));
+        entry.startSector = static_cast<quint32>(convertBytesToInt(entryData[15], entryData[14], entryData[13], entryData[12]));
+
+        // Only the bottom byte of the attribute word is used
+        entry.attributes = entryData[16] & 0x7F;
+        entry.sequenceNumber = 0;
+
+        qint64 nameLength = convertBytesToInt(entryData[23], entryData[22], entryData[21], entryData[20]);
+        qint64 namePointer = convertBytesToInt(entryData[27], entryData[26], entryData[25], entryData[24]);
+        if (namePointer + nameLength > nameHeapSize) {
+            qCDebug(lcDirectory) << "AdfsDirectory::decodeBigEntries(): Error, entry" << entryNumber << "name is outside of the name heap!";
+            entries.resize(0);
+            entryNames.resize(0);
+            return false;
+        }
+
+        // Copy the name into the name table (names are up to 255 characters)
+        entry.nameOffset = entryNames.size();
+        entry.nameLength = 0;
+        const uchar *nameData = data + nameHeapStart + namePointer;
+        for (qint64 pointer = 0; pointer < qMin(nameLength, static_cast<qint64>(255)); pointer++) {
+            char character = static_cast<char>(nameData[pointer]);
+            if (character == 0x0D || character == 0x00) break;
+
+            entryNames.append(character);
+            entry.nameLength++;
+        }
+
+        entries.append(entry);
+    }
+
+    return true;
+}
+
+// Index the entries by name so that lookups do not search the directory; the
+// first of any entries with the same name is found
+void AdfsDirectory::buildEntryIndex()
+{
+    entryIndex.reserve(entries.size());
+
+    for (qint64 entryNumber = entries.size() - 1; entryNumber >= 0; entryNumber--) {
+        entryIndex.insert(getEntryName(entries.at(entryNumber)).toUpper(), static_cast<qint32>(entryNumber));
+    }
+}
+
 // Takes QByteArray data containing string and detects either termination
 // or maximum allowed length - returns a QString result
 QString AdfsDirectory::getTerminatedString(QByteArray data, qint64 maximumLength)
@@ -316,6 +597,25 @@ qint64 AdfsDirectory::convertBytesToInt(quint8 byte0, quint8 byte1, quint8 byte2
     return (qint64)value;
 }
 
+// Get a little-endian 32 bit integer from the directory data
+qint64 AdfsDirectory::getLittleEndianInt(qint64 offset)
+{
+    if (offset + 4 > directoryData->size()) return 0;
+
+    return convertBytesToInt(directoryData->at(offset + 3), directoryData->at(offset + 2), directoryData->at(offset + 1), directoryData->at(offset));
+}
+
+// Accumulate the little-endian words from startOffset up to endOffset into a
+// directory check value
+quint32 AdfsDirectory::accumulateCheckWords(quint32 check, qint64 startOffset, qint64 endOffset)
+{
+    for (qint64 offset = startOffset; offset + 4 <= endOffset; offset += 4) {
+        check = ((check >> 13) | (check << 19)) ^ static_cast<quint32>(getLittleEndianInt(offset));
+    }
+
+    return check;
+}
+
 // Convert BCD to integer
 qint64 AdfsDirectory::convertBcdToInt(quint8 byte0)
 {
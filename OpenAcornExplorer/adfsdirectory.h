@@ -27,18 +27,100 @@
 #ifndef ADFSDIRECTORY_H
 #define ADFSDIRECTORY_H
 
-#include <QApplication>
+#include <QCoreApplication>
 #include <QDebug>
+#include <QHash>
+#include <QVector>
+
+// Decoded directory entry.  Entries are decoded once when the directory is set;
+// the entry name is held in the directory's name table (see getEntryName())
+struct AdfsDirectoryEntry
+{
+    // Entry attribute flags
+    enum Attribute {
+        Readable = 0x01,
+        Writable = 0x02,
+        Locked = 0x04,
+        Directory = 0x08,
+        Executable = 0x10,
+        PublicReadable = 0x20,
+        PublicWritable = 0x40
+    };
+
+    quint32 nameOffset;         // Offset of the name in the directory name table
+    quint8 nameLength;
+    quint8 attributes;
+    quint8 sequenceNumber;
+    quint32 loadAddress;
+    quint32 executionAddress;
+    quint32 length;
+    quint32 startSector;        // Disc address: a sector on old map discs, an indirect disc address on new map discs
+
+    bool isReadable() const { return (attributes & Readable) != 0; }
+    bool isWritable() const { return (attributes & Writable) != 0; }
+    bool isLocked() const { return (attributes & Locked) != 0; }
+    bool isDirectory() const { return (attributes & Directory) != 0; }
+
+    QString getAttributeString() const;
+};
+
+// A directory read from a disc image.  Held by value so that decoded directories
+// can be cached and passed between threads
+struct AdfsDirectoryRecord
+{
+    qint64 directorySector = -1;
+    QString directoryName;
+    qint64 masterSequenceNumber = 0;
+    QVector<AdfsDirectoryEntry> entries;
+    QByteArray entryNames;
+    QHash<QString, qint32> entryIndex;     // Upper case entry name -> entry number
+
+    // Results of the directory's consistency checks
+    qint64 directorySize = 0;
+    bool masterSequenceNumberConsistent = true;
+    bool checkByteValid = true;
+
+    QString getEntryName(const AdfsDirectoryEntry &entry) const
+    {
+        return QString::fromLatin1(entryNames.constData() + entry.nameOffset, entry.nameLength);
+    }
+
+    // Find an entry by name (without regard to case); -1 if there is no such entry
+    qint64 findEntry(const QString &name) const
+    {
+        return entryIndex.value(name.toUpper(), -1);
+    }
+};
 
 class AdfsDirectory
 {
 public:
     AdfsDirectory();
+    ~AdfsDirectory();
 
-    bool setDirectory(QByteArray directoryDataParam);
+    bool setDirectory(const QByteArray &directoryDataParam);
 
     qint64 getMasterSequenceNumber();
     QString getIdentificationString();
+    qint64 getDirectorySize() const;
+
+    // Consistency checks
+    bool isMasterSequenceNumberConsistent();
+    quint8 getCheckByte();
+    quint8 calculateCheckByte();
+    bool isCheckByteValid();
+
+    // Decoded entry table
+    qint64 getNumberOfEntries() const;
+    const AdfsDirectoryEntry &getEntry(qint64 entryNumber) const;
+    const QVector<AdfsDirectoryEntry> &getEntries() const;
+    QString getEntryName(const AdfsDirectoryEntry &entry) const;
+    const AdfsDirectoryEntry *begin() const;
+    const AdfsDirectoryEntry *end() const;
+    const QByteArray &getEntryNameTable() const;
+    qint64 findEntry(const QString &name) const;
+    const QHash<QString, qint32> &getEntryIndex() const;
+
     QString getEntryName(qint64 entryNumber);
 
     bool isEntryReadable(qint64 entryNumber);
@@ -60,8 +142,29 @@ public:
     QString getDirectoryTitle();
 
 private:
+    Q_DISABLE_COPY(AdfsDirectory)
+
     QByteArray *directoryData;
     qint64 sectorSize;
+    // Old format ("Hugo"), new format ("Nick") or big ("SBPr") directory
+    enum DirectoryFormat {
+        OldFormat,
+        NewFormat,
+        BigFormat
+    };
+    DirectoryFormat directoryFormat;
+
+    // Entries decoded by setDirectory(), the table holding their names and the
+    // index of the names (built once per directory)
+    QVector<AdfsDirectoryEntry> entries;
+    QByteArray entryNames;
+    QHash<QString, qint32> entryIndex;
+
+    bool decodeEntries();
+    bool decodeBigEntries();
+    void buildEntryIndex();
+    qint64 getLittleEndianInt(qint64 offset);
+    quint32 accumulateCheckWords(quint32 check, qint64 startOffset, qint64 endOffset);
 
     QString getTerminatedString(QByteArray data, qint64 maximumLength);
     qint64 convertBytesToInt(quint8 byte0, quint8 byte1, quint8 byte2, quint8 byte3);
@@ -70,4 +173,6 @@ private:
     quint8 convertIntToBcd(qint64 byte0);
 };
 
+Q_DECLARE_METATYPE(AdfsDirectoryRecord)
+
 #endif // ADFSDIRECTORY_H
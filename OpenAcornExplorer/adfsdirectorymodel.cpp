@@ -25,49 +25,87 @@
 ************************************************************************/
 
 #include "adfsdirectorymodel.h"
+#include "logcategories.h"
+#include "tracerecorder.h"
 
-//AdfsDirectoryModel::AdfsDirectoryModel(const QStringList &headers, const QString &data, QObject *parent)
-AdfsDirectoryModel::AdfsDirectoryModel(DiscImage discImage, QObject *parent)
+// Column headings
+static const char *columnNames[] = {"Filename", "Attr", "Seq", "Load", "Exec", "Size", "Sector"};
+static const int numberOfColumns = 7;
+
+// Note: Directories are read from the disc image on demand (see fetchMore()), so
+// the ADFS image must remain open for the lifetime of the model
+AdfsDirectoryModel::AdfsDirectoryModel(AdfsImage *adfsImageParam, QObject *parent)
+
+    : QAbstractItemModel(parent)
+{
+    adfsImage = adfsImageParam;
+
+    // Initialise the root directory data from the disc image
+    AdfsDirectoryRecord directoryRecord;
+    if (readDirectory(adfsImage->getRootDirectorySector(), &directoryRecord)) initialiseAdfsRootDirectory(directoryRecord);
+}
+
+// Create the model from a root directory that has already been read (for
+// example by a background loader)
+AdfsDirectoryModel::AdfsDirectoryModel(AdfsImage *adfsImageParam, const AdfsDirectoryRecord &rootDirectoryRecord, QObject *parent)
 
     : QAbstractItemModel(parent)
 {
-    // Define the root item
-    QVector<QVariant> rootData;
-    rootData << "Filename" <<
-                "Attr" <<
-                "Seq" <<
-                "Load" <<
-                "Exec" <<
-                "Size" <<
-                "Sector";
-
-    rootItem = new AdfsDirectoryItem(rootData);
-
-    // Initialise the directory data from the disc image
-    initialiseAdfsRootDirectory(&discImage, rootItem);
+    adfsImage = adfsImageParam;
+
+    initialiseAdfsRootDirectory(rootDirectoryRecord);
 }
 
 AdfsDirectoryModel::~AdfsDirectoryModel()
 {
-    delete rootItem;
 }
 
 int AdfsDirectoryModel::columnCount(const QModelIndex & /* parent */) const
 {
-    return rootItem->columnCount();
+    return numberOfColumns;
 }
 
+// Format the data of a node for display
 QVariant AdfsDirectoryModel::data(const QModelIndex &index, int role) const
 {
     if (!index.isValid())
         return QVariant();
 
-    if (role != Qt::DisplayRole && role != Qt::EditRole)
+    if (role != Qt::DisplayRole)
         return QVariant();
 
-    AdfsDirectoryItem *item = getItem(index);
+    const AdfsCatalogueNode &node = nodes.at(getNodeNumber(index));
+    const AdfsDirectoryEntry &entry = node.entry;
+
+    switch (index.column()) {
+    case 0:
+        return nodeNames.getName(entry);
+    case 1:
+        return entry.getAttributeString();
+    case 2:
+        return entry.sequenceNumber;
+    default:
+        break;
+    }
+
+    // Only files have addresses, a length and a sector
+    if (entry.isDirectory())
+        return QVariant();
 
-    return item->data(index.column());
+    switch (index.column()) {
+    case 3:
+        return QString("%1").arg(entry.loadAddress, 8, 16, QChar('0')).toUpper();
+    case 4:
+        return QString("%1").arg(entry.executionAddress, 8, 16, QChar('0')).toUpper();
+    case 5:
+        return entry.length;
+    case 6:
+        return entry.startSector;
+    default:
+        break;
+    }
+
+    return QVariant();
 }
 
 Qt::ItemFlags AdfsDirectoryModel::flags(const QModelIndex &index) const
@@ -75,24 +113,14 @@ Qt::ItemFlags AdfsDirectoryModel::flags(const QModelIndex &index) const
     if (!index.isValid())
         return 0;
 
-    return Qt::ItemIsEditable | QAbstractItemModel::flags(index);
-}
-
-AdfsDirectoryItem *AdfsDirectoryModel::getItem(const QModelIndex &index) const
-{
-    if (index.isValid()) {
-        AdfsDirectoryItem *item = static_cast<AdfsDirectoryItem*>(index.internalPointer());
-        if (item)
-            return item;
-    }
-    return rootItem;
+    return QAbstractItemModel::flags(index);
 }
 
 QVariant AdfsDirectoryModel::headerData(int section, Qt::Orientation orientation,
                                int role) const
 {
-    if (orientation == Qt::Horizontal && role == Qt::DisplayRole)
-        return rootItem->data(section);
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < numberOfColumns)
+        return QString(columnNames[section]);
 
     return QVariant();
 }
@@ -102,36 +130,22 @@ QModelIndex AdfsDirectoryModel::index(int row, int column, const QModelIndex &pa
     if (parent.isValid() && parent.column() != 0)
         return QModelIndex();
 
-    AdfsDirectoryItem *parentItem = getItem(parent);
-
-    AdfsDirectoryItem *childItem = parentItem->child(row);
-    if (childItem)
-        return createIndex(row, column, childItem);
-    else
+    if (row < 0 || column < 0 || column >= numberOfColumns)
         return QModelIndex();
-}
-
-bool AdfsDirectoryModel::insertColumns(int position, int columns, const QModelIndex &parent)
-{
-    bool success;
 
-    beginInsertColumns(parent, position, position + columns - 1);
-    success = rootItem->insertColumns(position, columns);
-    endInsertColumns();
+    // The root directory is the only top level row
+    if (!parent.isValid()) {
+        if (row != 0 || nodes.isEmpty())
+            return QModelIndex();
 
-    return success;
-}
-
-bool AdfsDirectoryModel::insertRows(int position, int rows, const QModelIndex &parent)
-{
-    AdfsDirectoryItem *parentItem = getItem(parent);
-    bool success;
+        return createIndex(0, column, static_cast<quintptr>(0));
+    }
 
-    beginInsertRows(parent, position, position + rows - 1);
-    success = parentItem->insertChildren(position, rows, rootItem->columnCount());
-    endInsertRows();
+    const AdfsCatalogueNode &parentNode = nodes.at(getNodeNumber(parent));
+    if (!parentNode.isPopulated() || row >= parentNode.childCount)
+        return QModelIndex();
 
-    return success;
+    return createIndex(row, column, static_cast<quintptr>(parentNode.firstChild + row));
 }
 
 QModelIndex AdfsDirectoryModel::parent(const QModelIndex &index) const
@@ -139,138 +153,162 @@ QModelIndex AdfsDirectoryModel::parent(const QModelIndex &index) const
     if (!index.isValid())
         return QModelIndex();
 
-    AdfsDirectoryItem *childItem = getItem(index);
-    AdfsDirectoryItem *parentItem = childItem->parent();
-
-    if (parentItem == rootItem)
+    qint32 parentNumber = nodes.at(getNodeNumber(index)).parent;
+    if (parentNumber < 0)
         return QModelIndex();
 
-    return createIndex(parentItem->childNumber(), 0, parentItem);
+    return createIndex(nodes.at(parentNumber).row, 0, static_cast<quintptr>(parentNumber));
 }
 
-bool AdfsDirectoryModel::removeColumns(int position, int columns, const QModelIndex &parent)
+int AdfsDirectoryModel::rowCount(const QModelIndex &parent) const
 {
-    bool success;
+    if (!parent.isValid())
+        return nodes.isEmpty() ? 0 : 1;
 
-    beginRemoveColumns(parent, position, position + columns - 1);
-    success = rootItem->removeColumns(position, columns);
-    endRemoveColumns();
+    if (parent.column() != 0)
+        return 0;
 
-    if (rootItem->columnCount() == 0)
-        removeRows(0, rowCount());
+    const AdfsCatalogueNode &parentNode = nodes.at(getNodeNumber(parent));
 
-    return success;
+    return parentNode.isPopulated() ? parentNode.childCount : 0;
 }
 
-bool AdfsDirectoryModel::removeRows(int position, int rows, const QModelIndex &parent)
+// Directories that have not been read yet are assumed to have children so
+// that the view shows them as expandable
+bool AdfsDirectoryModel::hasChildren(const QModelIndex &parent) const
 {
-    AdfsDirectoryItem *parentItem = getItem(parent);
-    bool success = true;
+    if (!parent.isValid())
+        return !nodes.isEmpty();
+
+    const AdfsCatalogueNode &parentNode = nodes.at(getNodeNumber(parent));
 
-    beginRemoveRows(parent, position, position + rows - 1);
-    success = parentItem->removeChildren(position, rows);
-    endRemoveRows();
+    if (parentNode.isDirectory() && !parentNode.isPopulated()) return true;
 
-    return success;
+    return parentNode.isPopulated() && parentNode.childCount > 0;
 }
 
-int AdfsDirectoryModel::rowCount(const QModelIndex &parent) const
+bool AdfsDirectoryModel::canFetchMore(const QModelIndex &parent) const
 {
-    AdfsDirectoryItem *parentItem = getItem(parent);
+    if (!parent.isValid())
+        return false;
 
-    return parentItem->childCount();
+    const AdfsCatalogueNode &parentNode = nodes.at(getNodeNumber(parent));
+
+    return parentNode.isDirectory() && !parentNode.isPopulated();
 }
 
-bool AdfsDirectoryModel::setData(const QModelIndex &index, const QVariant &value, int role)
+// Read a directory from the disc image when the view first needs its contents
+void AdfsDirectoryModel::fetchMore(const QModelIndex &parent)
 {
-    if (role != Qt::EditRole)
-        return false;
+    if (!canFetchMore(parent)) return;
+    qint32 nodeNumber = getNodeNumber(parent);
 
-    AdfsDirectoryItem *item = getItem(index);
-    bool result = item->setData(index.column(), value);
+    TraceScope trace("model", "AdfsDirectoryModel::fetchMore");
 
-    if (result)
-        emit dataChanged(index, index);
+    // Mark the directory as populated (with no children) even if it cannot be
+    // read so that it is not retried every time the view asks
+    nodes[nodeNumber].firstChild = nodes.size();
+    nodes[nodeNumber].childCount = 0;
 
-    return result;
+    AdfsDirectoryRecord directoryRecord;
+    if (!readDirectory(nodes.at(nodeNumber).entry.startSector, &directoryRecord)) return;
+    if (directoryRecord.entries.isEmpty()) return;
+
+    beginInsertRows(parent, 0, directoryRecord.entries.size() - 1);
+    populateDirectory(nodeNumber, directoryRecord);
+    endInsertRows();
 }
 
-bool AdfsDirectoryModel::setHeaderData(int section, Qt::Orientation orientation,
-                              const QVariant &value, int role)
+// Add directories that have been read in advance (for example by a background
+// scan of the disc image) so that expanding them does not read the disc image
+void AdfsDirectoryModel::addDirectoryRecords(const QVector<AdfsDirectoryRecord> &directoryRecords)
 {
-    if (role != Qt::EditRole || orientation != Qt::Horizontal)
-        return false;
+    for (const AdfsDirectoryRecord &directoryRecord : directoryRecords) {
+        prefetchedDirectories.insert(directoryRecord.directorySector, directoryRecord);
+    }
+}
+
+// Find the index of a catalogue path (such as "$.GAMES.ELITE"), reading the
+// directories along the path if the view has not expanded them yet; returns an
+// invalid index if there is no such path
+QModelIndex AdfsDirectoryModel::findPath(const QString &path)
+{
+    QStringList components = path.split('.');
+    if (components.isEmpty() || components.first() != "$" || nodes.isEmpty())
+        return QModelIndex();
+
+    QModelIndex pathIndex = index(0, 0);
+    for (qint64 component = 1; component < components.size() && pathIndex.isValid(); component++) {
+        if (canFetchMore(pathIndex))
+            fetchMore(pathIndex);
 
-    bool result = rootItem->setData(section, value);
+        const AdfsCatalogueNode &directoryNode = nodes.at(getNodeNumber(pathIndex));
+        QModelIndex childIndex;
+        for (qint32 row = 0; row < rowCount(pathIndex); row++) {
+            const AdfsDirectoryEntry &entry = nodes.at(directoryNode.firstChild + row).entry;
+            QString name = nodeNames.getName(entry);
 
-    if (result)
-        emit headerDataChanged(orientation, section, section);
+            if (QString::compare(name, components.at(component), Qt::CaseInsensitive) == 0) {
+                childIndex = index(row, 0, pathIndex);
+                break;
+            }
+        }
+        pathIndex = childIndex;
+    }
 
-    return result;
+    return pathIndex;
 }
 
+// Private methods
+
 // Initialise the ADFS directory model from the root directory
-void AdfsDirectoryModel::initialiseAdfsRootDirectory(DiscImage *discImage, AdfsDirectoryItem *parent)
+void AdfsDirectoryModel::initialiseAdfsRootDirectory(const AdfsDirectoryRecord &directoryRecord)
 {
-    // Populate the root directory (sector 2)
-    populateDirectory(discImage, parent, 2);
+    TraceScope trace("model", "AdfsDirectoryModel::initialise");
+
+    // The root directory node is named from the directory's own header
+    QByteArray rootName = directoryRecord.directoryName.toLatin1();
+
+    AdfsDirectoryEntry rootEntry;
+    rootEntry.nameOffset = 0;
+    rootEntry.nameLength = static_cast<quint8>(qMin(rootName.size(), 255));
+    rootEntry.attributes = AdfsDirectoryEntry::Directory;
+    rootEntry.sequenceNumber = static_cast<quint8>(directoryRecord.masterSequenceNumber);
+    rootEntry.loadAddress = 0;
+    rootEntry.executionAddress = 0;
+    rootEntry.length = 0;
+    rootEntry.startSector = static_cast<quint32>(directoryRecord.directorySector);
+    AdfsCatalogue::addNode(&nodes, &nodeNames, rootEntry, rootName, -1, 0);
+
+    // Only the root directory's own entries are read; sub-directories are read
+    // when the view expands them
+    populateDirectory(0, directoryRecord);
 }
 
-// Read a directory record and populate the ADFS directory model recursively
-void AdfsDirectoryModel::populateDirectory(DiscImage *discImage, AdfsDirectoryItem *parent, qint64 directorySector)
+// Get a directory record, either from the directories read in advance or from
+// the disc image
+bool AdfsDirectoryModel::readDirectory(qint64 directorySector, AdfsDirectoryRecord *directoryRecord)
 {
-    // A directory record is always 5 sectors in length
-    QByteArray directoryData;
-    directoryData.resize(5 * discImage->getSectorSize());
-
-    // Read 5 sectors of directory data
-    directoryData = discImage->readSector(directorySector, 5);
-
-    // Create the directory object (test only!)
-    AdfsDirectory adfsDirectory;
-
-    // Put the directory data into the object
-    if (adfsDirectory.setDirectory(directoryData)) {
-        // Add a child to the parent to contain the directory
-        parent->insertChildren(parent->childCount(), 1, rootItem->columnCount());
-
-        // Add the entry detail columns to the parent
-        qDebug() << "AdfsImage::readDirectory(): Reading directory data for directory" << adfsDirectory.getDirectoryName();
-        parent->child(parent->childCount() - 1)->setData(0, adfsDirectory.getDirectoryName());
-        parent->child(parent->childCount() - 1)->setData(2, adfsDirectory.getMasterSequenceNumber());
-
-        // Make the new child the parent
-        QList<AdfsDirectoryItem*> dir;
-        dir << parent->child(parent->childCount() - 1);
-        AdfsDirectoryItem *parent = dir.last();
-
-        // Now add a child to this parent for every entry in the directory
-        qint64 entry = 0;
-        // An empty entry name indicates the end of the directory
-        while (!adfsDirectory.getEntryName(entry).isEmpty() && entry <= 47) {
-            // Is this a file or a directory entry?
-            if (adfsDirectory.isEntryDirectory(entry)) {
-                // Entry is a directory
-
-                // Populate the sub-directory
-                populateDirectory(discImage, parent, adfsDirectory.getEntryStartSector(entry));
-            } else {
-                // Entry is a file - populate the details
-                qDebug() << "Entry" << adfsDirectory.getEntryName(entry) << "is a file";
-
-                // Add a child to contain the file details
-                parent->insertChildren(parent->childCount(), 1, rootItem->columnCount());
-
-                parent->child(parent->childCount() - 1)->setData(0, adfsDirectory.getEntryName(entry));
-                parent->child(parent->childCount() - 1)->setData(2, adfsDirectory.getEntrySequenceNumber(entry));
-                parent->child(parent->childCount() - 1)->setData(3, adfsDirectory.getEntryLoadAddress(entry));
-                parent->child(parent->childCount() - 1)->setData(4, adfsDirectory.getEntryExecutionAddress(entry));
-                parent->child(parent->childCount() - 1)->setData(5, adfsDirectory.getEntryLength(entry));
-                parent->child(parent->childCount() - 1)->setData(6, adfsDirectory.getEntryStartSector(entry));
-            }
-
-            // Next
-            entry++;
-        }
+    // A prefetched directory is only needed once (the model then holds the entries)
+    if (prefetchedDirectories.contains(directorySector)) {
+        *directoryRecord = prefetchedDirectories.take(directorySector);
+        return true;
     }
+
+    return adfsImage->readDirectoryRecord(directorySector, directoryRecord);
+}
+
+// Append a node for every entry in the directory (so that the directory's
+// children are contiguous)
+void AdfsDirectoryModel::populateDirectory(qint32 nodeNumber, const AdfsDirectoryRecord &directoryRecord)
+{
+    qCDebugHotPath(lcModel) << "AdfsDirectoryModel::populateDirectory(): Reading directory data for directory" << directoryRecord.directoryName;
+    TraceScope trace("model", "AdfsDirectoryModel::populateDirectory");
+
+    AdfsCatalogue::addChildNodes(&nodes, &nodeNames, nodeNumber, directoryRecord);
+}
+
+qint32 AdfsDirectoryModel::getNodeNumber(const QModelIndex &index) const
+{
+    return static_cast<qint32>(index.internalId());
 }
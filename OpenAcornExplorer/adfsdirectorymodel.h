@@ -31,18 +31,27 @@
 #include <QModelIndex>
 #include <QVariant>
 
-#include "adfsdirectoryitem.h"
-#include "discimage.h"
-#include "adfsdirectory.h"
-
-class AdfsDirectoryItem;
+#include <QHash>
+#include <QVector>
 
+#include "adfsimage.h"
+#include "adfsdirectory.h"
+#include "adfscatalogue.h"
+
+// Item model of the directories and files on an ADFS disc image.  The model is
+// held as a flat array of compact nodes (the same nodes as the catalogue) with
+// the names in a single Latin-1 name table; the children of a directory are
+// added together when it is first expanded, so occupy a contiguous range of
+// nodes.  A model index refers to its node by number, and each node holds its
+// parent and row, so parent() does not search.  Display strings are only
+// formatted when the view asks for them
 class AdfsDirectoryModel : public QAbstractItemModel
 {
     Q_OBJECT
 
 public:
-    AdfsDirectoryModel(DiscImage discImage, QObject *parent = 0);
+    AdfsDirectoryModel(AdfsImage *adfsImageParam, QObject *parent = 0);
+    AdfsDirectoryModel(AdfsImage *adfsImageParam, const AdfsDirectoryRecord &rootDirectoryRecord, QObject *parent = 0);
     ~AdfsDirectoryModel();
 
     QVariant data(const QModelIndex &index, int role) const override;
@@ -56,27 +65,31 @@ public:
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     int columnCount(const QModelIndex &parent = QModelIndex()) const override;
 
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+    void addDirectoryRecords(const QVector<AdfsDirectoryRecord> &directoryRecords);
+    QModelIndex findPath(const QString &path);
+
     Qt::ItemFlags flags(const QModelIndex &index) const override;
-    bool setData(const QModelIndex &index, const QVariant &value,
-                 int role = Qt::EditRole) override;
-    bool setHeaderData(int section, Qt::Orientation orientation,
-                       const QVariant &value, int role = Qt::EditRole) override;
-
-    bool insertColumns(int position, int columns,
-                       const QModelIndex &parent = QModelIndex()) override;
-    bool removeColumns(int position, int columns,
-                       const QModelIndex &parent = QModelIndex()) override;
-    bool insertRows(int position, int rows,
-                    const QModelIndex &parent = QModelIndex()) override;
-    bool removeRows(int position, int rows,
-                    const QModelIndex &parent = QModelIndex()) override;
 
 private:
-    void initialiseAdfsRootDirectory(DiscImage *discImage, AdfsDirectoryItem *parent);
-    void populateDirectory(DiscImage *discImage, AdfsDirectoryItem *parent, qint64 directorySector);
-    AdfsDirectoryItem *getItem(const QModelIndex &index) const;
+    void initialiseAdfsRootDirectory(const AdfsDirectoryRecord &directoryRecord);
+    bool readDirectory(qint64 directorySector, AdfsDirectoryRecord *directoryRecord);
+    void populateDirectory(qint32 nodeNumber, const AdfsDirectoryRecord &directoryRecord);
+    qint32 getNodeNumber(const QModelIndex &index) const;
+
+    AdfsImage *adfsImage;
+
+    // Node 0 is the root directory (the only top level row).  A directory is not
+    // populated until it has been read
+    QVector<AdfsCatalogueNode> nodes;
+    AdfsNameTable nodeNames;
 
-    AdfsDirectoryItem *rootItem;
+    // Directories read in advance (by a background scan) that have not yet been
+    // added to the model, keyed by directory sector
+    QHash<qint64, AdfsDirectoryRecord> prefetchedDirectories;
 };
 
 #endif // ADFSDIRECTORYMODEL_H
@@ -0,0 +1,337 @@
+/************************************************************************
+
+    adfsfileextractor.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "adfsfileextractor.h"
+#include "logcategories.h"
+
+#include <QDir>
+#include <QFile>
+#include <QThreadPool>
+#include <QRunnable>
+
+// Sectors read from the image in each run (64K with 256 byte sectors)
+static const qint64 sectorsPerChunk = 256;
+
+// Chunks that may be read ahead of the writer
+static const qint64 maximumQueuedChunks = 8;
+
+// Runs the extractor's reader on a pool thread
+class AdfsFileExtractorReader : public QRunnable
+{
+public:
+    AdfsFileExtractorReader(AdfsFileExtractor *extractorParam) : extractor(extractorParam) {}
+
+    void run() override { extractor->runReader(); }
+
+private:
+    AdfsFileExtractor *extractor;
+};
+
+// Class constructor
+// Note: The ADFS image is not owned by the extractor
+AdfsFileExtractor::AdfsFileExtractor(AdfsImage *adfsImageParam)
+{
+    adfsImage = adfsImageParam;
+    writeInfFiles = true;
+    readerFinished = false;
+}
+
+// Set whether a .inf file is written alongside each extracted file (default on)
+void AdfsFileExtractor::setWriteInfFiles(bool writeInfFilesParam)
+{
+    writeInfFiles = writeInfFilesParam;
+}
+
+// Extract catalogue nodes into the target directory; directories are extracted
+// with everything below them
+// Returns false if any file could not be extracted
+bool AdfsFileExtractor::extract(const AdfsCatalogue &catalogue, const QVector<qint64> &nodeNumbers, const QString &targetDirectory)
+{
+    statistics = AdfsExtractionStatistics();
+    extractionFiles.clear();
+
+    if (!QDir().mkpath(targetDirectory)) {
+        qCDebug(lcFiles) << "AdfsFileExtractor::extract(): Cannot create directory" << targetDirectory;
+        statistics.failures++;
+        return false;
+    }
+
+    // Create the directories and list the files to extract
+    for (qint64 nodeNumber : nodeNumbers) {
+        if (nodeNumber < 0 || nodeNumber >= catalogue.getNumberOfNodes()) {
+            qCDebug(lcFiles) << "AdfsFileExtractor::extract(): Node" << nodeNumber << "is not in the catalogue";
+            statistics.failures++;
+            continue;
+        }
+        addNode(catalogue, nodeNumber, targetDirectory);
+    }
+
+    // Read the file data on a pool thread whilst writing it on this one
+    chunkQueue.clear();
+    readerFinished = false;
+
+    QThreadPool readerPool;
+    readerPool.setMaxThreadCount(1);
+    readerPool.start(new AdfsFileExtractorReader(this));
+    writeFiles();
+    readerPool.waitForDone();
+
+    extractionFiles.clear();
+
+    return statistics.failures == 0;
+}
+
+// Extract a file, or a directory and everything below it, into the target directory
+bool AdfsFileExtractor::extractSubtree(const AdfsCatalogue &catalogue, qint64 nodeNumber, const QString &targetDirectory)
+{
+    return extract(catalogue, QVector<qint64>() << nodeNumber, targetDirectory);
+}
+
+// Get the statistics for the last extraction
+AdfsExtractionStatistics AdfsFileExtractor::getStatistics()
+{
+    return statistics;
+}
+
+// Convert an ADFS file name to a host file name
+// Note: As on RISC OS, '/' in an ADFS name becomes '.' on the host; characters
+// that are not valid in host file names are replaced with '_'
+QString AdfsFileExtractor::getHostFileName(const QString &adfsFileName)
+{
+    QString hostFileName = adfsFileName;
+
+    for (qint64 position = 0; position < hostFileName.size(); position++) {
+        QChar character = hostFileName.at(position);
+
+        if (character == '/') hostFileName[position] = '.';
+        else if (character < ' ' || QString("\\:*?\"<>|").contains(character)) hostFileName[position] = '_';
+    }
+
+    if (hostFileName.isEmpty() || hostFileName == "." || hostFileName == "..") hostFileName.replace('.', '_').append('_');
+
+    return hostFileName;
+}
+
+// Get the contents of the .inf file for an entry:
+//   <name> <load address> <execution address> <length> <access>
+// The access byte uses the RISC OS bit layout (R=1, W=2, L=8, r=16, w=32)
+QByteArray AdfsFileExtractor::getInfData(const QString &adfsFileName, const AdfsDirectoryEntry &entry)
+{
+    qint64 access = 0;
+    if (entry.isReadable()) access |= 0x01;
+    if (entry.isWritable()) access |= 0x02;
+    if (entry.isLocked()) access |= 0x08;
+    if (entry.attributes & AdfsDirectoryEntry::PublicReadable) access |= 0x10;
+    if (entry.attributes & AdfsDirectoryEntry::PublicWritable) access |= 0x20;
+
+    QString infData = QString("%1 %2 %3 %4 %5\n")
+            .arg(adfsFileName, -10)
+            .arg(QString::number(entry.loadAddress, 16).toUpper().rightJustified(8, '0'))
+            .arg(QString::number(entry.executionAddress, 16).toUpper().rightJustified(8, '0'))
+            .arg(QString::number(entry.length, 16).toUpper().rightJustified(8, '0'))
+            .arg(QString::number(access, 16).toUpper().rightJustified(2, '0'));
+
+    return infData.toLatin1();
+}
+
+// Reader - read the data of each file in chunks of its extents and queue it for the writer
+void AdfsFileExtractor::runReader()
+{
+    DiscImage *discImage = adfsImage->getDiscImage();
+    qint64 bytesPerChunk = sectorsPerChunk * discImage->getSectorSize();
+
+    for (qint64 fileNumber = 0; fileNumber < extractionFiles.size(); fileNumber++) {
+        const AdfsDirectoryEntry &entry = extractionFiles.at(fileNumber).entry;
+
+        ExtractionChunk chunk;
+        chunk.fileNumber = fileNumber;
+        chunk.lastChunk = false;
+        chunk.readFailed = false;
+
+        // Empty files still need a chunk so the writer creates them
+        if (entry.length == 0) {
+            chunk.lastChunk = true;
+            queueChunk(chunk);
+            continue;
+        }
+
+        // Find where the file is held on the disc (several extents if the file
+        // is fragmented on a new map disc)
+        QVector<AdfsDiscExtent> extents;
+        if (!adfsImage->getObjectExtents(entry.startSector, entry.length, &extents)) {
+            chunk.lastChunk = true;
+            chunk.readFailed = true;
+            queueChunk(chunk);
+            continue;
+        }
+
+        qint64 remainingBytes = entry.length;
+        for (const AdfsDiscExtent &extent : extents) {
+            for (qint64 extentPosition = 0; extentPosition < extent.length && !chunk.readFailed;) {
+                qint64 chunkBytes = qMin(bytesPerChunk, extent.length - extentPosition);
+                qint64 bytePosition = extent.bytePosition + extentPosition;
+
+                // Use the mapped image data directly if possible, otherwise read the bytes
+                DiscSectorView chunkView = discImage->getByteView(bytePosition, chunkBytes);
+                if (!chunkView.isNull()) {
+                    chunk.data = chunkView.toRawByteArray();
+                } else {
+                    chunk.data.resize(static_cast<int>(chunkBytes));
+                    if (!discImage->readBytes(bytePosition, chunkBytes, chunk.data.data())) {
+                        chunk.data.clear();
+                        chunk.readFailed = true;
+                    }
+                }
+
+                extentPosition += chunkBytes;
+                remainingBytes -= chunkBytes;
+                chunk.lastChunk = (remainingBytes == 0) || chunk.readFailed;
+
+                queueChunk(chunk);
+            }
+
+            if (chunk.readFailed) break;
+        }
+    }
+
+    QMutexLocker locker(&queueMutex);
+    readerFinished = true;
+    chunkQueued.wakeAll();
+}
+
+// Private methods
+
+// Create the host directory for a directory node (and its children), or list a
+// file node for extraction
+bool AdfsFileExtractor::addNode(const AdfsCatalogue &catalogue, qint64 nodeNumber, const QString &hostDirectory)
+{
+    const AdfsCatalogueNode &node = catalogue.getNode(nodeNumber);
+    QString name = catalogue.getNodeName(nodeNumber);
+    QString hostPath = QDir(hostDirectory).filePath(getHostFileName(name));
+
+    if (!node.isDirectory()) {
+        ExtractionFile extractionFile;
+        extractionFile.name = name;
+        extractionFile.hostPath = hostPath;
+        extractionFile.entry = node.entry;
+        extractionFiles.append(extractionFile);
+        return true;
+    }
+
+    if (!QDir().mkpath(hostPath)) {
+        qCDebug(lcFiles) << "AdfsFileExtractor::addNode(): Cannot create directory" << hostPath;
+        statistics.failures++;
+        return false;
+    }
+    statistics.directories++;
+
+    for (qint64 child = node.firstChild; child < node.firstChild + node.childCount; child++) {
+        addNode(catalogue, child, hostPath);
+    }
+
+    return true;
+}
+
+// Writer - write the queued chunks to the host files as they are read
+void AdfsFileExtractor::writeFiles()
+{
+    QFile hostFile;
+    bool fileFailed = false;
+    ExtractionChunk chunk;
+
+    while (takeChunk(&chunk)) {
+        const ExtractionFile &extractionFile = extractionFiles.at(chunk.fileNumber);
+
+        // Open the host file on its first chunk
+        if (!hostFile.isOpen() && !fileFailed) {
+            hostFile.setFileName(extractionFile.hostPath);
+            if (!hostFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                qCDebug(lcFiles) << "AdfsFileExtractor::writeFiles(): Cannot create file" << extractionFile.hostPath;
+                fileFailed = true;
+            }
+        }
+
+        if (chunk.readFailed) {
+            qCDebug(lcFiles) << "AdfsFileExtractor::writeFiles(): Cannot read the data for" << extractionFile.name;
+            fileFailed = true;
+        }
+
+        if (!fileFailed && hostFile.write(chunk.data) != chunk.data.size()) {
+            qCDebug(lcFiles) << "AdfsFileExtractor::writeFiles(): Cannot write to file" << extractionFile.hostPath;
+            fileFailed = true;
+        }
+
+        if (!chunk.lastChunk) continue;
+
+        // Complete the file (removing anything partially written)
+        if (hostFile.isOpen()) hostFile.close();
+
+        if (!fileFailed && writeInfFiles) {
+            QFile infFile(extractionFile.hostPath + ".inf");
+            if (!infFile.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+                    infFile.write(getInfData(extractionFile.name, extractionFile.entry)) < 0) {
+                qCDebug(lcFiles) << "AdfsFileExtractor::writeFiles(): Cannot write file" << infFile.fileName();
+                fileFailed = true;
+            }
+        }
+
+        if (fileFailed) {
+            QFile::remove(extractionFile.hostPath);
+            statistics.failures++;
+        } else {
+            statistics.files++;
+            statistics.bytesWritten += extractionFile.entry.length;
+        }
+
+        fileFailed = false;
+    }
+}
+
+// Add a chunk to the queue, waiting whilst the queue is full
+void AdfsFileExtractor::queueChunk(const ExtractionChunk &chunk)
+{
+    QMutexLocker locker(&queueMutex);
+
+    while (chunkQueue.size() >= maximumQueuedChunks) chunkTaken.wait(&queueMutex);
+    chunkQueue.append(chunk);
+    chunkQueued.wakeOne();
+}
+
+// Take the next chunk from the queue, waiting whilst the queue is empty
+// Returns false once the reader has finished and the queue is empty
+bool AdfsFileExtractor::takeChunk(ExtractionChunk *chunk)
+{
+    QMutexLocker locker(&queueMutex);
+
+    while (chunkQueue.isEmpty() && !readerFinished) chunkQueued.wait(&queueMutex);
+    if (chunkQueue.isEmpty()) return false;
+
+    *chunk = chunkQueue.takeFirst();
+    chunkTaken.wakeOne();
+
+    return true;
+}
@@ -0,0 +1,107 @@
+/************************************************************************
+
+    adfsfileextractor.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef ADFSFILEEXTRACTOR_H
+#define ADFSFILEEXTRACTOR_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QList>
+#include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "adfsimage.h"
+#include "adfscatalogue.h"
+
+// File extraction statistics
+struct AdfsExtractionStatistics
+{
+    qint64 files = 0;           // Number of files extracted
+    qint64 directories = 0;     // Number of directories created
+    qint64 bytesWritten = 0;    // Number of bytes of file data written
+    qint64 failures = 0;        // Number of files that could not be read or written
+};
+
+// Extracts files and directories from an ADFS image to the host file system.
+// File data is read from the image in large runs of sectors on a reader thread
+// whilst the calling thread writes the previous runs to disc, so extraction is
+// limited by the host's I/O rather than by per-sector reads.  Each file can be
+// accompanied by a .inf file holding its load and execution addresses
+class AdfsFileExtractor
+{
+public:
+    AdfsFileExtractor(AdfsImage *adfsImageParam);
+
+    void setWriteInfFiles(bool writeInfFilesParam);
+    bool extract(const AdfsCatalogue &catalogue, const QVector<qint64> &nodeNumbers, const QString &targetDirectory);
+    bool extractSubtree(const AdfsCatalogue &catalogue, qint64 nodeNumber, const QString &targetDirectory);
+    AdfsExtractionStatistics getStatistics();
+
+    static QString getHostFileName(const QString &adfsFileName);
+    static QByteArray getInfData(const QString &adfsFileName, const AdfsDirectoryEntry &entry);
+
+    void runReader();
+
+private:
+    Q_DISABLE_COPY(AdfsFileExtractor)
+
+    // A file waiting to be extracted
+    struct ExtractionFile {
+        QString name;
+        QString hostPath;
+        AdfsDirectoryEntry entry;
+    };
+
+    // A run of file data passed from the reader to the writer
+    struct ExtractionChunk {
+        qint64 fileNumber;
+        QByteArray data;
+        bool lastChunk;
+        bool readFailed;
+    };
+
+    AdfsImage *adfsImage;
+    bool writeInfFiles;
+
+    QVector<ExtractionFile> extractionFiles;
+    AdfsExtractionStatistics statistics;
+
+    // Chunks read but not yet written
+    QMutex queueMutex;
+    QWaitCondition chunkQueued;
+    QWaitCondition chunkTaken;
+    QList<ExtractionChunk> chunkQueue;
+    bool readerFinished;
+
+    bool addNode(const AdfsCatalogue &catalogue, qint64 nodeNumber, const QString &hostDirectory);
+    void writeFiles();
+    void queueChunk(const ExtractionChunk &chunk);
+    bool takeChunk(ExtractionChunk *chunk);
+};
+
+#endif // ADFSFILEEXTRACTOR_H
@@ -0,0 +1,162 @@
+/************************************************************************
+
+    adfsfilehasher.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+#include "adfsfilehasher.h"
+#include "logcategories.h"
+#include "compressedimagefile.h"
+#include "xxhash64.h"
+
+#include <QCryptographicHash>
+#include <QScopedPointer>
+
+// Bytes read from the image (or image file) at a time
+static const qint64 bytesPerRead = 64 * 1024;
+
+AdfsFileHasher::AdfsFileHasher(AdfsImage *adfsImageParam)
+{
+    adfsImage = adfsImageParam;
+    sha256Enabled = false;
+    bytesHashed = 0;
+}
+
+// Also hash each file with SHA-256 (in addition to XXH64)
+void AdfsFileHasher::setSha256Enabled(bool sha256EnabledParam)
+{
+    sha256Enabled = sha256EnabledParam;
+}
+
+// Hash every file in the catalogue; returns false if any file could not be read
+bool AdfsFileHasher::hash(const AdfsCatalogue &catalogue)
+{
+    fileHashes.clear();
+    fileHashes.reserve(static_cast<int>(catalogue.getNumberOfFiles()));
+    bytesHashed = 0;
+
+    bool allFilesHashed = true;
+    for (qint64 nodeNumber = 0; nodeNumber < catalogue.getNumberOfNodes(); nodeNumber++) {
+        const AdfsCatalogueNode &node = catalogue.getNode(nodeNumber);
+        if (node.isDirectory()) continue;
+
+        AdfsContentHash fileHash;
+        fileHash.nodeNumber = nodeNumber;
+        fileHash.length = node.entry.length;
+        fileHash.valid = hashFile(node.entry, &fileHash);
+        if (!fileHash.valid) allFilesHashed = false;
+
+        fileHashes.append(fileHash);
+    }
+
+    return allFilesHashed;
+}
+
+// Get the hashes of the files, in catalogue order
+const QVector<AdfsContentHash> &AdfsFileHasher::getFileHashes() const
+{
+    return fileHashes;
+}
+
+qint64 AdfsFileHasher::getBytesHashed() const
+{
+    return bytesHashed;
+}
+
+// Hash the whole of a disc image file, so that identical images can be found
+bool AdfsFileHasher::hashImageFile(const QString &filename, bool sha256Enabled, AdfsContentHash *imageHash)
+{
+    // Compressed images are hashed by their uncompressed contents, so that they
+    // match the same image uncompressed
+    QScopedPointer<QIODevice> imageFile(CompressedImageFile::createImageDevice(filename));
+    if (!imageFile->open(QIODevice::ReadOnly)) {
+        qCDebug(lcFiles) << "AdfsFileHasher::hashImageFile(): Cannot open disc image" << filename;
+        return false;
+    }
+
+    XxHash64 xxHash64;
+    QCryptographicHash sha256(QCryptographicHash::Sha256);
+    QByteArray buffer(static_cast<int>(bytesPerRead), 0);
+
+    imageHash->length = 0;
+    while (!imageFile->atEnd()) {
+        qint64 bytesRead = imageFile->read(buffer.data(), bytesPerRead);
+        if (bytesRead < 0) {
+            qCDebug(lcFiles) << "AdfsFileHasher::hashImageFile(): Cannot read disc image" << filename;
+            return false;
+        }
+
+        xxHash64.addData(buffer.constData(), bytesRead);
+        if (sha256Enabled) sha256.addData(buffer.constData(), static_cast<int>(bytesRead));
+        imageHash->length += bytesRead;
+    }
+
+    imageHash->xxHash64 = xxHash64.result();
+    if (sha256Enabled) imageHash->sha256 = sha256.result();
+    imageHash->valid = true;
+
+    return true;
+}
+
+// Private methods
+
+// Hash the contents of a file, reading each of its extents in turn
+bool AdfsFileHasher::hashFile(const AdfsDirectoryEntry &entry, AdfsContentHash *fileHash)
+{
+    DiscImage *discImage = adfsImage->getDiscImage();
+
+    XxHash64 xxHash64;
+    QCryptographicHash sha256(QCryptographicHash::Sha256);
+
+    QVector<AdfsDiscExtent> extents;
+    if (!adfsImage->getObjectExtents(entry.startSector, entry.length, &extents)) return false;
+
+    for (const AdfsDiscExtent &extent : extents) {
+        for (qint64 extentPosition = 0; extentPosition < extent.length;) {
+            qint64 readLength = qMin(bytesPerRead, extent.length - extentPosition);
+            qint64 bytePosition = extent.bytePosition + extentPosition;
+
+            // Hash mapped image data in place, otherwise read it into the buffer
+            const char *data;
+            DiscSectorView view = discImage->getByteView(bytePosition, readLength);
+            if (!view.isNull()) {
+                data = reinterpret_cast<const char *>(view.data());
+            } else {
+                if (readBuffer.size() < readLength) readBuffer.resize(static_cast<int>(readLength));
+                if (!discImage->readBytes(bytePosition, readLength, readBuffer.data())) return false;
+                data = readBuffer.constData();
+            }
+
+            xxHash64.addData(data, readLength);
+            if (sha256Enabled) sha256.addData(data, static_cast<int>(readLength));
+
+            extentPosition += readLength;
+            bytesHashed += readLength;
+        }
+    }
+
+    fileHash->xxHash64 = xxHash64.result();
+    if (sha256Enabled) fileHash->sha256 = sha256.result();
+
+    return true;
+}
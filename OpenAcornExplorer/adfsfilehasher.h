@@ -0,0 +1,75 @@
+/************************************************************************
+
+    adfsfilehasher.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+#ifndef ADFSFILEHASHER_H
+#define ADFSFILEHASHER_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QVector>
+
+#include "adfsimage.h"
+#include "adfscatalogue.h"
+
+// Content hash of a file (or of a whole disc image)
+struct AdfsContentHash
+{
+    qint64 nodeNumber = -1;     // Catalogue node of the file (-1 for a disc image)
+    qint64 length = 0;
+    quint64 xxHash64 = 0;
+    QByteArray sha256;          // Empty unless SHA-256 hashing is enabled
+    bool valid = false;         // False if the contents could not be read
+};
+
+// Hashes the contents of every file in a catalogue as it is read from the disc
+// image.  Each file is always hashed with XXH64; SHA-256 can be added where a
+// cryptographic hash is needed.  Files in a single extent of a mapped image are
+// hashed in place without being copied
+class AdfsFileHasher
+{
+public:
+    AdfsFileHasher(AdfsImage *adfsImageParam);
+
+    void setSha256Enabled(bool sha256EnabledParam);
+    bool hash(const AdfsCatalogue &catalogue);
+    const QVector<AdfsContentHash> &getFileHashes() const;
+    qint64 getBytesHashed() const;
+
+    static bool hashImageFile(const QString &filename, bool sha256Enabled, AdfsContentHash *imageHash);
+
+private:
+    AdfsImage *adfsImage;
+    bool sha256Enabled;
+    QVector<AdfsContentHash> fileHashes;
+    qint64 bytesHashed;
+
+    // Buffer for data that cannot be hashed in place
+    QByteArray readBuffer;
+
+    bool hashFile(const AdfsDirectoryEntry &entry, AdfsContentHash *fileHash);
+};
+
+#endif // ADFSFILEHASHER_H
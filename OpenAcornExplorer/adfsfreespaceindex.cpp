@@ -0,0 +1,244 @@
+/************************************************************************
+
+    adfsfreespaceindex.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "adfsfreespaceindex.h"
+#include "logcategories.h"
+
+AdfsFreeSpaceIndex::AdfsFreeSpaceIndex()
+{
+    freeSectors = 0;
+    totalSectors = 0;
+    maximumExtents = 0;
+}
+
+// Build the index from a (valid) free space map
+// Note: Adjacent entries are merged; overlapping or out of range entries make
+// the map invalid and leave the index empty
+bool AdfsFreeSpaceIndex::build(AdfsFreeSpaceMap *freeSpaceMap)
+{
+    clear();
+    totalSectors = freeSpaceMap->getTotalSectorsOnDisc();
+    maximumExtents = freeSpaceMap->getMaximumFreeSpaceEntries();
+
+    // Decode each entry once
+    QMap<qint64, qint64> entries;
+    for (qint64 freeSpaceNumber = 0; freeSpaceNumber < freeSpaceMap->getNumberOfFreeSpaceEntries(); freeSpaceNumber++) {
+        qint64 startSector = freeSpaceMap->getFreeSpaceStartSector(freeSpaceNumber);
+        qint64 length = freeSpaceMap->getFreeSpaceLength(freeSpaceNumber);
+
+        if (length < 1 || startSector + length > totalSectors || entries.contains(startSector)) {
+            qCDebug(lcMap) << "AdfsFreeSpaceIndex::build(): Error, free space entry" << freeSpaceNumber << "is not valid";
+            clear();
+            return false;
+        }
+        entries.insert(startSector, length);
+    }
+
+    // Add the entries in sector order, merging any that are adjacent
+    qint64 extentStart = -1;
+    qint64 extentLength = 0;
+    for (QMap<qint64, qint64>::const_iterator i = entries.constBegin(); i != entries.constEnd(); ++i) {
+        if (extentStart >= 0 && i.key() < extentStart + extentLength) {
+            qCDebug(lcMap) << "AdfsFreeSpaceIndex::build(): Error, free space entries overlap at sector" << i.key();
+            clear();
+            return false;
+        }
+
+        if (extentStart >= 0 && i.key() == extentStart + extentLength) {
+            extentLength += i.value();
+            continue;
+        }
+
+        if (extentStart >= 0) insertExtent(extentStart, extentLength);
+        extentStart = i.key();
+        extentLength = i.value();
+    }
+    if (extentStart >= 0) insertExtent(extentStart, extentLength);
+
+    return true;
+}
+
+// Write the free extents back to the free space map (recalculating its checksums)
+bool AdfsFreeSpaceIndex::writeToMap(AdfsFreeSpaceMap *freeSpaceMap)
+{
+    return freeSpaceMap->setFreeSpaceEntries(extentsByStart);
+}
+
+void AdfsFreeSpaceIndex::clear()
+{
+    extentsByStart.clear();
+    extentsByLength.clear();
+    freeSectors = 0;
+}
+
+// Allocate a run of contiguous sectors, returning the start sector or -1 if no
+// free extent is large enough
+// Note: Sectors are taken from the start of the chosen extent, so allocating
+// never increases the number of free extents
+qint64 AdfsFreeSpaceIndex::allocate(qint64 numberOfSectors, AllocationPolicy policy)
+{
+    if (numberOfSectors < 1) return -1;
+
+    qint64 startSector = -1;
+    qint64 length = 0;
+
+    if (policy == BestFit) {
+        // The smallest sufficient length; of equal lengths, the lowest start sector
+        QMultiMap<qint64, qint64>::const_iterator i = extentsByLength.lowerBound(numberOfSectors);
+        if (i == extentsByLength.constEnd()) return -1;
+
+        length = i.key();
+        startSector = i.value();
+        for (; i != extentsByLength.constEnd() && i.key() == length; ++i) startSector = qMin(startSector, i.value());
+    } else {
+        // The lowest start sector of sufficient length (the largest extent
+        // gives an early exit if nothing will fit)
+        if (getLargestFreeExtent() < numberOfSectors) return -1;
+
+        for (QMap<qint64, qint64>::const_iterator i = extentsByStart.constBegin(); i != extentsByStart.constEnd(); ++i) {
+            if (i.value() >= numberOfSectors) {
+                startSector = i.key();
+                length = i.value();
+                break;
+            }
+        }
+    }
+
+    removeExtent(startSector, length);
+    if (length > numberOfSectors) insertExtent(startSector + numberOfSectors, length - numberOfSectors);
+
+    return startSector;
+}
+
+// Free a run of sectors, merging it with the neighbouring free extents
+// Note: Fails if any of the sectors are already free, or if the old map's
+// free space list has no room for another extent
+bool AdfsFreeSpaceIndex::free(qint64 startSector, qint64 numberOfSectors)
+{
+    if (numberOfSectors < 1 || startSector < 0 || startSector + numberOfSectors > totalSectors) {
+        qCDebug(lcMap) << "AdfsFreeSpaceIndex::free(): Error, sectors" << startSector << "to" << startSector + numberOfSectors - 1 << "are not on the disc";
+        return false;
+    }
+
+    // Find the free extents either side
+    QMap<qint64, qint64>::const_iterator next = extentsByStart.lowerBound(startSector);
+    bool hasNext = (next != extentsByStart.constEnd());
+    bool hasPrevious = (next != extentsByStart.constBegin());
+    qint64 previousStart = 0;
+    qint64 previousLength = 0;
+    if (hasPrevious) {
+        QMap<qint64, qint64>::const_iterator previous = next;
+        --previous;
+        previousStart = previous.key();
+        previousLength = previous.value();
+    }
+
+    if ((hasNext && next.key() < startSector + numberOfSectors) ||
+            (hasPrevious && previousStart + previousLength > startSector)) {
+        qCDebug(lcMap) << "AdfsFreeSpaceIndex::free(): Error, sectors" << startSector << "to" << startSector + numberOfSectors - 1 << "are already free";
+        return false;
+    }
+
+    bool mergePrevious = hasPrevious && previousStart + previousLength == startSector;
+    bool mergeNext = hasNext && next.key() == startSector + numberOfSectors;
+
+    if (!mergePrevious && !mergeNext && extentsByStart.size() >= maximumExtents) {
+        qCDebug(lcMap) << "AdfsFreeSpaceIndex::free(): Error, the free space map is full";
+        return false;
+    }
+
+    qint64 extentStart = startSector;
+    qint64 extentLength = numberOfSectors;
+
+    if (mergeNext) {
+        qint64 nextStart = next.key();
+        qint64 nextLength = next.value();
+        removeExtent(nextStart, nextLength);
+        extentLength += nextLength;
+    }
+
+    if (mergePrevious) {
+        removeExtent(previousStart, previousLength);
+        extentStart = previousStart;
+        extentLength += previousLength;
+    }
+
+    insertExtent(extentStart, extentLength);
+
+    return true;
+}
+
+// Get the length of the largest free extent (in sectors)
+qint64 AdfsFreeSpaceIndex::getLargestFreeExtent() const
+{
+    if (extentsByLength.isEmpty()) return 0;
+    return extentsByLength.lastKey();
+}
+
+// Get the total number of free sectors
+qint64 AdfsFreeSpaceIndex::getFreeSectors() const
+{
+    return freeSectors;
+}
+
+qint64 AdfsFreeSpaceIndex::getNumberOfFreeExtents() const
+{
+    return extentsByStart.size();
+}
+
+// Get the free extents (start sector -> length) in sector order
+const QMap<qint64, qint64> &AdfsFreeSpaceIndex::getFreeExtents() const
+{
+    return extentsByStart;
+}
+
+// Determine if a sector is free
+bool AdfsFreeSpaceIndex::isFree(qint64 sector) const
+{
+    QMap<qint64, qint64>::const_iterator next = extentsByStart.upperBound(sector);
+    if (next == extentsByStart.constBegin()) return false;
+
+    QMap<qint64, qint64>::const_iterator extent = next;
+    --extent;
+    return sector < extent.key() + extent.value();
+}
+
+// Private methods
+
+void AdfsFreeSpaceIndex::insertExtent(qint64 startSector, qint64 length)
+{
+    extentsByStart.insert(startSector, length);
+    extentsByLength.insert(length, startSector);
+    freeSectors += length;
+}
+
+void AdfsFreeSpaceIndex::removeExtent(qint64 startSector, qint64 length)
+{
+    extentsByStart.remove(startSector);
+    extentsByLength.remove(length, startSector);
+    freeSectors -= length;
+}
@@ -0,0 +1,76 @@
+/************************************************************************
+
+    adfsfreespaceindex.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef ADFSFREESPACEINDEX_H
+#define ADFSFREESPACEINDEX_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QMap>
+#include <QMultiMap>
+
+#include "adfsfreespacemap.h"
+
+// An in-memory index of the free extents (runs of free sectors) in an ADFS old
+// map.  The index is built once from the free space map and kept sorted both by
+// start sector and by length, so sectors can be allocated and freed without
+// rescanning the map; it is written back to the map with writeToMap()
+class AdfsFreeSpaceIndex
+{
+public:
+    enum AllocationPolicy {
+        FirstFit,   // Allocate from the free extent nearest the start of the disc
+        BestFit     // Allocate from the smallest free extent that is large enough
+    };
+
+    AdfsFreeSpaceIndex();
+
+    bool build(AdfsFreeSpaceMap *freeSpaceMap);
+    bool writeToMap(AdfsFreeSpaceMap *freeSpaceMap);
+    void clear();
+
+    qint64 allocate(qint64 numberOfSectors, AllocationPolicy policy = FirstFit);
+    bool free(qint64 startSector, qint64 numberOfSectors);
+
+    qint64 getLargestFreeExtent() const;
+    qint64 getFreeSectors() const;
+    qint64 getNumberOfFreeExtents() const;
+    const QMap<qint64, qint64> &getFreeExtents() const;
+    bool isFree(qint64 sector) const;
+
+private:
+    QMap<qint64, qint64> extentsByStart;        // Start sector -> length
+    QMultiMap<qint64, qint64> extentsByLength;  // Length -> start sector
+    qint64 freeSectors;
+    qint64 totalSectors;
+    qint64 maximumExtents;
+
+    void insertExtent(qint64 startSector, qint64 length);
+    void removeExtent(qint64 startSector, qint64 length);
+};
+
+#endif // ADFSFREESPACEINDEX_H
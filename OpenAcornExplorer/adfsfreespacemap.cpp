@@ -25,6 +25,8 @@
 ************************************************************************/
 
 #include "adfsfreespacemap.h"
+#include "logcategories.h"
+#include "tracerecorder.h"
 
 AdfsFreeSpaceMap::AdfsFreeSpaceMap()
 {
@@ -35,6 +37,9 @@ AdfsFreeSpaceMap::AdfsFreeSpaceMap()
 // Note: Should this also need the sector size?
 bool AdfsFreeSpaceMap::setMap(QByteArray freeSpaceMapDataParam)
 {
+    TraceScope trace("parse", "AdfsFreeSpaceMap::setMap");
+    trace.setBytes(freeSpaceMapDataParam.size());
+
     bool freeSpaceMapValid = false;
 
     // Copy the free space map data into the object
@@ -56,11 +61,11 @@ bool AdfsFreeSpaceMap::setMap(QByteArray freeSpaceMapDataParam)
     } else {
         // Checksums are not valid
         if (discChecksumSector0 != calcChecksumSector0)
-            qDebug() << "AdfsFreeSpaceMap::setMap(): Error, sector 0 checksum is invalid! Calculated =" << calcChecksumSector0 <<
+            qCDebug(lcMap) << "AdfsFreeSpaceMap::setMap(): Error, sector 0 checksum is invalid! Calculated =" << calcChecksumSector0 <<
                         " on disc =" << discChecksumSector0;
 
         if (discChecksumSector1 != calcChecksumSector1)
-            qDebug() << "AdfsFreeSpaceMap::setMap(): Error, sector 1 checksum is invalid! Calculated =" << calcChecksumSector1 <<
+            qCDebug(lcMap) << "AdfsFreeSpaceMap::setMap(): Error, sector 1 checksum is invalid! Calculated =" << calcChecksumSector1 <<
                         " on disc =" << discChecksumSector1;
     }
 
@@ -77,12 +82,18 @@ qint64 AdfsFreeSpaceMap::getFreeSpaceStartSector(qint64 freeSpaceNumber)
 qint64 AdfsFreeSpaceMap::getFreeSpaceLength(qint64 freeSpaceNumber)
 {
     // Stored in sector 1
-    qint64 offset = 255 + (freeSpaceNumber * 3); // 3 bytes per record - maximum of 82 entries
+    qint64 offset = sectorSize + (freeSpaceNumber * 3); // 3 bytes per record - maximum of 82 entries
 
     // Returned free space length is in number of sectors
     return convertBytesToInt(freeSpaceMapData->at(offset + 2), freeSpaceMapData->at(offset + 1), freeSpaceMapData->at(offset));
 }
 
+qint64 AdfsFreeSpaceMap::getNumberOfFreeSpaceEntries()
+{
+    // Byte 254 of sector 1 points to the end of the free space list
+    return (quint8)freeSpaceMapData->at(sectorSize + 254) / 3;
+}
+
 qint64 AdfsFreeSpaceMap::getTotalSectorsOnDisc()
 {
     // Bytes 252-254 of sector 0
@@ -101,6 +112,57 @@ qint64 AdfsFreeSpaceMap::getBootOptionNumber()
     return freeSpaceMapData->at(sectorSize + 253);
 }
 
+// Get the maximum number of entries in the free space list
+qint64 AdfsFreeSpaceMap::getMaximumFreeSpaceEntries()
+{
+    // 3 bytes per record in the first 246 bytes of each sector
+    return 82;
+}
+
+// Replace the free space list with the supplied entries (start sector ->
+// length in sectors) and recalculate the checksums
+// Note: The map must already have been set, as the other fields are preserved
+bool AdfsFreeSpaceMap::setFreeSpaceEntries(const QMap<qint64, qint64> &freeSpaceEntries)
+{
+    if (freeSpaceMapData->size() < sectorSize * 2) {
+        qCDebug(lcMap) << "AdfsFreeSpaceMap::setFreeSpaceEntries(): Error, the free space map has not been set";
+        return false;
+    }
+
+    if (freeSpaceEntries.size() > getMaximumFreeSpaceEntries()) {
+        qCDebug(lcMap) << "AdfsFreeSpaceMap::setFreeSpaceEntries(): Error, too many free space entries -" << freeSpaceEntries.size();
+        return false;
+    }
+
+    // Write the start sectors to sector 0 and the lengths to sector 1, clearing any unused records
+    qint64 freeSpaceNumber = 0;
+    for (QMap<qint64, qint64>::const_iterator i = freeSpaceEntries.constBegin(); i != freeSpaceEntries.constEnd(); ++i) {
+        setBytesFromInt(freeSpaceNumber * 3, i.key());
+        setBytesFromInt(sectorSize + (freeSpaceNumber * 3), i.value());
+        freeSpaceNumber++;
+    }
+
+    for (; freeSpaceNumber < getMaximumFreeSpaceEntries(); freeSpaceNumber++) {
+        setBytesFromInt(freeSpaceNumber * 3, 0);
+        setBytesFromInt(sectorSize + (freeSpaceNumber * 3), 0);
+    }
+
+    // Byte 254 of sector 1 points to the end of the free space list
+    (*freeSpaceMapData)[static_cast<int>(sectorSize + 254)] = static_cast<char>(freeSpaceEntries.size() * 3);
+
+    // Checksums are the last byte of each sector
+    (*freeSpaceMapData)[static_cast<int>(255)] = static_cast<char>(calculateChecksum(0));
+    (*freeSpaceMapData)[static_cast<int>(sectorSize + 255)] = static_cast<char>(calculateChecksum(1));
+
+    return true;
+}
+
+// Get the free space map data (sectors 0 and 1) for writing back to the disc image
+QByteArray AdfsFreeSpaceMap::getMap()
+{
+    return *freeSpaceMapData;
+}
+
 // Private methods
 
 // Convert 2 bytes to an integer (byte0 is MSB, byte 1 is LSB)
@@ -139,3 +201,11 @@ qint64 AdfsFreeSpaceMap::calculateChecksum(qint64 sectorNumber)
 
     return (qint64)sum;
 }
+
+// Store an integer as 3 bytes (LSB first) at the specified offset in the map
+void AdfsFreeSpaceMap::setBytesFromInt(qint64 offset, qint64 value)
+{
+    (*freeSpaceMapData)[static_cast<int>(offset)] = static_cast<char>(value & 0xFF);
+    (*freeSpaceMapData)[static_cast<int>(offset + 1)] = static_cast<char>((value >> 8) & 0xFF);
+    (*freeSpaceMapData)[static_cast<int>(offset + 2)] = static_cast<char>((value >> 16) & 0xFF);
+}
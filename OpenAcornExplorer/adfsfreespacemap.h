@@ -27,8 +27,9 @@
 #ifndef ADFSFREESPACEMAP_H
 #define ADFSFREESPACEMAP_H
 
-#include <QApplication>
+#include <QCoreApplication>
 #include <QDebug>
+#include <QMap>
 
 class AdfsFreeSpaceMap
 {
@@ -38,9 +39,14 @@ public:
 
     qint64 getFreeSpaceStartSector(qint64 freeSpaceNumber);
     qint64 getFreeSpaceLength(qint64 freeSpaceNumber);
+    qint64 getNumberOfFreeSpaceEntries();
     qint64 getTotalSectorsOnDisc();
     qint64 getDiscIdentifier();
     qint64 getBootOptionNumber();
+    qint64 getMaximumFreeSpaceEntries();
+
+    bool setFreeSpaceEntries(const QMap<qint64, qint64> &freeSpaceEntries);
+    QByteArray getMap();
 
 private:
     QByteArray *freeSpaceMapData;
@@ -49,6 +55,7 @@ private:
     qint64 convertBytesToInt(quint8 byte0, quint8 byte1);
     qint64 convertBytesToInt(quint8 byte0, quint8 byte1, quint8 byte2);
     qint64 calculateChecksum(qint64 sectorNumber);
+    void setBytesFromInt(qint64 offset, qint64 value);
 };
 
 #endif // ADFSFREESPACEMAP_H
@@ -0,0 +1,267 @@
+/************************************************************************
+
+    adfsimage.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "adfsimage.h"
+#include "logcategories.h"
+#include "tracerecorder.h"
+
+// Old map discs address the disc in 256 byte sectors
+static const qint64 oldMapSectorSize = 256;
+
+// Position of the disc record within the boot block of a multi-zone new map disc
+static const qint64 bootBlockDiscRecord = 0xC00 + 0x1C0;
+
+// Largest big directory that will be read
+static const qint64 maximumBigDirectorySize = 4 * 1024 * 1024;
+
+// Class constructor
+// Note: The disc image is not owned by the ADFS image and must remain open for
+// the lifetime of the object
+AdfsImage::AdfsImage(DiscImage *discImageParam)
+{
+    TraceScope trace("parse", "AdfsImage::readMap");
+
+    discImage = discImageParam;
+    freeSpaceMap = new AdfsFreeSpaceMap;
+    newMap = new AdfsNewMap;
+    mapType = UnknownMap;
+    rootDirectorySector = -1;
+    directorySize = 0;
+
+    if (!discImage->isValid()) {
+        qCDebug(lcImage) << "AdfsImage::AdfsImage(): Disc image is not valid";
+        return;
+    }
+
+    // Try the type of map expected for the disc format first (D and E format
+    // images are the same size, so the format may have been guessed)
+    DiscGeometry::Format format = discImage->getGeometry().getFormat();
+    if (format == DiscGeometry::AdfsE || format == DiscGeometry::AdfsEPlus ||
+            format == DiscGeometry::AdfsF || format == DiscGeometry::AdfsFPlus) {
+        if (!readNewMap()) readOldMap();
+    } else {
+        if (!readOldMap()) readNewMap();
+    }
+
+    if (mapType == UnknownMap) qCDebug(lcImage) << "AdfsImage::AdfsImage(): Free space map is not valid";
+}
+
+// Class destructor
+AdfsImage::~AdfsImage()
+{
+    delete freeSpaceMap;
+    delete newMap;
+}
+
+// Determine if the disc image contains a valid ADFS file system
+bool AdfsImage::isValid()
+{
+    return discImage->isValid() && mapType != UnknownMap;
+}
+
+AdfsImage::MapType AdfsImage::getMapType()
+{
+    return mapType;
+}
+
+DiscImage *AdfsImage::getDiscImage()
+{
+    return discImage;
+}
+
+// Get the old map free space map (only valid for old map discs)
+AdfsFreeSpaceMap *AdfsImage::getFreeSpaceMap()
+{
+    return freeSpaceMap;
+}
+
+// Get the new map (only valid for new map discs)
+AdfsNewMap *AdfsImage::getNewMap()
+{
+    return newMap;
+}
+
+// Get the disc address of the root directory
+qint64 AdfsImage::getRootDirectorySector()
+{
+    return rootDirectorySector;
+}
+
+// Get the size of a directory in bytes
+qint64 AdfsImage::getDirectorySize()
+{
+    return directorySize;
+}
+
+// Get the extents on the disc holding an object of the given length in bytes
+bool AdfsImage::getObjectExtents(qint64 discAddress, qint64 length, QVector<AdfsDiscExtent> *extents)
+{
+    extents->clear();
+
+    if (mapType == NewMap) return newMap->getObjectExtents(discAddress, length, extents);
+    if (mapType != OldMap) return false;
+
+    // Old map objects are held in a single run of sectors
+    if (length > 0) extents->append({discAddress * oldMapSectorSize, length});
+
+    return true;
+}
+
+// Read an object from the disc image
+// Note: An object held in a single extent of a mapped image is not copied, so
+// the data is only valid whilst the disc image remains open
+bool AdfsImage::readObject(qint64 discAddress, qint64 length, QByteArray *objectData)
+{
+    QVector<AdfsDiscExtent> extents;
+    if (!getObjectExtents(discAddress, length, &extents)) return false;
+
+    // Use the mapped image data directly if possible
+    if (extents.size() == 1) {
+        DiscSectorView objectView = discImage->getByteView(extents.first().bytePosition, extents.first().length);
+        if (!objectView.isNull()) {
+            *objectData = objectView.toRawByteArray();
+            return true;
+        }
+    }
+
+    // Otherwise read each extent of the object
+    objectData->resize(static_cast<int>(length));
+    qint64 objectPosition = 0;
+    for (const AdfsDiscExtent &extent : extents) {
+        if (!discImage->readBytes(extent.bytePosition, extent.length, objectData->data() + objectPosition)) return false;
+        objectPosition += extent.length;
+    }
+
+    return true;
+}
+
+// Read a directory from the disc image
+bool AdfsImage::readDirectory(qint64 directorySector, AdfsDirectory *adfsDirectory)
+{
+    QByteArray directoryData;
+    bool directoryRead = readObject(directorySector, directorySize, &directoryData);
+
+    // Big directories can be larger than the 2048 bytes read; the header holds
+    // the size of the whole directory
+    if (directoryRead && directoryData.size() >= 16 && directoryData.mid(4, 4) == "SBPr") {
+        const uchar *header = reinterpret_cast<const uchar *>(directoryData.constData());
+        qint64 bigDirectorySize = header[12] | (header[13] << 8) | (header[14] << 16) | (static_cast<qint64>(header[15]) << 24);
+
+        if (bigDirectorySize > maximumBigDirectorySize) directoryRead = false;
+        else if (bigDirectorySize > directorySize) directoryRead = readObject(directorySector, bigDirectorySize, &directoryData);
+    }
+
+    if (!directoryRead) {
+        qCDebug(lcImage) << "AdfsImage::readDirectory(): Directory at disc address" << directorySector << "cannot be read";
+        return false;
+    }
+
+    // Put the directory data into the object
+    if (!adfsDirectory->setDirectory(directoryData)) {
+        qCDebug(lcImage) << "AdfsImage::readDirectory(): Directory at disc address" << directorySector << "is not valid";
+        return false;
+    }
+
+    return true;
+}
+
+// Read a directory from the disc image into a directory record
+bool AdfsImage::readDirectoryRecord(qint64 directorySector, AdfsDirectoryRecord *directoryRecord)
+{
+    AdfsDirectory adfsDirectory;
+    if (!readDirectory(directorySector, &adfsDirectory)) return false;
+
+    directoryRecord->directorySector = directorySector;
+    directoryRecord->directoryName = adfsDirectory.getDirectoryName();
+    directoryRecord->masterSequenceNumber = adfsDirectory.getMasterSequenceNumber();
+    directoryRecord->entries = adfsDirectory.getEntries();
+    directoryRecord->entryNames = adfsDirectory.getEntryNameTable();
+    directoryRecord->entryIndex = adfsDirectory.getEntryIndex();
+    directoryRecord->directorySize = adfsDirectory.getDirectorySize();
+    directoryRecord->masterSequenceNumberConsistent = adfsDirectory.isMasterSequenceNumberConsistent();
+    directoryRecord->checkByteValid = adfsDirectory.isCheckByteValid();
+
+    return true;
+}
+
+// Private methods
+
+// Read the old map free space map from sectors 0 and 1
+bool AdfsImage::readOldMap()
+{
+    QByteArray mapData(static_cast<int>(2 * oldMapSectorSize), 0);
+    if (!discImage->readBytes(0, mapData.size(), mapData.data())) return false;
+    if (!freeSpaceMap->setMap(mapData)) return false;
+
+    // The root directory follows the map: an old format directory at sector 2,
+    // or a new format directory at sector 4 on D format discs
+    QByteArray rootIdentification(4, 0);
+    if (!discImage->readBytes(4 * oldMapSectorSize + 1, 4, rootIdentification.data())) return false;
+
+    if (rootIdentification == "Nick") {
+        rootDirectorySector = 4;
+        directorySize = 2048;
+    } else {
+        rootDirectorySector = 2;
+        directorySize = 5 * oldMapSectorSize;
+    }
+
+    mapType = OldMap;
+    return true;
+}
+
+// Read the new map; single zone discs hold the map at the start of the disc
+// whilst multi-zone discs hold a copy of the disc record in the boot block
+// which locates the map in the middle of the disc
+bool AdfsImage::readNewMap()
+{
+    QVector<qint64> discRecordPositions;
+    discRecordPositions << bootBlockDiscRecord << 4;
+
+    for (qint64 discRecordPosition : discRecordPositions) {
+        QByteArray discRecord(60, 0);
+        if (!discImage->readBytes(discRecordPosition, discRecord.size(), discRecord.data())) continue;
+
+        qint64 mapPosition, mapLength;
+        if (!AdfsNewMap::getMapLocation(discRecord, &mapPosition, &mapLength)) continue;
+        if (mapPosition + mapLength > discImage->getGeometry().getTotalSectors() * discImage->getSectorSize()) continue;
+
+        QByteArray mapData(static_cast<int>(mapLength), 0);
+        if (!discImage->readBytes(mapPosition, mapLength, mapData.data())) continue;
+        if (!newMap->setMap(mapData)) continue;
+
+        // New format directories are 2048 bytes, as are the smallest big
+        // directories (which are read in full once their header is read)
+        rootDirectorySector = newMap->getRootDirectoryAddress();
+        directorySize = 2048;
+
+        mapType = NewMap;
+        return true;
+    }
+
+    return false;
+}
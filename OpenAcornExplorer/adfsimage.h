@@ -0,0 +1,84 @@
+/************************************************************************
+
+    adfsimage.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef ADFSIMAGE_H
+#define ADFSIMAGE_H
+
+#include <QCoreApplication>
+#include <QDebug>
+
+#include "discimage.h"
+#include "adfsfreespacemap.h"
+#include "adfsnewmap.h"
+#include "adfsdirectory.h"
+
+// An ADFS file system within a disc image.  Reads and validates the free space
+// map (the old map of S, M, L and D format discs, or the zone map of E and F
+// format discs) and provides access to the directories and objects on the disc.
+// Objects are identified by their disc address: a sector number (of 256 bytes)
+// on old map discs, or an indirect disc address on new map discs
+class AdfsImage
+{
+public:
+    enum MapType {
+        UnknownMap,
+        OldMap,
+        NewMap
+    };
+
+    AdfsImage(DiscImage *discImageParam);
+    ~AdfsImage();
+
+    bool isValid();
+    MapType getMapType();
+    DiscImage *getDiscImage();
+    AdfsFreeSpaceMap *getFreeSpaceMap();
+    AdfsNewMap *getNewMap();
+
+    qint64 getRootDirectorySector();
+    qint64 getDirectorySize();
+    bool getObjectExtents(qint64 discAddress, qint64 length, QVector<AdfsDiscExtent> *extents);
+    bool readObject(qint64 discAddress, qint64 length, QByteArray *objectData);
+    bool readDirectory(qint64 directorySector, AdfsDirectory *adfsDirectory);
+    bool readDirectoryRecord(qint64 directorySector, AdfsDirectoryRecord *directoryRecord);
+
+private:
+    Q_DISABLE_COPY(AdfsImage)
+
+    DiscImage *discImage;
+    AdfsFreeSpaceMap *freeSpaceMap;
+    AdfsNewMap *newMap;
+    MapType mapType;
+
+    qint64 rootDirectorySector;
+    qint64 directorySize;
+
+    bool readOldMap();
+    bool readNewMap();
+};
+
+#endif // ADFSIMAGE_H
@@ -0,0 +1,304 @@
+/************************************************************************
+
+    adfsimagechecker.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "adfsimagechecker.h"
+#include "logcategories.h"
+
+// Problems described in the results (every problem is still counted)
+static const qint64 maximumProblems = 100;
+
+// Old map sectors are always 256 bytes
+static const qint64 oldMapSectorSize = 256;
+
+// New map fragment ids with a fixed meaning: defects and the map (along with
+// the boot block and the root directory)
+static const quint32 defectFragmentId = 1;
+static const quint32 mapFragmentId = 2;
+
+AdfsImageChecker::AdfsImageChecker(AdfsImage *adfsImageParam)
+{
+    adfsImage = adfsImageParam;
+}
+
+// Check the file system against a catalogue read from the image; returns true
+// if no problems are found
+bool AdfsImageChecker::check(const AdfsCatalogue &catalogue)
+{
+    results = AdfsCheckResults();
+    allocatedFragments.clear();
+
+    if (adfsImage->getMapType() == AdfsImage::NewMap) {
+        AdfsNewMap *newMap = adfsImage->getNewMap();
+        results.sectorSize = newMap->getBytesPerMapBit();
+        results.totalSectors = newMap->getDiscSize() / results.sectorSize;
+    } else if (adfsImage->getMapType() == AdfsImage::OldMap) {
+        results.sectorSize = oldMapSectorSize;
+        results.totalSectors = adfsImage->getFreeSpaceMap()->getTotalSectorsOnDisc();
+    } else {
+        qCDebug(lcImage) << "AdfsImageChecker::check(): Image does not have a valid map";
+        return false;
+    }
+
+    ownedSectors = QBitArray(static_cast<int>(results.totalSectors));
+    freeSectors = QBitArray(static_cast<int>(results.totalSectors));
+    allocatedSectors = QBitArray(static_cast<int>(results.totalSectors));
+
+    if (catalogue.getNumberOfNodes() == 0) {
+        results.unreadableDirectories++;
+        addProblem("$ cannot be read");
+        return false;
+    }
+
+    // The free space is marked first, so that objects overlapping it are found
+    // as they are marked
+    markFreeSpace();
+    markMap();
+
+    const QHash<qint64, AdfsDirectoryRecord> &directoryRecords = catalogue.getDirectoryRecords();
+    for (qint64 nodeNumber = 0; nodeNumber < catalogue.getNumberOfNodes(); nodeNumber++) {
+        const AdfsDirectoryEntry &entry = catalogue.getNode(nodeNumber).entry;
+        QString path = catalogue.getNodePath(nodeNumber);
+
+        if (!entry.isDirectory()) {
+            markObject(entry.startSector, entry.length, path);
+            continue;
+        }
+
+        // Directories that cannot be read are assumed to be the usual size
+        QHash<qint64, AdfsDirectoryRecord>::const_iterator i = directoryRecords.constFind(entry.startSector);
+        if (i == directoryRecords.constEnd()) {
+            results.unreadableDirectories++;
+            addProblem(path + " cannot be read");
+            markObject(entry.startSector, adfsImage->getDirectorySize(), path);
+            continue;
+        }
+
+        checkDirectory(i.value(), path);
+        markObject(entry.startSector, i.value().directorySize, path);
+    }
+
+    countLostSectors();
+
+    return results.isClean();
+}
+
+const AdfsCheckResults &AdfsImageChecker::getResults() const
+{
+    return results;
+}
+
+// Private methods
+
+// Mark the free space recorded in the map
+void AdfsImageChecker::markFreeSpace()
+{
+    QVector<AdfsDiscExtent> freeExtents;
+
+    if (adfsImage->getMapType() == AdfsImage::NewMap) {
+        freeExtents = adfsImage->getNewMap()->getFreeExtents();
+    } else {
+        AdfsFreeSpaceMap *freeSpaceMap = adfsImage->getFreeSpaceMap();
+        for (qint64 entry = 0; entry < freeSpaceMap->getNumberOfFreeSpaceEntries(); entry++) {
+            freeExtents.append({freeSpaceMap->getFreeSpaceStartSector(entry) * oldMapSectorSize,
+                                freeSpaceMap->getFreeSpaceLength(entry) * oldMapSectorSize});
+        }
+    }
+
+    for (const AdfsDiscExtent &extent : freeExtents) {
+        qint64 firstSector = extent.bytePosition / results.sectorSize;
+        qint64 endSector = qMin((extent.bytePosition + extent.length + results.sectorSize - 1) / results.sectorSize,
+                                results.totalSectors);
+
+        for (qint64 sector = firstSector; sector < endSector; sector++) freeSectors.setBit(static_cast<int>(sector));
+    }
+}
+
+// Mark the sectors owned by the map: the sectors before the root directory on
+// old map discs, or the map and its copy on new map discs (the rest of the
+// map's fragment holds the boot block and the root directory)
+void AdfsImageChecker::markMap()
+{
+    AdfsDiscExtent mapExtent;
+
+    if (adfsImage->getMapType() == AdfsImage::NewMap) {
+        AdfsNewMap *newMap = adfsImage->getNewMap();
+        mapExtent = {newMap->getMapPosition(), 2 * newMap->getNumberOfZones() * newMap->getSectorSize()};
+
+        markAllocatedFragment(defectFragmentId);
+        markAllocatedFragment(mapFragmentId);
+    } else {
+        mapExtent = {0, adfsImage->getRootDirectorySector() * oldMapSectorSize};
+    }
+
+    qint64 crossLinked = 0;
+    qint64 freeOverlap = 0;
+    markExtent(mapExtent, &crossLinked, &freeOverlap);
+
+    if (freeOverlap > 0) {
+        results.freeSpaceOverlapSectors += freeOverlap;
+        addProblem(QString("The map overlaps free space (%1 sectors)").arg(freeOverlap));
+    }
+}
+
+// Mark the sectors owned by an object; returns false if the object's disc
+// address is not valid
+bool AdfsImageChecker::markObject(qint64 discAddress, qint64 length, const QString &path)
+{
+    QVector<AdfsDiscExtent> extents;
+    if (!getOwnedExtents(discAddress, length, &extents)) {
+        results.invalidAddresses++;
+        addProblem(QString("%1 has an invalid disc address (0x%2)").arg(path).arg(discAddress, 0, 16));
+        return false;
+    }
+
+    qint64 crossLinked = 0;
+    qint64 freeOverlap = 0;
+    for (const AdfsDiscExtent &extent : extents) markExtent(extent, &crossLinked, &freeOverlap);
+
+    if (crossLinked > 0) {
+        results.crossLinkedSectors += crossLinked;
+        addProblem(QString("%1 is cross-linked with another object (%2 sectors)").arg(path).arg(crossLinked));
+    }
+
+    if (freeOverlap > 0) {
+        results.freeSpaceOverlapSectors += freeOverlap;
+        addProblem(QString("%1 overlaps free space (%2 sectors)").arg(path).arg(freeOverlap));
+    }
+
+    return true;
+}
+
+// Get the extents owned by an object.  Old map objects own whole disc sectors;
+// new map objects own their whole fragment, or whole share-sized blocks of a
+// shared fragment
+bool AdfsImageChecker::getOwnedExtents(qint64 discAddress, qint64 length, QVector<AdfsDiscExtent> *extents)
+{
+    extents->clear();
+
+    // Empty files own no sectors
+    if (length <= 0) return true;
+
+    if (adfsImage->getMapType() == AdfsImage::NewMap) {
+        AdfsNewMap *newMap = adfsImage->getNewMap();
+        if (!adfsImage->getObjectExtents(discAddress, length, extents)) return false;
+
+        quint32 fragmentId = static_cast<quint32>(discAddress >> 8);
+        markAllocatedFragment(fragmentId);
+
+        if ((discAddress & 0xFF) == 0) {
+            *extents = newMap->getFragmentExtents(fragmentId);
+        } else {
+            qint64 shareSize = newMap->getShareSize();
+            QVector<AdfsDiscExtent> sharedExtents;
+            if (adfsImage->getObjectExtents(discAddress, ((length + shareSize - 1) / shareSize) * shareSize, &sharedExtents)) {
+                *extents = sharedExtents;
+            }
+        }
+
+        return true;
+    }
+
+    // Old map objects are allocated in whole disc sectors (1024 bytes on D
+    // format discs)
+    qint64 allocationSize = qMax(oldMapSectorSize, adfsImage->getDiscImage()->getSectorSize());
+    qint64 ownedLength = ((length + allocationSize - 1) / allocationSize) * allocationSize;
+    if ((discAddress * oldMapSectorSize) + ownedLength > results.totalSectors * oldMapSectorSize) return false;
+
+    extents->append({discAddress * oldMapSectorSize, ownedLength});
+    return true;
+}
+
+// Mark the sectors of a new map fragment as allocated (once per fragment)
+void AdfsImageChecker::markAllocatedFragment(quint32 fragmentId)
+{
+    if (allocatedFragments.contains(fragmentId)) return;
+    allocatedFragments.insert(fragmentId);
+
+    for (const AdfsDiscExtent &extent : adfsImage->getNewMap()->getFragmentExtents(fragmentId)) {
+        qint64 firstSector = extent.bytePosition / results.sectorSize;
+        qint64 endSector = qMin((extent.bytePosition + extent.length) / results.sectorSize, results.totalSectors);
+
+        for (qint64 sector = firstSector; sector < endSector; sector++) allocatedSectors.setBit(static_cast<int>(sector));
+    }
+}
+
+// Mark the sectors of an extent as owned, counting the sectors that were
+// already owned or are free
+void AdfsImageChecker::markExtent(const AdfsDiscExtent &extent, qint64 *crossLinked, qint64 *freeOverlap)
+{
+    qint64 firstSector = extent.bytePosition / results.sectorSize;
+    qint64 endSector = qMin((extent.bytePosition + extent.length + results.sectorSize - 1) / results.sectorSize,
+                            results.totalSectors);
+
+    for (qint64 sector = firstSector; sector < endSector; sector++) {
+        int bit = static_cast<int>(sector);
+
+        if (ownedSectors.testBit(bit)) (*crossLinked)++;
+        if (freeSectors.testBit(bit)) (*freeOverlap)++;
+        ownedSectors.setBit(bit);
+    }
+}
+
+// Check a directory's master sequence numbers and check byte
+void AdfsImageChecker::checkDirectory(const AdfsDirectoryRecord &directoryRecord, const QString &path)
+{
+    if (!directoryRecord.masterSequenceNumberConsistent) {
+        results.sequenceNumberMismatches++;
+        addProblem(path + " has different master sequence numbers at its start and end");
+    }
+
+    if (!directoryRecord.checkByteValid) {
+        results.badCheckBytes++;
+        addProblem(path + " has an invalid check byte");
+    }
+}
+
+// Count the sectors that are not owned, allocated or free, describing each
+// run of them
+void AdfsImageChecker::countLostSectors()
+{
+    qint64 lostStart = -1;
+
+    for (qint64 sector = 0; sector <= results.totalSectors; sector++) {
+        int bit = static_cast<int>(sector);
+        bool lost = (sector < results.totalSectors) && !ownedSectors.testBit(bit) && !freeSectors.testBit(bit) &&
+                !allocatedSectors.testBit(bit);
+
+        if (lost && lostStart < 0) lostStart = sector;
+        if (!lost && lostStart >= 0) {
+            results.lostSectors += sector - lostStart;
+            addProblem(QString("%1 lost sectors at disc address 0x%2").arg(sector - lostStart)
+                       .arg(lostStart * results.sectorSize, 0, 16));
+            lostStart = -1;
+        }
+    }
+}
+
+void AdfsImageChecker::addProblem(const QString &problem)
+{
+    if (results.problems.size() < maximumProblems) results.problems.append(problem);
+}
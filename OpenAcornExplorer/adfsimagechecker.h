@@ -0,0 +1,100 @@
+/************************************************************************
+
+    adfsimagechecker.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef ADFSIMAGECHECKER_H
+#define ADFSIMAGECHECKER_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QBitArray>
+#include <QSet>
+#include <QStringList>
+
+#include "adfsimage.h"
+#include "adfscatalogue.h"
+
+// Results of checking a disc image.  Sectors are the allocation units of the
+// map: 256 byte sectors on old map discs, and the bytes of a map bit on new
+// map discs
+struct AdfsCheckResults
+{
+    qint64 sectorSize = 0;
+    qint64 totalSectors = 0;
+    qint64 crossLinkedSectors = 0;      // Sectors owned by more than one object
+    qint64 freeSpaceOverlapSectors = 0; // Sectors owned by an object and also free
+    qint64 lostSectors = 0;             // Sectors neither owned by an object nor free
+    qint64 sequenceNumberMismatches = 0;
+    qint64 badCheckBytes = 0;
+    qint64 unreadableDirectories = 0;
+    qint64 invalidAddresses = 0;        // Objects whose disc address is not on the disc
+    QStringList problems;               // Description of each problem (the first maximumProblems)
+
+    bool isClean() const
+    {
+        return crossLinkedSectors == 0 && freeSpaceOverlapSectors == 0 && lostSectors == 0 &&
+                sequenceNumberMismatches == 0 && badCheckBytes == 0 && unreadableDirectories == 0 &&
+                invalidAddresses == 0;
+    }
+};
+
+// Checks the integrity of an ADFS file system beyond the map and directory
+// validation done when they are read.  Every sector owned by the map and by
+// the directories and files of the catalogue is marked in a bitmap, along with
+// the free space, so the cross-linked, doubly allocated and lost sectors are
+// all found in a single pass over the disc.  Each directory's master sequence
+// numbers and check byte are also verified
+class AdfsImageChecker
+{
+public:
+    AdfsImageChecker(AdfsImage *adfsImageParam);
+
+    bool check(const AdfsCatalogue &catalogue);
+    const AdfsCheckResults &getResults() const;
+
+private:
+    AdfsImage *adfsImage;
+    AdfsCheckResults results;
+
+    // Sector bitmaps; allocated sectors are those within fragments in use on new
+    // map discs (shared fragments are not always full)
+    QBitArray ownedSectors;
+    QBitArray freeSectors;
+    QBitArray allocatedSectors;
+    QSet<quint32> allocatedFragments;
+
+    void markFreeSpace();
+    void markMap();
+    bool markObject(qint64 discAddress, qint64 length, const QString &path);
+    bool getOwnedExtents(qint64 discAddress, qint64 length, QVector<AdfsDiscExtent> *extents);
+    void markAllocatedFragment(quint32 fragmentId);
+    void markExtent(const AdfsDiscExtent &extent, qint64 *crossLinked, qint64 *freeOverlap);
+    void checkDirectory(const AdfsDirectoryRecord &directoryRecord, const QString &path);
+    void countLostSectors();
+    void addProblem(const QString &problem);
+};
+
+#endif // ADFSIMAGECHECKER_H
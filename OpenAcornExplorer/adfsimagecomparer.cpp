@@ -0,0 +1,355 @@
+/************************************************************************
+
+    adfsimagecomparer.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "adfsimagecomparer.h"
+#include "tracerecorder.h"
+
+#include <QHash>
+
+#include <algorithm>
+#include <cstring>
+
+// Get the data of a run of sectors: in place for a mapped image, otherwise read
+// into the buffer.  Returns null if the sectors cannot be read
+static const char *getSectorData(DiscImage *discImage, qint64 startSector, qint64 numberOfSectors, QByteArray *buffer)
+{
+    DiscSectorView sectorView = discImage->getSectorView(startSector, numberOfSectors);
+    if (!sectorView.isNull()) return reinterpret_cast<const char *>(sectorView.data());
+
+    buffer->resize(static_cast<int>(numberOfSectors * discImage->getSectorSize()));
+    if (!discImage->readSector(startSector, numberOfSectors, buffer->data())) return nullptr;
+
+    return buffer->constData();
+}
+
+static bool isSameExtents(const QVector<AdfsDiscExtent> &extents, const QVector<AdfsDiscExtent> &otherExtents)
+{
+    if (extents.size() != otherExtents.size()) return false;
+
+    for (qint64 extentNumber = 0; extentNumber < extents.size(); extentNumber++) {
+        if (extents[extentNumber].bytePosition != otherExtents[extentNumber].bytePosition ||
+                extents[extentNumber].length != otherExtents[extentNumber].length) return false;
+    }
+
+    return true;
+}
+
+AdfsImageComparer::AdfsImageComparer(AdfsImage *oldImageParam, AdfsImage *newImageParam)
+{
+    oldImage = oldImageParam;
+    newImage = newImageParam;
+    sectorComparable = false;
+    numberOfChangedSectors = 0;
+    unownedChangedSectors = 0;
+    unresolvedObjects = 0;
+}
+
+// Find the sectors that differ between the images.  Returns false if either
+// image cannot be read; images of different geometries cannot be compared by
+// sector (their catalogues still can)
+bool AdfsImageComparer::compareSectors()
+{
+    TraceScope trace("compare", "AdfsImageComparer::compareSectors");
+
+    sectorComparable = false;
+    changedSectors.clear();
+    changedRanges.clear();
+    numberOfChangedSectors = 0;
+
+    if (!oldTree.build(oldImage->getDiscImage()) || !newTree.build(newImage->getDiscImage())) return false;
+
+    sectorComparable = oldTree.isComparable(newTree);
+    if (!sectorComparable) return true;
+
+    changedSectors.resize(static_cast<int>(newTree.getNumberOfSectors()));
+    for (qint64 leaf : oldTree.getChangedLeaves(newTree)) compareLeaf(leaf);
+
+    // Collect the changed sectors into runs
+    for (qint64 sector = 0; sector < changedSectors.size(); sector++) {
+        if (!changedSectors.testBit(static_cast<int>(sector))) continue;
+
+        numberOfChangedSectors++;
+        if (!changedRanges.isEmpty() && changedRanges.last().startSector + changedRanges.last().numberOfSectors == sector) {
+            changedRanges.last().numberOfSectors++;
+        } else {
+            changedRanges.append({sector, 1});
+        }
+    }
+
+    return true;
+}
+
+bool AdfsImageComparer::isSectorComparable() const
+{
+    return sectorComparable;
+}
+
+// Are the images identical (sector for sector)?
+bool AdfsImageComparer::isIdentical() const
+{
+    return sectorComparable && numberOfChangedSectors == 0;
+}
+
+qint64 AdfsImageComparer::getSectorSize() const
+{
+    return newTree.getSectorSize();
+}
+
+qint64 AdfsImageComparer::getNumberOfChangedSectors() const
+{
+    return numberOfChangedSectors;
+}
+
+const QVector<DiscSectorRange> &AdfsImageComparer::getChangedSectors() const
+{
+    return changedRanges;
+}
+
+// Compare the catalogues of the images, entry by entry.  The changes are in
+// path order; sectors that changed but do not belong to any file or directory
+// (in either image) are counted as unowned - the map and free space.  Objects
+// whose sectors cannot be found are compared by reading them, and leave the
+// number of unowned sectors unknown
+void AdfsImageComparer::compareCatalogues(const AdfsCatalogue &oldCatalogue, const AdfsCatalogue &newCatalogue)
+{
+    TraceScope trace("compare", "AdfsImageComparer::compareCatalogues");
+
+    changes.clear();
+    unownedChangedSectors = 0;
+    unresolvedObjects = 0;
+
+    QHash<QString, qint64> oldPaths;
+    for (qint64 nodeNumber = 0; nodeNumber < oldCatalogue.getNumberOfNodes(); nodeNumber++) {
+        oldPaths.insert(oldCatalogue.getNodePath(nodeNumber).toUpper(), nodeNumber);
+    }
+
+    QBitArray ownedSectors(changedSectors.size());
+    QBitArray matchedOldNodes(static_cast<int>(oldCatalogue.getNumberOfNodes()));
+
+    // Added and changed entries
+    for (qint64 newNodeNumber = 0; newNodeNumber < newCatalogue.getNumberOfNodes(); newNodeNumber++) {
+        AdfsCatalogueChange change;
+        change.path = newCatalogue.getNodePath(newNodeNumber);
+        change.directory = newCatalogue.getNode(newNodeNumber).isDirectory();
+        change.newNodeNumber = newNodeNumber;
+
+        QVector<AdfsDiscExtent> newExtents;
+        bool newExtentsValid = getNodeExtents(newImage, newCatalogue, newNodeNumber, &newExtents);
+        markOwnedSectors(newExtents, &ownedSectors);
+
+        QHash<QString, qint64>::const_iterator i = oldPaths.constFind(change.path.toUpper());
+        if (i == oldPaths.constEnd()) {
+            change.type = AdfsCatalogueChange::Added;
+            changes.append(change);
+            continue;
+        }
+
+        change.oldNodeNumber = i.value();
+        matchedOldNodes.setBit(static_cast<int>(change.oldNodeNumber));
+
+        QVector<AdfsDiscExtent> oldExtents;
+        bool oldExtentsValid = getNodeExtents(oldImage, oldCatalogue, change.oldNodeNumber, &oldExtents);
+        markOwnedSectors(oldExtents, &ownedSectors);
+
+        change.type = AdfsCatalogueChange::Changed;
+        change.changedFields = compareNodes(oldCatalogue, change.oldNodeNumber, oldExtents, newCatalogue, newNodeNumber, newExtents,
+                                            oldExtentsValid && newExtentsValid);
+        if (change.changedFields != 0) changes.append(change);
+    }
+
+    // Removed entries
+    for (qint64 oldNodeNumber = 0; oldNodeNumber < oldCatalogue.getNumberOfNodes(); oldNodeNumber++) {
+        if (matchedOldNodes.testBit(static_cast<int>(oldNodeNumber))) continue;
+
+        AdfsCatalogueChange change;
+        change.type = AdfsCatalogueChange::Removed;
+        change.path = oldCatalogue.getNodePath(oldNodeNumber);
+        change.directory = oldCatalogue.getNode(oldNodeNumber).isDirectory();
+        change.oldNodeNumber = oldNodeNumber;
+        changes.append(change);
+
+        QVector<AdfsDiscExtent> oldExtents;
+        getNodeExtents(oldImage, oldCatalogue, oldNodeNumber, &oldExtents);
+        markOwnedSectors(oldExtents, &ownedSectors);
+    }
+
+    std::stable_sort(changes.begin(), changes.end(), [](const AdfsCatalogueChange &a, const AdfsCatalogueChange &b) {
+        return a.path.compare(b.path, Qt::CaseInsensitive) < 0;
+    });
+
+    // The sectors of unresolved objects could be any of those not owned
+    if (unresolvedObjects > 0) {
+        unownedChangedSectors = -1;
+        return;
+    }
+
+    for (qint64 sector = 0; sector < changedSectors.size(); sector++) {
+        if (changedSectors.testBit(static_cast<int>(sector)) && !ownedSectors.testBit(static_cast<int>(sector)))
+            unownedChangedSectors++;
+    }
+}
+
+const QVector<AdfsCatalogueChange> &AdfsImageComparer::getChanges() const
+{
+    return changes;
+}
+
+// Get the number of changed sectors that belong to no object (-1 if unknown as
+// the sectors of some objects could not be found)
+qint64 AdfsImageComparer::getUnownedChangedSectors() const
+{
+    return unownedChangedSectors;
+}
+
+// Get the number of files and directories (in either image) whose sectors
+// could not be found
+qint64 AdfsImageComparer::getUnresolvedObjects() const
+{
+    return unresolvedObjects;
+}
+
+// Private methods
+
+// Compare the sectors of a track whose hashes differ
+void AdfsImageComparer::compareLeaf(qint64 leaf)
+{
+    qint64 sectorSize = newTree.getSectorSize();
+    qint64 startSector = leaf * newTree.getSectorsPerLeaf();
+    qint64 numberOfSectors = qMin(newTree.getSectorsPerLeaf(), newTree.getNumberOfSectors() - startSector);
+
+    QByteArray oldBuffer;
+    QByteArray newBuffer;
+    const char *oldData = getSectorData(oldImage->getDiscImage(), startSector, numberOfSectors, &oldBuffer);
+    const char *newData = getSectorData(newImage->getDiscImage(), startSector, numberOfSectors, &newBuffer);
+
+    for (qint64 sector = 0; sector < numberOfSectors; sector++) {
+        // Unreadable sectors are assumed to have changed
+        if (oldData == nullptr || newData == nullptr ||
+                memcmp(oldData + (sector * sectorSize), newData + (sector * sectorSize), sectorSize) != 0) {
+            changedSectors.setBit(static_cast<int>(startSector + sector));
+        }
+    }
+}
+
+// Get the fields of an entry that changed between the images
+int AdfsImageComparer::compareNodes(const AdfsCatalogue &oldCatalogue, qint64 oldNodeNumber, const QVector<AdfsDiscExtent> &oldExtents,
+                                    const AdfsCatalogue &newCatalogue, qint64 newNodeNumber, const QVector<AdfsDiscExtent> &newExtents,
+                                    bool extentsValid)
+{
+    const AdfsDirectoryEntry &oldEntry = oldCatalogue.getNode(oldNodeNumber).entry;
+    const AdfsDirectoryEntry &newEntry = newCatalogue.getNode(newNodeNumber).entry;
+    qint64 oldLength = getNodeLength(oldImage, oldCatalogue, oldNodeNumber);
+    qint64 newLength = getNodeLength(newImage, newCatalogue, newNodeNumber);
+
+    int changedFields = 0;
+    if (oldEntry.loadAddress != newEntry.loadAddress) changedFields |= AdfsCatalogueChange::LoadAddress;
+    if (oldEntry.executionAddress != newEntry.executionAddress) changedFields |= AdfsCatalogueChange::ExecutionAddress;
+    if (oldEntry.attributes != newEntry.attributes) changedFields |= AdfsCatalogueChange::Attributes;
+    if (oldEntry.startSector != newEntry.startSector) changedFields |= AdfsCatalogueChange::Moved;
+
+    if (oldLength != newLength) {
+        changedFields |= AdfsCatalogueChange::Length | AdfsCatalogueChange::Content;
+    } else if (isContentChanged(oldEntry.startSector, oldLength, oldExtents, newEntry.startSector, newLength, newExtents,
+                                extentsValid)) {
+        changedFields |= AdfsCatalogueChange::Content;
+    }
+
+    return changedFields;
+}
+
+// Determine if an object's contents changed.  An object in the same place on
+// both images is only read if any of its sectors changed; otherwise (or if the
+// images could not be compared by sector, or the sectors of either copy could
+// not be found) both copies are read and compared
+bool AdfsImageComparer::isContentChanged(qint64 oldDiscAddress, qint64 oldLength, const QVector<AdfsDiscExtent> &oldExtents,
+                                         qint64 newDiscAddress, qint64 newLength, const QVector<AdfsDiscExtent> &newExtents,
+                                         bool extentsValid)
+{
+    if (sectorComparable && extentsValid && isSameExtents(oldExtents, newExtents) && !isExtentChanged(newExtents)) return false;
+
+    // Objects that cannot be read are assumed to have changed
+    QByteArray oldData;
+    QByteArray newData;
+    if (!oldImage->readObject(oldDiscAddress, oldLength, &oldData)) return true;
+    if (!newImage->readObject(newDiscAddress, newLength, &newData)) return true;
+
+    return oldData != newData;
+}
+
+// Get the length of a file or directory (directories that cannot be read are
+// assumed to be the usual size)
+qint64 AdfsImageComparer::getNodeLength(AdfsImage *adfsImage, const AdfsCatalogue &catalogue, qint64 nodeNumber) const
+{
+    const AdfsDirectoryEntry &entry = catalogue.getNode(nodeNumber).entry;
+    if (!entry.isDirectory()) return entry.length;
+
+    QHash<qint64, AdfsDirectoryRecord>::const_iterator i = catalogue.getDirectoryRecords().constFind(entry.startSector);
+    if (i == catalogue.getDirectoryRecords().constEnd()) return adfsImage->getDirectorySize();
+
+    return i.value().directorySize;
+}
+
+// Get the extents of a file or directory
+// Returns false (with no extents) if its sectors could not be found
+bool AdfsImageComparer::getNodeExtents(AdfsImage *adfsImage, const AdfsCatalogue &catalogue, qint64 nodeNumber,
+                                       QVector<AdfsDiscExtent> *extents)
+{
+    if (adfsImage->getObjectExtents(catalogue.getNode(nodeNumber).entry.startSector,
+                                    getNodeLength(adfsImage, catalogue, nodeNumber), extents)) return true;
+
+    extents->clear();
+    unresolvedObjects++;
+    return false;
+}
+
+// Determine if any of the sectors of the extents changed
+bool AdfsImageComparer::isExtentChanged(const QVector<AdfsDiscExtent> &extents) const
+{
+    qint64 sectorSize = newTree.getSectorSize();
+
+    for (const AdfsDiscExtent &extent : extents) {
+        qint64 lastSector = qMin((extent.bytePosition + extent.length - 1) / sectorSize, static_cast<qint64>(changedSectors.size()) - 1);
+        for (qint64 sector = extent.bytePosition / sectorSize; sector <= lastSector; sector++) {
+            if (changedSectors.testBit(static_cast<int>(sector))) return true;
+        }
+    }
+
+    return false;
+}
+
+void AdfsImageComparer::markOwnedSectors(const QVector<AdfsDiscExtent> &extents, QBitArray *ownedSectors) const
+{
+    qint64 sectorSize = newTree.getSectorSize();
+    if (sectorSize < 1) return;
+
+    for (const AdfsDiscExtent &extent : extents) {
+        qint64 lastSector = qMin((extent.bytePosition + extent.length - 1) / sectorSize, static_cast<qint64>(ownedSectors->size()) - 1);
+        for (qint64 sector = extent.bytePosition / sectorSize; sector <= lastSector; sector++) {
+            ownedSectors->setBit(static_cast<int>(sector));
+        }
+    }
+}
@@ -0,0 +1,128 @@
+/************************************************************************
+
+    adfsimagecomparer.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef ADFSIMAGECOMPARER_H
+#define ADFSIMAGECOMPARER_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QBitArray>
+#include <QVector>
+
+#include "adfsimage.h"
+#include "adfscatalogue.h"
+#include "discimagehashtree.h"
+
+// A run of sectors that differ between two images
+struct DiscSectorRange
+{
+    qint64 startSector;
+    qint64 numberOfSectors;
+};
+
+// A file or directory that differs between the catalogues of two images.
+// Entries are matched by path (ignoring case)
+struct AdfsCatalogueChange
+{
+    enum Type {
+        Added,
+        Removed,
+        Changed
+    };
+
+    // What changed (for changed entries)
+    enum Field {
+        Content = 0x01,
+        Length = 0x02,
+        LoadAddress = 0x04,
+        ExecutionAddress = 0x08,
+        Attributes = 0x10,
+        Moved = 0x20            // The entry's disc address changed
+    };
+
+    Type type = Changed;
+    QString path;
+    bool directory = false;
+    qint64 oldNodeNumber = -1;
+    qint64 newNodeNumber = -1;
+    int changedFields = 0;
+};
+
+// Compares two revisions of a disc image.  The sectors are compared first,
+// through a hash tree of each image's tracks; only the tracks whose hashes
+// differ are compared sector by sector.  The catalogues are then compared entry
+// by entry, using the changed sectors to decide which files and directories
+// need their contents compared
+class AdfsImageComparer
+{
+public:
+    AdfsImageComparer(AdfsImage *oldImageParam, AdfsImage *newImageParam);
+
+    bool compareSectors();
+    bool isSectorComparable() const;
+    bool isIdentical() const;
+    qint64 getSectorSize() const;
+    qint64 getNumberOfChangedSectors() const;
+    const QVector<DiscSectorRange> &getChangedSectors() const;
+
+    void compareCatalogues(const AdfsCatalogue &oldCatalogue, const AdfsCatalogue &newCatalogue);
+    const QVector<AdfsCatalogueChange> &getChanges() const;
+    qint64 getUnownedChangedSectors() const;
+    qint64 getUnresolvedObjects() const;
+
+private:
+    AdfsImage *oldImage;
+    AdfsImage *newImage;
+
+    DiscImageHashTree oldTree;
+    DiscImageHashTree newTree;
+    bool sectorComparable;
+
+    // Changed sectors (as a bitmap and as runs)
+    QBitArray changedSectors;
+    QVector<DiscSectorRange> changedRanges;
+    qint64 numberOfChangedSectors;
+
+    QVector<AdfsCatalogueChange> changes;
+    qint64 unownedChangedSectors;
+    qint64 unresolvedObjects;
+
+    void compareLeaf(qint64 leaf);
+    int compareNodes(const AdfsCatalogue &oldCatalogue, qint64 oldNodeNumber, const QVector<AdfsDiscExtent> &oldExtents,
+                     const AdfsCatalogue &newCatalogue, qint64 newNodeNumber, const QVector<AdfsDiscExtent> &newExtents,
+                     bool extentsValid);
+    bool isContentChanged(qint64 oldDiscAddress, qint64 oldLength, const QVector<AdfsDiscExtent> &oldExtents,
+                          qint64 newDiscAddress, qint64 newLength, const QVector<AdfsDiscExtent> &newExtents,
+                          bool extentsValid);
+    qint64 getNodeLength(AdfsImage *adfsImage, const AdfsCatalogue &catalogue, qint64 nodeNumber) const;
+    bool getNodeExtents(AdfsImage *adfsImage, const AdfsCatalogue &catalogue, qint64 nodeNumber,
+                        QVector<AdfsDiscExtent> *extents);
+    bool isExtentChanged(const QVector<AdfsDiscExtent> &extents) const;
+    void markOwnedSectors(const QVector<AdfsDiscExtent> &extents, QBitArray *ownedSectors) const;
+};
+
+#endif // ADFSIMAGECOMPARER_H
@@ -0,0 +1,213 @@
+/************************************************************************
+
+    adfsnameindex.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "adfsnameindex.h"
+
+#include <algorithm>
+
+AdfsNameIndex::AdfsNameIndex()
+{
+    numberOfCatalogues = 0;
+}
+
+// Add the names of every node in a catalogue (other than the root directory);
+// returns the catalogue number used in the matches
+qint64 AdfsNameIndex::addCatalogue(const AdfsCatalogue &catalogue)
+{
+    qint32 catalogueNumber = static_cast<qint32>(numberOfCatalogues++);
+
+    nodes.reserve(nodes.size() + static_cast<int>(catalogue.getNumberOfNodes()));
+    nextNameNodes.reserve(nodes.capacity());
+
+    for (qint64 nodeNumber = 1; nodeNumber < catalogue.getNumberOfNodes(); nodeNumber++) {
+        qint32 nameNumber = internName(catalogue.getNodeName(nodeNumber).toUpper().toLatin1());
+
+        // Append the node to the name's list of nodes
+        qint32 nameNode = nodes.size();
+        nodes.append({catalogueNumber, static_cast<qint32>(nodeNumber)});
+        nextNameNodes.append(-1);
+
+        if (lastNameNodes.at(nameNumber) < 0) firstNameNodes[nameNumber] = nameNode;
+        else nextNameNodes[lastNameNodes.at(nameNumber)] = nameNode;
+        lastNameNodes[nameNumber] = nameNode;
+    }
+
+    return catalogueNumber;
+}
+
+void AdfsNameIndex::clear()
+{
+    numberOfCatalogues = 0;
+    names.clear();
+    nameOffsets.clear();
+    nameLengths.clear();
+    nameNumbers.clear();
+    firstNameNodes.clear();
+    lastNameNodes.clear();
+    nodes.clear();
+    nextNameNodes.clear();
+    trigramNames.clear();
+}
+
+qint64 AdfsNameIndex::getNumberOfCatalogues() const
+{
+    return numberOfCatalogues;
+}
+
+// Get the number of distinct names
+qint64 AdfsNameIndex::getNumberOfNames() const
+{
+    return nameOffsets.size();
+}
+
+qint64 AdfsNameIndex::getNumberOfNodes() const
+{
+    return nodes.size();
+}
+
+// Find the names containing the text (in name number order)
+// Note: Text shorter than a trigram is found by examining every name
+QVector<qint32> AdfsNameIndex::findNames(const QString &text) const
+{
+    QVector<qint32> matchingNames;
+    QByteArray searchText = getSearchText(text);
+    if (searchText.isEmpty()) return matchingNames;
+
+    if (searchText.size() < 3) {
+        for (qint32 nameNumber = 0; nameNumber < nameOffsets.size(); nameNumber++) {
+            if (nameContains(nameNumber, searchText)) matchingNames.append(nameNumber);
+        }
+        return matchingNames;
+    }
+
+    // Get the names holding each trigram of the text, starting from the
+    // trigram with the fewest names
+    QVector<const QVector<qint32> *> trigramLists;
+    for (qint64 position = 0; position + 3 <= searchText.size(); position++) {
+        QHash<quint32, QVector<qint32> >::const_iterator i = trigramNames.constFind(getTrigram(searchText.constData() + position));
+        if (i == trigramNames.constEnd()) return matchingNames;
+        trigramLists.append(&i.value());
+    }
+
+    std::sort(trigramLists.begin(), trigramLists.end(), [](const QVector<qint32> *a, const QVector<qint32> *b) {
+        return a->size() < b->size();
+    });
+
+    // Each candidate must be in every other list; the lists are sorted, so each
+    // is searched from where the previous candidate was found
+    QVector<qint32> listPositions(trigramLists.size(), 0);
+    for (qint32 nameNumber : *trigramLists.first()) {
+        bool inAllLists = true;
+        for (qint64 list = 1; list < trigramLists.size() && inAllLists; list++) {
+            const QVector<qint32> &trigramList = *trigramLists.at(list);
+            const qint32 *position = std::lower_bound(trigramList.constData() + listPositions.at(list),
+                                                      trigramList.constData() + trigramList.size(), nameNumber);
+            listPositions[list] = static_cast<qint32>(position - trigramList.constData());
+            inAllLists = (position != trigramList.constData() + trigramList.size() && *position == nameNumber);
+        }
+
+        // The trigrams may not be in the order of the text
+        if (inAllLists && nameContains(nameNumber, searchText)) matchingNames.append(nameNumber);
+    }
+
+    return matchingNames;
+}
+
+// Find the names (from those of a previous search) containing the text
+QVector<qint32> AdfsNameIndex::refineNames(const QVector<qint32> &nameNumbersParam, const QString &text) const
+{
+    QVector<qint32> matchingNames;
+    QByteArray searchText = getSearchText(text);
+    if (searchText.isEmpty()) return matchingNames;
+
+    for (qint32 nameNumber : nameNumbersParam) {
+        if (nameContains(nameNumber, searchText)) matchingNames.append(nameNumber);
+    }
+
+    return matchingNames;
+}
+
+// Get the nodes with the names, up to the maximum number of matches
+QVector<AdfsNameMatch> AdfsNameIndex::getMatches(const QVector<qint32> &nameNumbersParam, qint64 maximumMatches) const
+{
+    QVector<AdfsNameMatch> matches;
+
+    for (qint32 nameNumber : nameNumbersParam) {
+        for (qint32 nameNode = firstNameNodes.at(nameNumber); nameNode >= 0; nameNode = nextNameNodes.at(nameNode)) {
+            if (matches.size() >= maximumMatches) return matches;
+            matches.append(nodes.at(nameNode));
+        }
+    }
+
+    return matches;
+}
+
+// Private methods
+
+// Get the number of a name, adding it (and its trigrams) if it is new
+qint32 AdfsNameIndex::internName(const QByteArray &name)
+{
+    QHash<QByteArray, qint32>::const_iterator i = nameNumbers.constFind(name);
+    if (i != nameNumbers.constEnd()) return i.value();
+
+    qint32 nameNumber = nameOffsets.size();
+    nameNumbers.insert(name, nameNumber);
+    nameOffsets.append(static_cast<quint32>(names.size()));
+    nameLengths.append(static_cast<quint8>(qMin(name.size(), 255)));
+    names.append(name.constData(), nameLengths.last());
+    firstNameNodes.append(-1);
+    lastNameNodes.append(-1);
+
+    // Names are added in order, so each trigram's list stays sorted (a trigram
+    // repeated within the name is only added once)
+    for (qint64 position = 0; position + 3 <= nameLengths.last(); position++) {
+        QVector<qint32> &trigramList = trigramNames[getTrigram(name.constData() + position)];
+        if (trigramList.isEmpty() || trigramList.last() != nameNumber) trigramList.append(nameNumber);
+    }
+
+    return nameNumber;
+}
+
+bool AdfsNameIndex::nameContains(qint32 nameNumber, const QByteArray &text) const
+{
+    const char *name = names.constData() + nameOffsets.at(nameNumber);
+    const char *nameEnd = name + nameLengths.at(nameNumber);
+
+    return std::search(name, nameEnd, text.constData(), text.constData() + text.size()) != nameEnd;
+}
+
+// Names are compared in upper case
+QByteArray AdfsNameIndex::getSearchText(const QString &text) const
+{
+    return text.toUpper().toLatin1();
+}
+
+quint32 AdfsNameIndex::getTrigram(const char *characters)
+{
+    const uchar *trigram = reinterpret_cast<const uchar *>(characters);
+    return (trigram[0] << 16) | (trigram[1] << 8) | trigram[2];
+}
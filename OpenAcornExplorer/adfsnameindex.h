@@ -0,0 +1,91 @@
+/************************************************************************
+
+    adfsnameindex.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef ADFSNAMEINDEX_H
+#define ADFSNAMEINDEX_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QHash>
+#include <QVector>
+
+#include "adfscatalogue.h"
+
+// A catalogue node found by a name search
+struct AdfsNameMatch
+{
+    qint32 catalogueNumber;     // Order in which the node's catalogue was added
+    qint32 nodeNumber;
+};
+
+// Index of the names in one or more catalogues for searching by any part of a
+// name (without regard to case).  Each distinct name is held once, and the
+// names are indexed by the three character sequences (trigrams) they contain,
+// so a search only examines the names holding every trigram of the search
+// text.  A search as the user types can refine the previous search's names
+// rather than starting again, as a longer search text only matches a subset
+class AdfsNameIndex
+{
+public:
+    AdfsNameIndex();
+
+    qint64 addCatalogue(const AdfsCatalogue &catalogue);
+    void clear();
+
+    qint64 getNumberOfCatalogues() const;
+    qint64 getNumberOfNames() const;
+    qint64 getNumberOfNodes() const;
+
+    QVector<qint32> findNames(const QString &text) const;
+    QVector<qint32> refineNames(const QVector<qint32> &nameNumbersParam, const QString &text) const;
+    QVector<AdfsNameMatch> getMatches(const QVector<qint32> &nameNumbersParam, qint64 maximumMatches) const;
+
+private:
+    qint64 numberOfCatalogues;
+
+    // Distinct (upper case) names, held in a single name table
+    QByteArray names;
+    QVector<quint32> nameOffsets;
+    QVector<quint8> nameLengths;
+    QHash<QByteArray, qint32> nameNumbers;
+
+    // The nodes with each name, as a list threaded through the node table
+    QVector<qint32> firstNameNodes;
+    QVector<qint32> lastNameNodes;
+    QVector<AdfsNameMatch> nodes;
+    QVector<qint32> nextNameNodes;
+
+    // Names containing each trigram, in name number order
+    QHash<quint32, QVector<qint32> > trigramNames;
+
+    qint32 internName(const QByteArray &name);
+    bool nameContains(qint32 nameNumber, const QByteArray &text) const;
+    QByteArray getSearchText(const QString &text) const;
+    static quint32 getTrigram(const char *characters);
+};
+
+#endif // ADFSNAMEINDEX_H
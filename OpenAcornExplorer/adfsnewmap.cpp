@@ -0,0 +1,507 @@
+/************************************************************************
+
+    adfsnewmap.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+#include "adfsnewmap.h"
+#include "logcategories.h"
+#include "tracerecorder.h"
+
+#include <algorithm>
+
+// The disc record is held in each zone after the 4 byte zone header, and
+// occupies the start of the bitstream in zone 0
+static const qint64 zoneHeaderBits = 32;
+static const qint64 discRecordOffset = 4;
+static const qint64 discRecordSize = 60;
+static const qint64 discRecordBits = discRecordSize * 8;
+
+// Fragment ids with a fixed meaning
+static const quint32 rootFragmentId = 2;        // The map and root directory
+
+AdfsNewMap::AdfsNewMap()
+{
+    mapData = new QByteArray;
+
+    log2SectorSize = 0;
+    idLength = 0;
+    log2BytesPerMapBit = 0;
+    numberOfZones = 0;
+    zoneBits = 0;
+}
+
+AdfsNewMap::~AdfsNewMap()
+{
+    delete mapData;
+}
+
+// Set the map from the data of all of its zones, verify the zone check bytes
+// and build the fragment index
+bool AdfsNewMap::setMap(const QByteArray &mapDataParam)
+{
+    TraceScope trace("parse", "AdfsNewMap::setMap");
+    trace.setBytes(mapDataParam.size());
+
+    // Copy the map data into the object
+    mapData->clear();
+    mapData->append(mapDataParam);
+    fragmentExtents.clear();
+    fragments.clear();
+    freeExtents.clear();
+
+    if (!isDiscRecordValid()) {
+        qCDebug(lcMap) << "AdfsNewMap::setMap(): Error, disc record is invalid!";
+        return false;
+    }
+
+    if (!checkZones()) return false;
+
+    if (!buildFragmentIndex()) {
+        fragmentExtents.clear();
+        fragments.clear();
+        freeExtents.clear();
+        return false;
+    }
+
+    return true;
+}
+
+// Disc record fields
+
+qint64 AdfsNewMap::getSectorSize()
+{
+    return 1 << log2SectorSize;
+}
+
+qint64 AdfsNewMap::getIdLength()
+{
+    return idLength;
+}
+
+qint64 AdfsNewMap::getBytesPerMapBit()
+{
+    return 1 << log2BytesPerMapBit;
+}
+
+qint64 AdfsNewMap::getNumberOfZones()
+{
+    return numberOfZones;
+}
+
+qint64 AdfsNewMap::getZoneSpare()
+{
+    return getDiscRecordInt(10, 2);
+}
+
+// Get the size of the disc in bytes
+qint64 AdfsNewMap::getDiscSize()
+{
+    return getDiscRecordInt(16, 4) | (getDiscRecordInt(36, 4) << 32);
+}
+
+qint64 AdfsNewMap::getDiscIdentifier()
+{
+    return getDiscRecordInt(20, 2);
+}
+
+qint64 AdfsNewMap::getBootOptionNumber()
+{
+    return getDiscRecordInt(7, 1);
+}
+
+QString AdfsNewMap::getDiscName()
+{
+    QByteArray discName = mapData->mid(discRecordOffset + 22, 10);
+
+    qint64 nameLength = 0;
+    while (nameLength < discName.size() && static_cast<quint8>(discName.at(nameLength)) > 0x20) nameLength++;
+
+    return QString::fromLatin1(discName.left(nameLength));
+}
+
+// Get the indirect disc address of the root directory
+qint64 AdfsNewMap::getRootDirectoryAddress()
+{
+    return getDiscRecordInt(12, 4);
+}
+
+// Get the size of the root directory in bytes
+// Note: Only big directory discs record the size; others have a 2048 byte root
+qint64 AdfsNewMap::getRootDirectorySize()
+{
+    qint64 rootDirectorySize = getDiscRecordInt(0x30, 4);
+    if (rootDirectorySize == 0) rootDirectorySize = 2048;
+
+    return rootDirectorySize;
+}
+
+// Get the sharing granularity in bytes (objects sharing a fragment start on a
+// multiple of this within it)
+qint64 AdfsNewMap::getShareSize()
+{
+    return getSectorSize() << (getDiscRecordInt(0x28, 1) & 0x0F);
+}
+
+// Determine if the disc uses big directories (E+ and F+ formats)
+bool AdfsNewMap::isBigDirectoryFormat()
+{
+    return getDiscRecordInt(0x2C, 4) == 1;
+}
+
+// Get the byte position of the map on the disc (the map is followed by a copy
+// of itself)
+qint64 AdfsNewMap::getMapPosition()
+{
+    qint64 mapPosition, mapLength;
+    if (!getMapLocation(mapData->mid(discRecordOffset, discRecordSize), &mapPosition, &mapLength)) return -1;
+
+    return mapPosition;
+}
+
+// Fragment index
+
+qint64 AdfsNewMap::getNumberOfFragments()
+{
+    return fragments.size();
+}
+
+qint64 AdfsNewMap::getNumberOfFragmentExtents()
+{
+    return fragmentExtents.size();
+}
+
+// Get the extents of a fragment (empty if the fragment is not in the map)
+QVector<AdfsDiscExtent> AdfsNewMap::getFragmentExtents(qint64 fragmentId)
+{
+    QHash<quint32, FragmentRange>::const_iterator i = fragments.constFind(static_cast<quint32>(fragmentId));
+    if (i == fragments.constEnd()) return QVector<AdfsDiscExtent>();
+
+    return fragmentExtents.mid(i.value().firstExtent, i.value().numberOfExtents);
+}
+
+// Get the free space on the disc
+QVector<AdfsDiscExtent> AdfsNewMap::getFreeExtents()
+{
+    return freeExtents;
+}
+
+qint64 AdfsNewMap::getFreeBytes()
+{
+    qint64 freeBytes = 0;
+    for (const AdfsDiscExtent &extent : freeExtents) freeBytes += extent.length;
+
+    return freeBytes;
+}
+
+// Resolve an indirect disc address to the byte position of the start of the
+// object on the disc (-1 if the address is not in the map)
+qint64 AdfsNewMap::resolveAddress(qint64 indirectAddress)
+{
+    QVector<AdfsDiscExtent> extents;
+    if (!getObjectExtents(indirectAddress, 1, &extents)) return -1;
+
+    return extents.first().bytePosition;
+}
+
+// Get the extents holding an object of the given length in bytes
+// Note: The indirect disc address holds the fragment id in bits 8 upwards; if
+// the fragment is shared, bits 0-7 hold the object's position in it plus one
+bool AdfsNewMap::getObjectExtents(qint64 indirectAddress, qint64 length, QVector<AdfsDiscExtent> *extents)
+{
+    extents->clear();
+
+    quint32 fragmentId = static_cast<quint32>(indirectAddress >> 8);
+    qint64 offset = 0;
+    if ((indirectAddress & 0xFF) != 0) offset = ((indirectAddress & 0xFF) - 1) * getShareSize();
+
+    QHash<quint32, FragmentRange>::const_iterator i = fragments.constFind(fragmentId);
+    if (i == fragments.constEnd()) {
+        qCDebug(lcMap) << "AdfsNewMap::getObjectExtents(): Fragment" << fragmentId << "is not in the map";
+        return false;
+    }
+
+    // Skip to the object's offset within the fragment and take its length
+    qint64 remaining = length;
+    const AdfsDiscExtent *extent = fragmentExtents.constData() + i.value().firstExtent;
+    const AdfsDiscExtent *endExtent = extent + i.value().numberOfExtents;
+    for (; extent != endExtent && remaining > 0; ++extent) {
+        if (offset >= extent->length) {
+            offset -= extent->length;
+            continue;
+        }
+
+        qint64 extentLength = qMin(extent->length - offset, remaining);
+        extents->append({extent->bytePosition + offset, extentLength});
+        remaining -= extentLength;
+        offset = 0;
+    }
+
+    if (remaining > 0) {
+        qCDebug(lcMap) << "AdfsNewMap::getObjectExtents(): Fragment" << fragmentId << "is too short for an object of" << length << "bytes";
+        extents->clear();
+        return false;
+    }
+
+    return true;
+}
+
+// Get the position and length of the map on the disc from a disc record (taken
+// from zone 0 or the boot block).  Multi-zone maps are held in the middle of
+// the disc, starting with the zone at half the number of zones
+bool AdfsNewMap::getMapLocation(const QByteArray &discRecord, qint64 *bytePosition, qint64 *length)
+{
+    if (discRecord.size() < discRecordSize) return false;
+
+    const uchar *record = reinterpret_cast<const uchar *>(discRecord.constData());
+    qint64 recordLog2SectorSize = record[0];
+    qint64 recordLog2BytesPerMapBit = record[5];
+    qint64 recordZones = record[9] | (record[42] << 8);
+    qint64 recordZoneSpare = record[10] | (record[11] << 8);
+
+    if (recordLog2SectorSize < 8 || recordLog2SectorSize > 12 || recordLog2BytesPerMapBit > 12) return false;
+    if (recordZones < 1 || recordZoneSpare < zoneHeaderBits || recordZoneSpare >= (8 << recordLog2SectorSize)) return false;
+
+    qint64 recordZoneBits = (8 << recordLog2SectorSize) - recordZoneSpare;
+    qint64 mapBit = 0;
+    if (recordZones > 1) mapBit = ((recordZones >> 1) * recordZoneBits) - discRecordBits;
+
+    *bytePosition = mapBit << recordLog2BytesPerMapBit;
+    *length = recordZones << recordLog2SectorSize;
+    return true;
+}
+
+// Calculate the check byte of a new map zone
+qint64 AdfsNewMap::calculateZoneCheck(const char *zone, qint64 zoneSize)
+{
+    const uchar *map = reinterpret_cast<const uchar *>(zone);
+    quint32 sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+
+    // Sum the zone a word at a time (from the end), carrying between the bytes
+    for (qint64 position = zoneSize - 4; position > 0; position -= 4) {
+        sum0 += map[position] + (sum3 >> 8);
+        sum3 &= 0xFF;
+        sum1 += map[position + 1] + (sum0 >> 8);
+        sum0 &= 0xFF;
+        sum2 += map[position + 2] + (sum1 >> 8);
+        sum1 &= 0xFF;
+        sum3 += map[position + 3] + (sum2 >> 8);
+        sum2 &= 0xFF;
+    }
+
+    // The first word (which holds the check byte itself) is summed without byte 0
+    sum0 += sum3 >> 8;
+    sum1 += map[1] + (sum0 >> 8);
+    sum2 += map[2] + (sum1 >> 8);
+    sum3 += map[3] + (sum2 >> 8);
+
+    return (sum0 ^ sum1 ^ sum2 ^ sum3) & 0xFF;
+}
+
+// Private methods
+
+// Read the disc record from zone 0 and check that it describes this map
+bool AdfsNewMap::isDiscRecordValid()
+{
+    if (mapData->size() < discRecordOffset + discRecordSize) return false;
+
+    qint64 mapPosition, mapLength;
+    if (!getMapLocation(mapData->mid(discRecordOffset, discRecordSize), &mapPosition, &mapLength)) return false;
+    if (mapData->size() != mapLength) return false;
+
+    log2SectorSize = getDiscRecordInt(0, 1);
+    idLength = getDiscRecordInt(4, 1);
+    log2BytesPerMapBit = getDiscRecordInt(5, 1);
+    numberOfZones = getDiscRecordInt(9, 1) | (getDiscRecordInt(42, 1) << 8);
+    zoneBits = (8 << log2SectorSize) - getZoneSpare();
+
+    // Fragment ids must fit in an indirect disc address, and a fragment must be
+    // able to fit in a zone
+    if (idLength < 8 || idLength > 24 || idLength >= zoneBits) return false;
+
+    // The disc must extend beyond the first zone's disc record
+    return (getDiscSize() >> log2BytesPerMapBit) > (numberOfZones - 1) * zoneBits - discRecordBits;
+}
+
+// Verify the check byte of each zone and the cross check over all zones
+bool AdfsNewMap::checkZones()
+{
+    qint64 sectorSize = getSectorSize();
+    quint8 crossCheck = 0;
+
+    for (qint64 zone = 0; zone < numberOfZones; zone++) {
+        const char *zoneData = mapData->constData() + zone * sectorSize;
+
+        if (static_cast<quint8>(zoneData[0]) != calculateZoneCheck(zoneData, sectorSize)) {
+            qCDebug(lcMap) << "AdfsNewMap::checkZones(): Error, zone" << zone << "check byte is invalid! Calculated =" <<
+                        calculateZoneCheck(zoneData, sectorSize) << " on disc =" << static_cast<quint8>(zoneData[0]);
+            return false;
+        }
+
+        crossCheck ^= static_cast<quint8>(zoneData[3]);
+    }
+
+    if (crossCheck != 0xFF) {
+        qCDebug(lcMap) << "AdfsNewMap::checkZones(): Error, zone cross check is invalid!";
+        return false;
+    }
+
+    return true;
+}
+
+// Parse the bitstream of every zone and index the extents of each fragment
+bool AdfsNewMap::buildFragmentIndex()
+{
+    // A fragment extent tagged with the fragment id and its zone's position in
+    // the search order for that fragment
+    struct FragmentExtent
+    {
+        quint32 fragmentId;
+        qint64 searchOrder;
+        AdfsDiscExtent extent;
+    };
+
+    QVector<FragmentExtent> parsedExtents;
+    qint64 zoneSizeBits = getSectorSize() * 8;
+    qint64 discBits = getDiscSize() >> log2BytesPerMapBit;
+
+    for (qint64 zone = 0; zone < numberOfZones; zone++) {
+        // Bit positions within the map data; zone 0's bitstream starts after the
+        // disc record, which takes the place of the first map bits of the disc
+        qint64 zoneStart = zone * zoneSizeBits;
+        qint64 startBit = zoneStart + zoneHeaderBits + ((zone == 0) ? discRecordBits : 0);
+        qint64 endBit = zoneStart + zoneHeaderBits + zoneBits;
+        qint64 startMapBit = (zone == 0) ? 0 : (zone * zoneBits) - discRecordBits;
+
+        // The last zone only covers the remainder of the disc
+        if (zone == numberOfZones - 1) endBit = qMin(endBit, startBit + discBits - startMapBit);
+
+        // The zone header holds the offset of the first free fragment from bit 8;
+        // each free fragment's id is the offset to the next one
+        qint64 freeLink = getBits(zoneStart + 8, 15);
+        qint64 nextFreeBit = (freeLink != 0) ? zoneStart + 8 + freeLink : -1;
+
+        for (qint64 bitPosition = startBit; bitPosition < endBit;) {
+            quint32 fragmentId = getBits(bitPosition, idLength);
+            qint64 fragmentEnd = findSetBit(bitPosition + idLength, endBit);
+            if (fragmentEnd < 0) {
+                qCDebug(lcMap) << "AdfsNewMap::buildFragmentIndex(): Error, unterminated fragment in zone" << zone;
+                return false;
+            }
+
+            AdfsDiscExtent extent;
+            extent.bytePosition = (bitPosition - startBit + startMapBit) << log2BytesPerMapBit;
+            extent.length = (fragmentEnd + 1 - bitPosition) << log2BytesPerMapBit;
+
+            if (bitPosition == nextFreeBit) {
+                freeExtents.append(extent);
+                qint64 nextFreeOffset = fragmentId & 0x7FFF;
+                nextFreeBit = (nextFreeOffset != 0) ? bitPosition + nextFreeOffset : -1;
+            } else {
+                // Fragments are searched for from their start zone onwards, wrapping
+                // around the end of the map
+                qint64 searchOrder = (zone - getStartZone(fragmentId) + numberOfZones) % numberOfZones;
+                parsedExtents.append({fragmentId, searchOrder, extent});
+            }
+
+            bitPosition = fragmentEnd + 1;
+        }
+    }
+
+    // Group the extents by fragment id; the parse order (by zone and then by
+    // position) is kept within each search order position
+    std::stable_sort(parsedExtents.begin(), parsedExtents.end(), [](const FragmentExtent &a, const FragmentExtent &b) {
+        if (a.fragmentId != b.fragmentId) return a.fragmentId < b.fragmentId;
+        return a.searchOrder < b.searchOrder;
+    });
+
+    fragmentExtents.reserve(parsedExtents.size());
+    for (const FragmentExtent &parsedExtent : parsedExtents) {
+        FragmentRange &range = fragments[parsedExtent.fragmentId];
+        if (range.numberOfExtents == 0) range.firstExtent = fragmentExtents.size();
+        range.numberOfExtents++;
+
+        fragmentExtents.append(parsedExtent.extent);
+    }
+
+    return true;
+}
+
+// Read a number of bits (up to 32) from the map, least significant bit first
+quint32 AdfsNewMap::getBits(qint64 bitPosition, qint64 numberOfBits)
+{
+    const uchar *map = reinterpret_cast<const uchar *>(mapData->constData());
+    quint32 value = 0;
+
+    for (qint64 bit = 0; bit < numberOfBits;) {
+        qint64 position = bitPosition + bit;
+        qint64 bitsFromByte = qMin(8 - (position & 7), numberOfBits - bit);
+
+        value |= static_cast<quint32>((map[position >> 3] >> (position & 7)) & ((1 << bitsFromByte) - 1)) << bit;
+        bit += bitsFromByte;
+    }
+
+    return value;
+}
+
+// Find the next set bit in the map (-1 if there is none before the end position)
+qint64 AdfsNewMap::findSetBit(qint64 bitPosition, qint64 endBitPosition)
+{
+    const uchar *map = reinterpret_cast<const uchar *>(mapData->constData());
+
+    while (bitPosition < endBitPosition) {
+        // Skip whole zero bytes
+        if ((bitPosition & 7) == 0 && bitPosition + 8 <= endBitPosition && map[bitPosition >> 3] == 0) {
+            bitPosition += 8;
+            continue;
+        }
+
+        if ((map[bitPosition >> 3] >> (bitPosition & 7)) & 1) return bitPosition;
+        bitPosition++;
+    }
+
+    return -1;
+}
+
+// Get the zone in which the filing system starts searching for a fragment
+qint64 AdfsNewMap::getStartZone(quint32 fragmentId)
+{
+    // The map and root directory fragment starts with the map in the middle of the disc
+    if (fragmentId == rootFragmentId) return numberOfZones >> 1;
+
+    qint64 idsPerZone = zoneBits / (idLength + 1);
+    return (fragmentId / idsPerZone) % numberOfZones;
+}
+
+// Get a little-endian integer from the disc record in zone 0
+qint64 AdfsNewMap::getDiscRecordInt(qint64 offset, qint64 numberOfBytes)
+{
+    if (mapData->size() < discRecordOffset + discRecordSize) return 0;
+
+    qint64 value = 0;
+    for (qint64 byte = numberOfBytes - 1; byte >= 0; byte--) {
+        value = (value << 8) | static_cast<quint8>(mapData->at(discRecordOffset + offset + byte));
+    }
+
+    return value;
+}
@@ -0,0 +1,119 @@
+/************************************************************************
+
+    adfsnewmap.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+#ifndef ADFSNEWMAP_H
+#define ADFSNEWMAP_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QHash>
+#include <QVector>
+
+// A run of bytes on the disc holding all or part of an object
+struct AdfsDiscExtent
+{
+    qint64 bytePosition;
+    qint64 length;
+};
+
+// The new map (zone map) used by E and F format discs.  The map is a bitstream
+// split into zones (one sector each); each bit stands for a fixed number of
+// bytes on the disc and objects are described by fragments - a fragment id
+// followed by zero bits and terminated by a one bit.  An object's indirect disc
+// address holds its fragment id, so the zones are parsed once when the map is
+// set and the extents of every fragment are indexed by id.  Resolving an
+// indirect disc address is then a hash lookup rather than a scan of the zones
+class AdfsNewMap
+{
+public:
+    AdfsNewMap();
+    ~AdfsNewMap();
+
+    bool setMap(const QByteArray &mapDataParam);
+
+    // Disc record
+    qint64 getSectorSize();
+    qint64 getIdLength();
+    qint64 getBytesPerMapBit();
+    qint64 getNumberOfZones();
+    qint64 getZoneSpare();
+    qint64 getDiscSize();
+    qint64 getDiscIdentifier();
+    qint64 getBootOptionNumber();
+    QString getDiscName();
+    qint64 getRootDirectoryAddress();
+    qint64 getRootDirectorySize();
+    qint64 getShareSize();
+    bool isBigDirectoryFormat();
+    qint64 getMapPosition();
+
+    // Fragment index
+    qint64 getNumberOfFragments();
+    qint64 getNumberOfFragmentExtents();
+    QVector<AdfsDiscExtent> getFragmentExtents(qint64 fragmentId);
+    QVector<AdfsDiscExtent> getFreeExtents();
+    qint64 getFreeBytes();
+    qint64 resolveAddress(qint64 indirectAddress);
+    bool getObjectExtents(qint64 indirectAddress, qint64 length, QVector<AdfsDiscExtent> *extents);
+
+    static bool getMapLocation(const QByteArray &discRecord, qint64 *bytePosition, qint64 *length);
+    static qint64 calculateZoneCheck(const char *zone, qint64 zoneSize);
+
+private:
+    Q_DISABLE_COPY(AdfsNewMap)
+
+    // Extents of a fragment within the fragment extent table
+    struct FragmentRange
+    {
+        qint32 firstExtent = 0;
+        qint32 numberOfExtents = 0;
+    };
+
+    QByteArray *mapData;
+
+    // Disc record fields used to parse the map
+    qint64 log2SectorSize;
+    qint64 idLength;
+    qint64 log2BytesPerMapBit;
+    qint64 numberOfZones;
+    qint64 zoneBits;
+
+    // Extents of all fragments, grouped by fragment id and held in the order
+    // that the filing system searches the zones
+    QVector<AdfsDiscExtent> fragmentExtents;
+    QHash<quint32, FragmentRange> fragments;
+    QVector<AdfsDiscExtent> freeExtents;
+
+    bool isDiscRecordValid();
+    bool checkZones();
+    bool buildFragmentIndex();
+    quint32 getBits(qint64 bitPosition, qint64 numberOfBits);
+    qint64 findSetBit(qint64 bitPosition, qint64 endBitPosition);
+    qint64 getStartZone(quint32 fragmentId);
+    qint64 getDiscRecordInt(qint64 offset, qint64 numberOfBytes);
+};
+
+#endif // ADFSNEWMAP_H
@@ -0,0 +1,187 @@
+/************************************************************************
+
+    adfspathindex.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+#include "adfspathindex.h"
+
+#include <algorithm>
+
+AdfsPathIndex::AdfsPathIndex()
+{
+    catalogue = nullptr;
+}
+
+// Build the index from a catalogue
+void AdfsPathIndex::build(const AdfsCatalogue *catalogueParam)
+{
+    clear();
+    catalogue = catalogueParam;
+
+    qint64 numberOfNodes = catalogue->getNumberOfNodes();
+    if (numberOfNodes == 0) return;
+
+    nodesByPath.reserve(static_cast<int>(numberOfNodes));
+    nodePaths.resize(static_cast<int>(numberOfNodes));
+
+    // Parents are always stored before their children, so each path is built
+    // from its parent's path in a single pass
+    nodePaths[0] = "$";
+    nodesByPath.insert(nodePaths.at(0), 0);
+
+    for (qint64 nodeNumber = 1; nodeNumber < numberOfNodes; nodeNumber++) {
+        const AdfsCatalogueNode &node = catalogue->getNode(nodeNumber);
+        nodePaths[nodeNumber] = nodePaths.at(node.parent) + "." + catalogue->getNodeName(nodeNumber).toUpper();
+
+        // The first of any entries with the same path is found
+        if (!nodesByPath.contains(nodePaths.at(nodeNumber))) nodesByPath.insert(nodePaths.at(nodeNumber), static_cast<qint32>(nodeNumber));
+    }
+}
+
+void AdfsPathIndex::clear()
+{
+    catalogue = nullptr;
+    nodesByPath.clear();
+    nodePaths.clear();
+}
+
+qint64 AdfsPathIndex::getNumberOfPaths() const
+{
+    return nodesByPath.size();
+}
+
+// Find the node with a path; paths not starting with "$" are taken to be
+// relative to the root directory.  Returns -1 if there is no such node
+qint64 AdfsPathIndex::findNode(const QString &path) const
+{
+    return nodesByPath.value(normalisePath(path), -1);
+}
+
+// Find the directory entry (which holds the disc address) of a path
+bool AdfsPathIndex::findEntry(const QString &path, AdfsDirectoryEntry *entry) const
+{
+    qint64 nodeNumber = findNode(path);
+    if (nodeNumber < 0) return false;
+
+    *entry = catalogue->getNode(nodeNumber).entry;
+    return true;
+}
+
+// Find the nodes matching a path pattern, in catalogue order.  Components
+// without wildcards are resolved through the index; only components with
+// wildcards search the children of the directories matched so far
+QVector<qint64> AdfsPathIndex::match(const QString &pattern) const
+{
+    QVector<qint64> matches;
+    if (catalogue == nullptr || nodePaths.isEmpty()) return matches;
+
+    QString normalisedPattern = normalisePath(pattern);
+    if (!isWildcardPattern(normalisedPattern)) {
+        qint64 nodeNumber = nodesByPath.value(normalisedPattern, -1);
+        if (nodeNumber >= 0) matches.append(nodeNumber);
+        return matches;
+    }
+
+    QStringList components = normalisedPattern.split('.');
+    matches.append(0);
+    for (qint64 component = 1; component < components.size() && !matches.isEmpty(); component++) {
+        const QString &componentPattern = components.at(component);
+        bool wildcardComponent = isWildcardPattern(componentPattern);
+
+        QVector<qint64> componentMatches;
+        for (qint64 nodeNumber : matches) {
+            const AdfsCatalogueNode &node = catalogue->getNode(nodeNumber);
+            if (!node.isDirectory()) continue;
+
+            if (!wildcardComponent) {
+                qint64 childNumber = nodesByPath.value(nodePaths.at(nodeNumber) + "." + componentPattern, -1);
+                if (childNumber >= 0) componentMatches.append(childNumber);
+                continue;
+            }
+
+            for (qint64 childNumber = node.firstChild; childNumber < node.firstChild + node.childCount; childNumber++) {
+                if (matchName(componentPattern, catalogue->getNodeName(childNumber).toUpper())) componentMatches.append(childNumber);
+            }
+        }
+
+        matches = componentMatches;
+    }
+
+    std::sort(matches.begin(), matches.end());
+    return matches;
+}
+
+// Determine if a pattern contains wildcards
+bool AdfsPathIndex::isWildcardPattern(const QString &pattern)
+{
+    return pattern.contains('#') || pattern.contains('*');
+}
+
+// Match a name against a pattern with the ADFS wildcards; '#' matches any one
+// character and '*' matches any number of characters (including none)
+// Note: The comparison is case sensitive; callers pass upper case strings
+bool AdfsPathIndex::matchName(const QString &pattern, const QString &name)
+{
+    qint64 patternPosition = 0;
+    qint64 namePosition = 0;
+
+    // Position of the last '*' and the name position it has been matched up to
+    qint64 starPosition = -1;
+    qint64 starNamePosition = 0;
+
+    while (namePosition < name.size()) {
+        if (patternPosition < pattern.size() &&
+                (pattern.at(patternPosition) == '#' || pattern.at(patternPosition) == name.at(namePosition))) {
+            patternPosition++;
+            namePosition++;
+        } else if (patternPosition < pattern.size() && pattern.at(patternPosition) == '*') {
+            starPosition = patternPosition++;
+            starNamePosition = namePosition;
+        } else if (starPosition >= 0) {
+            // Let the last '*' match one more character
+            patternPosition = starPosition + 1;
+            namePosition = ++starNamePosition;
+        } else {
+            return false;
+        }
+    }
+
+    // Any remaining pattern must be all '*'
+    while (patternPosition < pattern.size() && pattern.at(patternPosition) == '*') patternPosition++;
+
+    return patternPosition == pattern.size();
+}
+
+// Private methods
+
+// Convert a path to the form held in the index (upper case and starting "$")
+QString AdfsPathIndex::normalisePath(const QString &path) const
+{
+    QString normalisedPath = path.trimmed().toUpper();
+
+    if (normalisedPath.isEmpty()) return QString("$");
+    if (normalisedPath != "$" && !normalisedPath.startsWith("$.")) normalisedPath = "$." + normalisedPath;
+
+    return normalisedPath;
+}
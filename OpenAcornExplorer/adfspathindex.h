@@ -0,0 +1,69 @@
+/************************************************************************
+
+    adfspathindex.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+#ifndef ADFSPATHINDEX_H
+#define ADFSPATHINDEX_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QHash>
+#include <QVector>
+
+#include "adfscatalogue.h"
+
+// Index of the full ADFS path (e.g. "$.GAMES.ELITE") of every node in a
+// catalogue.  Paths are compared without regard to case, as ADFS does, so
+// resolving a path is a single hash lookup rather than a walk of the directory
+// tree.  Patterns may use the ADFS wildcards '#' (any one character) and '*'
+// (any number of characters) within each path component.
+// Note: The catalogue is not owned by the index and must outlive it
+class AdfsPathIndex
+{
+public:
+    AdfsPathIndex();
+
+    void build(const AdfsCatalogue *catalogueParam);
+    void clear();
+
+    qint64 getNumberOfPaths() const;
+    qint64 findNode(const QString &path) const;
+    bool findEntry(const QString &path, AdfsDirectoryEntry *entry) const;
+    QVector<qint64> match(const QString &pattern) const;
+
+    static bool isWildcardPattern(const QString &pattern);
+    static bool matchName(const QString &pattern, const QString &name);
+
+private:
+    const AdfsCatalogue *catalogue;
+
+    // Upper case path -> node number, and the upper case path of each node
+    QHash<QString, qint32> nodesByPath;
+    QVector<QString> nodePaths;
+
+    QString normalisePath(const QString &path) const;
+};
+
+#endif // ADFSPATHINDEX_H
@@ -0,0 +1,657 @@
+/************************************************************************
+
+    compressedimagefile.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "compressedimagefile.h"
+#include "logcategories.h"
+#include "xxhash64.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+
+#include <algorithm>
+
+// Deflate window (the furthest back compressed data can refer to), the spacing
+// of checkpoints in the uncompressed image and the size of each read from the
+// compressed file
+static const qint64 windowSize = 32768;
+static const qint64 checkpointSpacing = 32768;
+static const qint64 inputBufferSize = 16384;
+
+// Index cache file identification ("OAEZ") and format version
+static const quint32 indexMagic = 0x4f41455a;
+static const qint32 indexVersion = 1;
+
+// A file within a zip archive, from the archive's central directory
+struct ZipEntry
+{
+    QString name;
+    quint16 flags;
+    quint16 method;
+    qint64 compressedSize;
+    qint64 uncompressedSize;
+    qint64 localHeaderPosition;
+};
+
+// Return the position of the '#' separating the archive and the member in an
+// archive.zip#member filename (-1 if there is no member)
+static int getMemberSeparator(const QString &filename)
+{
+    int separator = filename.indexOf(".zip#", 0, Qt::CaseInsensitive);
+    if (separator < 0) return -1;
+
+    return separator + 4;
+}
+
+static bool readFileBytes(QFile *file, qint64 position, qint64 length, QByteArray *data)
+{
+    if (!file->seek(position)) return false;
+
+    *data = file->read(length);
+    return data->size() == length;
+}
+
+// Read the central directory of a zip archive
+// Note: Zip64 archives (with files or archives over 4GB) are not supported
+static bool readZipDirectory(QFile *archiveFile, QVector<ZipEntry> *entries)
+{
+    entries->clear();
+
+    // The end of central directory record is the last 22 bytes of the archive,
+    // unless it is followed by a comment (of up to 65535 bytes)
+    qint64 tailLength = qMin(archiveFile->size(), static_cast<qint64>(22 + 65535));
+    QByteArray tail;
+    if (tailLength < 22 || !readFileBytes(archiveFile, archiveFile->size() - tailLength, tailLength, &tail)) return false;
+
+    int endPosition = tail.lastIndexOf(QByteArray("PK\x05\x06", 4));
+    if (endPosition < 0 || endPosition + 22 > tail.size()) return false;
+
+    const uchar *endRecord = reinterpret_cast<const uchar *>(tail.constData()) + endPosition;
+    qint64 numberOfEntries = qFromLittleEndian<quint16>(endRecord + 10);
+    qint64 directorySize = qFromLittleEndian<quint32>(endRecord + 12);
+    qint64 directoryPosition = qFromLittleEndian<quint32>(endRecord + 16);
+
+    QByteArray directory;
+    if (!readFileBytes(archiveFile, directoryPosition, directorySize, &directory)) return false;
+
+    const uchar *directoryData = reinterpret_cast<const uchar *>(directory.constData());
+    qint64 entryPosition = 0;
+    for (qint64 entryNumber = 0; entryNumber < numberOfEntries; entryNumber++) {
+        if (entryPosition + 46 > directory.size()) return false;
+
+        const uchar *entryData = directoryData + entryPosition;
+        if (qFromLittleEndian<quint32>(entryData) != 0x02014b50) return false;
+
+        qint64 nameLength = qFromLittleEndian<quint16>(entryData + 28);
+        qint64 extraLength = qFromLittleEndian<quint16>(entryData + 30);
+        qint64 commentLength = qFromLittleEndian<quint16>(entryData + 32);
+        if (entryPosition + 46 + nameLength > directory.size()) return false;
+
+        ZipEntry entry;
+        entry.flags = qFromLittleEndian<quint16>(entryData + 8);
+        entry.method = qFromLittleEndian<quint16>(entryData + 10);
+        entry.compressedSize = qFromLittleEndian<quint32>(entryData + 20);
+        entry.uncompressedSize = qFromLittleEndian<quint32>(entryData + 24);
+        entry.localHeaderPosition = qFromLittleEndian<quint32>(entryData + 42);
+
+        // Names are UTF-8 if flag bit 11 is set
+        const char *name = reinterpret_cast<const char *>(entryData + 46);
+        if (entry.flags & 0x0800) entry.name = QString::fromUtf8(name, static_cast<int>(nameLength));
+        else entry.name = QString::fromLatin1(name, static_cast<int>(nameLength));
+
+        // Directories are only listed for their names
+        if (!entry.name.endsWith("/")) entries->append(entry);
+        entryPosition += 46 + nameLength + extraLength + commentLength;
+    }
+
+    return true;
+}
+
+// Class constructor
+// Note: The filename may be archive.zip#member to select a particular image
+// within a zip archive (by default the first file in the archive)
+CompressedImageFile::CompressedImageFile(const QString &filename)
+{
+    int separator = getMemberSeparator(filename);
+    if (separator >= 0 && !QFile::exists(filename)) {
+        compressedFile.setFileName(filename.left(separator));
+        memberName = filename.mid(separator + 1);
+    } else {
+        compressedFile.setFileName(filename);
+    }
+
+    dataPosition = 0;
+    compressedSize = 0;
+    uncompressedSize = 0;
+    storedData = false;
+    lastBoundaryPosition = 0;
+    checkpointsAdded = false;
+    streamActive = false;
+    streamInputPosition = 0;
+    streamOutputPosition = 0;
+    streamRestartPosition = 0;
+}
+
+// Class destructor
+CompressedImageFile::~CompressedImageFile()
+{
+    close();
+}
+
+// Is the file a compressed disc image (judged by its name)?
+bool CompressedImageFile::isCompressedImage(const QString &filename)
+{
+    if (getMemberSeparator(filename) >= 0) return true;
+
+    return filename.endsWith(".gz", Qt::CaseInsensitive) || filename.endsWith(".zip", Qt::CaseInsensitive);
+}
+
+// Get the filenames (as archive.zip#member) of the files within a zip archive
+QStringList CompressedImageFile::getArchiveImages(const QString &archiveFilename)
+{
+    QStringList imageFilenames;
+
+    QFile archiveFile(archiveFilename);
+    if (!archiveFile.open(QIODevice::ReadOnly)) return imageFilenames;
+
+    QVector<ZipEntry> entries;
+    if (!readZipDirectory(&archiveFile, &entries)) {
+        qCDebug(lcDiscImage) << "CompressedImageFile::getArchiveImages(): Cannot read zip archive" << archiveFilename;
+        return imageFilenames;
+    }
+
+    for (const ZipEntry &entry : entries) imageFilenames.append(archiveFilename + "#" + entry.name);
+    return imageFilenames;
+}
+
+// Create an (unopened) device for reading a disc image file, which is
+// decompressed as it is read if the image is compressed
+QIODevice *CompressedImageFile::createImageDevice(const QString &filename)
+{
+    if (isCompressedImage(filename)) return new CompressedImageFile(filename);
+
+    return new QFile(filename);
+}
+
+// Open the compressed image (only reading is supported)
+bool CompressedImageFile::open(OpenMode mode)
+{
+    if (isOpen() || (mode & QIODevice::WriteOnly)) return false;
+
+    if (!compressedFile.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        setErrorString(compressedFile.errorString());
+        return false;
+    }
+
+    // Identify the container from its signature
+    QByteArray signature;
+    bool opened = false;
+    if (readFileBytes(&compressedFile, 0, 4, &signature)) {
+        if (signature.startsWith("\x1f\x8b")) opened = openGzip();
+        else if (signature == QByteArray("PK\x03\x04", 4)) opened = openZip();
+    }
+
+    if (!opened) {
+        qCDebug(lcDiscImage) << "CompressedImageFile::open(): Cannot read compressed image" << compressedFile.fileName() << memberName;
+        setErrorString("Not a supported compressed disc image");
+        compressedFile.close();
+        return false;
+    }
+
+    statistics = CompressedImageStatistics();
+    checkpoints.clear();
+    checkpointsAdded = false;
+
+    // Decompression always starts at the beginning of the image (stored data
+    // is read directly, so has no checkpoints)
+    lastBoundaryPosition = 0;
+    if (!storedData) {
+        if (!loadIndex()) {
+            Checkpoint start;
+            start.uncompressedPosition = 0;
+            start.compressedPosition = 0;
+            start.bits = 0;
+            checkpoints.append(start);
+        }
+        lastBoundaryPosition = checkpoints.last().uncompressedPosition;
+    }
+    statistics.checkpoints = checkpoints.size();
+
+    // Reads are made at exact positions, so there is no read-ahead buffering
+    return QIODevice::open(mode | QIODevice::Unbuffered);
+}
+
+// Close the compressed image, saving the index if it has grown
+void CompressedImageFile::close()
+{
+    if (!isOpen()) return;
+
+    if (checkpointsAdded) saveIndex();
+    endStream();
+    compressedFile.close();
+
+    QIODevice::close();
+}
+
+// Get the size of the (uncompressed) image
+qint64 CompressedImageFile::size() const
+{
+    return uncompressedSize;
+}
+
+bool CompressedImageFile::isSequential() const
+{
+    return false;
+}
+
+CompressedImageStatistics CompressedImageFile::getStatistics() const
+{
+    return statistics;
+}
+
+// Read from the current position of the (uncompressed) image
+qint64 CompressedImageFile::readData(char *data, qint64 maxSize)
+{
+    qint64 position = pos();
+    qint64 length = qMin(maxSize, uncompressedSize - position);
+    if (length <= 0) return 0;
+
+    bool dataRead = storedData ? readCompressed(dataPosition + position, data, length)
+                               : inflateRange(position, data, length);
+
+    return dataRead ? length : -1;
+}
+
+qint64 CompressedImageFile::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+
+    return -1;
+}
+
+// Private methods
+
+// Find the deflate data within a gzip file (after the header and any optional
+// fields, and before the 8 byte trailer which ends with the image size)
+// Note: Only the first member of a multi-member gzip file is read
+bool CompressedImageFile::openGzip()
+{
+    QByteArray header;
+    if (!readFileBytes(&compressedFile, 0, 10, &header) || static_cast<quint8>(header[2]) != 8) return false;
+
+    quint8 flags = static_cast<quint8>(header[3]);
+    qint64 position = 10;
+    QByteArray field;
+
+    // Extra field
+    if (flags & 0x04) {
+        if (!readFileBytes(&compressedFile, position, 2, &field)) return false;
+        position += 2 + qFromLittleEndian<quint16>(field.constData());
+    }
+
+    // Original filename and comment (both zero terminated)
+    for (quint8 stringFlag : {static_cast<quint8>(0x08), static_cast<quint8>(0x10)}) {
+        if (!(flags & stringFlag)) continue;
+
+        do {
+            if (!readFileBytes(&compressedFile, position, 1, &field)) return false;
+            position++;
+        } while (field[0] != '\0');
+    }
+
+    // Header CRC
+    if (flags & 0x02) position += 2;
+
+    QByteArray trailer;
+    if (!readFileBytes(&compressedFile, compressedFile.size() - 4, 4, &trailer)) return false;
+
+    dataPosition = position;
+    compressedSize = compressedFile.size() - position - 8;
+    uncompressedSize = qFromLittleEndian<quint32>(trailer.constData());
+    storedData = false;
+
+    return compressedSize > 0;
+}
+
+// Find the image's data within a zip archive; images may be stored or
+// deflated, but not encrypted
+bool CompressedImageFile::openZip()
+{
+    QVector<ZipEntry> entries;
+    if (!readZipDirectory(&compressedFile, &entries) || entries.isEmpty()) return false;
+
+    const ZipEntry *member = &entries.first();
+    if (!memberName.isEmpty()) {
+        member = nullptr;
+        for (const ZipEntry &entry : entries) {
+            if (entry.name == memberName) member = &entry;
+        }
+        if (member == nullptr) return false;
+    }
+
+    if ((member->flags & 0x0001) || (member->method != 0 && member->method != 8)) return false;
+
+    // The data follows the member's local header, whose name and extra field
+    // lengths can differ from those in the central directory
+    QByteArray localHeader;
+    if (!readFileBytes(&compressedFile, member->localHeaderPosition, 30, &localHeader)) return false;
+    if (qFromLittleEndian<quint32>(localHeader.constData()) != 0x04034b50) return false;
+
+    dataPosition = member->localHeaderPosition + 30 + qFromLittleEndian<quint16>(localHeader.constData() + 26) +
+            qFromLittleEndian<quint16>(localHeader.constData() + 28);
+    compressedSize = member->compressedSize;
+    uncompressedSize = member->uncompressedSize;
+    storedData = (member->method == 0);
+
+    return dataPosition + compressedSize <= compressedFile.size();
+}
+
+// Read bytes from the compressed file with a single read operation (seeking
+// first only if the file is not already at the required position)
+bool CompressedImageFile::readCompressed(qint64 position, char *buffer, qint64 length)
+{
+    if (compressedFile.pos() != position && !compressedFile.seek(position)) return false;
+
+    statistics.fileReads++;
+    statistics.compressedBytesRead += length;
+    return compressedFile.read(buffer, length) == length;
+}
+
+// Decompress a range of the image.  Decompression continues from where the
+// last read finished if that is after the nearest checkpoint; otherwise it
+// restarts from the checkpoint.  Checkpoints are added as decompression moves
+// beyond the last one
+bool CompressedImageFile::inflateRange(qint64 position, char *buffer, qint64 length)
+{
+    // Find the last checkpoint at or before the position
+    auto nextCheckpoint = std::upper_bound(checkpoints.constBegin(), checkpoints.constEnd(), position,
+                                           [](qint64 value, const Checkpoint &checkpoint) {
+        return value < checkpoint.uncompressedPosition;
+    });
+    const Checkpoint &checkpoint = *(nextCheckpoint - 1);
+
+    if (!streamActive || streamOutputPosition > position || streamOutputPosition < checkpoint.uncompressedPosition) {
+        if (!restartStream(checkpoint)) return false;
+    }
+
+    qint64 endPosition = position + length;
+    while (streamOutputPosition < endPosition) {
+        if (stream.avail_in == 0) {
+            qint64 inputLength = qMin(inputBufferSize, compressedSize - streamInputPosition);
+            if (inputLength <= 0 || !readCompressed(dataPosition + streamInputPosition, streamInput.data(), inputLength)) {
+                qCDebug(lcDiscImage) << "CompressedImageFile::inflateRange(): Compressed data is truncated";
+                endStream();
+                return false;
+            }
+
+            stream.next_in = reinterpret_cast<Bytef *>(streamInput.data());
+            stream.avail_in = static_cast<uInt>(inputLength);
+            streamInputPosition += inputLength;
+        }
+
+        // The output wraps around the window, so that it always holds the last
+        // 32KB decompressed
+        if (stream.avail_out == 0) {
+            stream.next_out = reinterpret_cast<Bytef *>(streamWindow.data());
+            stream.avail_out = static_cast<uInt>(windowSize);
+        }
+
+        // Decompress up to the end of the current deflate block
+        const Bytef *output = stream.next_out;
+        int result = inflate(&stream, Z_BLOCK);
+        qint64 outputLength = stream.next_out - output;
+
+        // Copy the part of the output within the range
+        qint64 copyStart = qMax(position, streamOutputPosition);
+        qint64 copyEnd = qMin(endPosition, streamOutputPosition + outputLength);
+        if (copyEnd > copyStart)
+            memcpy(buffer + (copyStart - position), output + (copyStart - streamOutputPosition), copyEnd - copyStart);
+
+        streamOutputPosition += outputLength;
+        statistics.bytesInflated += outputLength;
+
+        if (result == Z_STREAM_END) {
+            endStream();
+            break;
+        }
+
+        if (result != Z_OK) {
+            qCDebug(lcDiscImage) << "CompressedImageFile::inflateRange(): Compressed data is invalid at byte" << streamOutputPosition;
+            endStream();
+            return false;
+        }
+
+        // Add a checkpoint every 32KB beyond the last one.  Data type bit 7 is
+        // set at the end of a block and bit 6 after the last block
+        if (streamOutputPosition > checkpoints.last().uncompressedPosition) {
+            bool blockBoundary = (stream.data_type & 128) && !(stream.data_type & 64);
+
+            // A block boundary checkpoint needs a whole window of output from
+            // this stream; until then the window holds output from before the
+            // stream was restarted
+            bool windowFilled = streamOutputPosition - streamRestartPosition >= windowSize;
+
+            if (blockBoundary && windowFilled && streamOutputPosition - lastBoundaryPosition >= checkpointSpacing) addCheckpoint();
+            else if (streamOutputPosition - checkpoints.last().uncompressedPosition >= checkpointSpacing) addSnapshot();
+        }
+    }
+
+    return streamOutputPosition >= endPosition;
+}
+
+// Start decompressing from a checkpoint.  A checkpoint can be part way through
+// a compressed byte, in which case the remaining bits of the byte are fed in
+// first; the window restores the history the following data can refer to
+bool CompressedImageFile::restartStream(const Checkpoint &checkpoint)
+{
+    endStream();
+
+    memset(&stream, 0, sizeof(stream));
+    if (!checkpoint.snapshot.isNull()) {
+        if (inflateCopy(&stream, checkpoint.snapshot.data()) != Z_OK) return false;
+        stream.avail_in = 0;
+    } else if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return false;
+    }
+    streamActive = true;
+
+    streamWindow.resize(static_cast<int>(windowSize));
+    streamInput.resize(static_cast<int>(inputBufferSize));
+    stream.next_out = reinterpret_cast<Bytef *>(streamWindow.data());
+    stream.avail_out = static_cast<uInt>(windowSize);
+    streamInputPosition = checkpoint.compressedPosition;
+    streamOutputPosition = checkpoint.uncompressedPosition;
+    streamRestartPosition = checkpoint.uncompressedPosition;
+    statistics.checkpointRestarts++;
+
+    // A copied state carries on from its compressed position as it is
+    if (!checkpoint.snapshot.isNull()) return true;
+
+    if (checkpoint.bits > 0) {
+        char partialByte;
+        if (!readCompressed(dataPosition + checkpoint.compressedPosition - 1, &partialByte, 1)) {
+            endStream();
+            return false;
+        }
+        inflatePrime(&stream, checkpoint.bits, static_cast<quint8>(partialByte) >> (8 - checkpoint.bits));
+    }
+
+    if (!checkpoint.window.isEmpty()) {
+        inflateSetDictionary(&stream, reinterpret_cast<const Bytef *>(checkpoint.window.constData()),
+                             static_cast<uInt>(checkpoint.window.size()));
+    }
+
+    return true;
+}
+
+void CompressedImageFile::endStream()
+{
+    if (!streamActive) return;
+
+    inflateEnd(&stream);
+    streamActive = false;
+}
+
+// Add a checkpoint at the current (block boundary) position of the stream
+void CompressedImageFile::addCheckpoint()
+{
+    Checkpoint checkpoint;
+    checkpoint.uncompressedPosition = streamOutputPosition;
+    checkpoint.compressedPosition = streamInputPosition - stream.avail_in;
+    checkpoint.bits = stream.data_type & 7;
+
+    // Unwrap the window, oldest output first
+    qint64 newestLength = windowSize - stream.avail_out;
+    checkpoint.window.resize(static_cast<int>(windowSize));
+    memcpy(checkpoint.window.data(), streamWindow.constData() + newestLength, windowSize - newestLength);
+    memcpy(checkpoint.window.data() + (windowSize - newestLength), streamWindow.constData(), newestLength);
+
+    checkpoints.append(checkpoint);
+    lastBoundaryPosition = checkpoint.uncompressedPosition;
+    checkpointsAdded = true;
+    statistics.checkpoints = checkpoints.size();
+}
+
+// Add a checkpoint within a deflate block by copying the decompressor state
+void CompressedImageFile::addSnapshot()
+{
+    QSharedPointer<z_stream> snapshot(new z_stream, [](z_stream *copiedStream) {
+        inflateEnd(copiedStream);
+        delete copiedStream;
+    });
+    memset(snapshot.data(), 0, sizeof(z_stream));
+    if (inflateCopy(snapshot.data(), &stream) != Z_OK) return;
+
+    Checkpoint checkpoint;
+    checkpoint.uncompressedPosition = streamOutputPosition;
+    checkpoint.compressedPosition = streamInputPosition - stream.avail_in;
+    checkpoint.bits = 0;
+    checkpoint.snapshot = snapshot;
+
+    checkpoints.append(checkpoint);
+    statistics.checkpoints = checkpoints.size();
+}
+
+// Get the index cache file for the image, keyed by the image's path (and
+// member); returns an empty string if there is no cache directory
+QString CompressedImageFile::getIndexFilename()
+{
+    QString cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+    if (cacheDirectory.isEmpty()) return QString();
+
+    QByteArray key = QFileInfo(compressedFile).absoluteFilePath().toUtf8() + "#" + memberName.toUtf8();
+    return cacheDirectory + "/OpenAcornExplorer/compressed-index/" +
+            QString::number(XxHash64::hash(key.constData(), key.size()), 16) + ".idx";
+}
+
+// Load the checkpoints saved for the image, provided that the image has not
+// changed since they were saved
+bool CompressedImageFile::loadIndex()
+{
+    QString indexFilename = getIndexFilename();
+    if (indexFilename.isEmpty()) return false;
+
+    QFile indexFile(indexFilename);
+    if (!indexFile.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream indexStream(&indexFile);
+    quint32 magic;
+    qint32 version;
+    qint64 fileSize, lastModified, indexDataPosition, indexCompressedSize, indexUncompressedSize;
+    QString indexMemberName;
+    qint32 numberOfCheckpoints;
+
+    indexStream >> magic >> version;
+    if (magic != indexMagic || version != indexVersion) return false;
+
+    indexStream >> fileSize >> lastModified >> indexMemberName >> indexDataPosition >> indexCompressedSize >>
+            indexUncompressedSize >> numberOfCheckpoints;
+    if (fileSize != compressedFile.size() ||
+            lastModified != QFileInfo(compressedFile).lastModified().toMSecsSinceEpoch() ||
+            indexMemberName != memberName || indexDataPosition != dataPosition ||
+            indexCompressedSize != compressedSize || indexUncompressedSize != uncompressedSize) return false;
+
+    QVector<Checkpoint> indexCheckpoints;
+    for (qint32 checkpointNumber = 0; checkpointNumber < numberOfCheckpoints; checkpointNumber++) {
+        Checkpoint checkpoint;
+        qint32 bits;
+        QByteArray window;
+        indexStream >> checkpoint.uncompressedPosition >> checkpoint.compressedPosition >> bits >> window;
+        checkpoint.bits = bits;
+        if (!window.isEmpty()) checkpoint.window = qUncompress(window);
+
+        // Each checkpoint must follow the previous one and have a whole window
+        // (other than the start of the image)
+        if (indexStream.status() != QDataStream::Ok) return false;
+        if (checkpointNumber == 0 && (checkpoint.uncompressedPosition != 0 || checkpoint.compressedPosition != 0)) return false;
+        if (checkpointNumber > 0 && (checkpoint.uncompressedPosition <= indexCheckpoints.last().uncompressedPosition ||
+                                     checkpoint.window.size() != windowSize || bits < 0 || bits > 7)) return false;
+
+        indexCheckpoints.append(checkpoint);
+    }
+    if (indexCheckpoints.isEmpty()) return false;
+
+    checkpoints = indexCheckpoints;
+    statistics.indexLoaded = true;
+    return true;
+}
+
+// Save the checkpoints (the windows are compressed) to the index cache
+void CompressedImageFile::saveIndex()
+{
+    QString indexFilename = getIndexFilename();
+    if (indexFilename.isEmpty() || !QDir().mkpath(QFileInfo(indexFilename).absolutePath())) return;
+
+    QSaveFile indexFile(indexFilename);
+    if (!indexFile.open(QIODevice::WriteOnly)) return;
+
+    QDataStream indexStream(&indexFile);
+    // Copies of the decompressor state cannot be saved
+    QVector<Checkpoint> boundaryCheckpoints;
+    for (const Checkpoint &checkpoint : checkpoints) {
+        if (checkpoint.snapshot.isNull()) boundaryCheckpoints.append(checkpoint);
+    }
+
+    indexStream << indexMagic << indexVersion << compressedFile.size() <<
+                   QFileInfo(compressedFile).lastModified().toMSecsSinceEpoch() << memberName << dataPosition <<
+                   compressedSize << uncompressedSize << static_cast<qint32>(boundaryCheckpoints.size());
+
+    for (const Checkpoint &checkpoint : boundaryCheckpoints) {
+        indexStream << checkpoint.uncompressedPosition << checkpoint.compressedPosition <<
+                       static_cast<qint32>(checkpoint.bits) <<
+                       (checkpoint.window.isEmpty() ? QByteArray() : qCompress(checkpoint.window));
+    }
+
+    if (!indexFile.commit()) {
+        qCDebug(lcDiscImage) << "CompressedImageFile::saveIndex(): Cannot write index" << indexFilename;
+    }
+}
@@ -0,0 +1,136 @@
+/************************************************************************
+
+    compressedimagefile.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef COMPRESSEDIMAGEFILE_H
+#define COMPRESSEDIMAGEFILE_H
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QIODevice>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+
+#include <zlib.h>
+
+// Compressed image decompression statistics
+struct CompressedImageStatistics
+{
+    qint64 checkpoints = 0;         // Number of checkpoints in the index
+    qint64 checkpointRestarts = 0;  // Number of times decompression restarted from a checkpoint
+    qint64 bytesInflated = 0;       // Number of bytes decompressed (including those skipped over)
+    qint64 compressedBytesRead = 0; // Number of bytes read from the compressed file
+    qint64 fileReads = 0;           // Number of read operations on the compressed file
+    bool indexLoaded = false;       // True if the index was loaded from the index cache
+};
+
+// Read-only random access to a disc image held in a gzip file (.gz) or in a
+// zip archive (.zip, or archive.zip#member for a particular image within it).
+// The image is decompressed as it is read; as decompression proceeds a
+// checkpoint is recorded every 32KB, so later reads restart from the nearest
+// checkpoint rather than from the start of the image.  Checkpoints at deflate
+// block boundaries (the compressed position and the preceding 32KB of output)
+// are saved in the index cache when the file is closed and reused when it is
+// next opened.  Disc images compress into few, very long blocks, so within a
+// block the decompressor state itself is copied instead (in memory only)
+class CompressedImageFile : public QIODevice
+{
+public:
+    explicit CompressedImageFile(const QString &filename);
+    ~CompressedImageFile() override;
+
+    static bool isCompressedImage(const QString &filename);
+    static QStringList getArchiveImages(const QString &archiveFilename);
+    static QIODevice *createImageDevice(const QString &filename);
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    qint64 size() const override;
+    bool isSequential() const override;
+
+    CompressedImageStatistics getStatistics() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    Q_DISABLE_COPY(CompressedImageFile)
+
+    // A point at which decompression can be restarted: the first uncompressed
+    // byte after a deflate block boundary, the compressed byte and bit at
+    // which the next block starts and the 32KB of output preceding the point.
+    // Checkpoints within a block hold a copy of the decompressor state instead
+    // of the bit and window
+    struct Checkpoint
+    {
+        qint64 uncompressedPosition;
+        qint64 compressedPosition;
+        int bits;
+        QByteArray window;
+        QSharedPointer<z_stream> snapshot;
+    };
+
+    QFile compressedFile;
+    QString memberName;
+
+    // Position and length of the compressed data within the file, and the size
+    // of the image; stored (uncompressed) zip members are read directly
+    qint64 dataPosition;
+    qint64 compressedSize;
+    qint64 uncompressedSize;
+    bool storedData;
+
+    QVector<Checkpoint> checkpoints;
+    qint64 lastBoundaryPosition;
+    bool checkpointsAdded;
+
+    // Decompression state (valid while streamActive is true)
+    z_stream stream;
+    bool streamActive;
+    qint64 streamInputPosition;
+    qint64 streamOutputPosition;
+    qint64 streamRestartPosition;
+    QByteArray streamWindow;
+    QByteArray streamInput;
+
+    CompressedImageStatistics statistics;
+
+    bool openGzip();
+    bool openZip();
+    bool readCompressed(qint64 position, char *buffer, qint64 length);
+    bool inflateRange(qint64 position, char *buffer, qint64 length);
+    bool restartStream(const Checkpoint &checkpoint);
+    void endStream();
+    void addCheckpoint();
+    void addSnapshot();
+    QString getIndexFilename();
+    bool loadIndex();
+    void saveIndex();
+};
+
+#endif // COMPRESSEDIMAGEFILE_H
@@ -0,0 +1,63 @@
+# Core disc image and file system sources
+#
+# Shared by the GUI application, the command line tool and the benchmarks;
+# nothing in here may depend on the Qt GUI or widgets modules
+
+INCLUDEPATH += $$PWD
+
+# Debug output on the hot paths (see logcategories.h) is only compiled into
+# debug builds
+CONFIG(debug, debug|release): DEFINES += OAE_HOT_PATH_LOGGING
+
+# Compressed (gzip and zip) images are read with zlib
+LIBS += -lz
+
+SOURCES += \
+    $$PWD/discimage.cpp \
+    $$PWD/compressedimagefile.cpp \
+    $$PWD/discgeometry.cpp \
+    $$PWD/discimageprober.cpp \
+    $$PWD/adfsfreespacemap.cpp \
+    $$PWD/adfsfreespaceindex.cpp \
+    $$PWD/adfsnewmap.cpp \
+    $$PWD/adfsdirectory.cpp \
+    $$PWD/discsectorcache.cpp \
+    $$PWD/adfsimage.cpp \
+    $$PWD/adfscatalogue.cpp \
+    $$PWD/adfspathindex.cpp \
+    $$PWD/adfsnameindex.cpp \
+    $$PWD/adfscataloguescanner.cpp \
+    $$PWD/adfsfileextractor.cpp \
+    $$PWD/adfsfilehasher.cpp \
+    $$PWD/adfsimagechecker.cpp \
+    $$PWD/discimagehashtree.cpp \
+    $$PWD/adfsimagecomparer.cpp \
+    $$PWD/xxhash64.cpp \
+    $$PWD/tracerecorder.cpp \
+    $$PWD/logcategories.cpp \
+    $$PWD/logringbuffer.cpp
+
+HEADERS += \
+    $$PWD/discimage.h \
+    $$PWD/compressedimagefile.h \
+    $$PWD/discgeometry.h \
+    $$PWD/discimageprober.h \
+    $$PWD/adfsfreespacemap.h \
+    $$PWD/adfsfreespaceindex.h \
+    $$PWD/adfsnewmap.h \
+    $$PWD/adfsdirectory.h \
+    $$PWD/discsectorcache.h \
+    $$PWD/adfsimage.h \
+    $$PWD/adfscatalogue.h \
+    $$PWD/adfspathindex.h \
+    $$PWD/adfsnameindex.h \
+    $$PWD/adfscataloguescanner.h \
+    $$PWD/adfsfileextractor.h \
+    $$PWD/adfsfilehasher.h \
+    $$PWD/adfsimagechecker.h \
+    $$PWD/discimagehashtree.h \
+    $$PWD/adfsimagecomparer.h \
+    $$PWD/xxhash64.h \
+    $$PWD/tracerecorder.h \
+    $$PWD/logcategories.h \
+    $$PWD/logringbuffer.h
@@ -0,0 +1,179 @@
+/************************************************************************
+
+    discgeometry.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "discgeometry.h"
+
+// Class constructor
+// Note: The sector translation for the format is selected once here, so each
+// sector access costs a single call with no run-time geometry arithmetic
+DiscGeometry::DiscGeometry(Format formatParam)
+{
+    format = formatParam;
+
+    switch (format) {
+    case AdfsS:
+        setLayout<40, 1, 16, 256, false>();
+        break;
+    case AdfsM:
+        setLayout<80, 1, 16, 256, false>();
+        break;
+    case AdfsD:
+    case AdfsE:
+    case AdfsEPlus:
+        setLayout<80, 2, 5, 1024, false>();
+        break;
+    case AdfsF:
+    case AdfsFPlus:
+        setLayout<80, 2, 10, 1024, false>();
+        break;
+    case DfsSsd40:
+        setLayout<40, 1, 10, 256, false>();
+        break;
+    case DfsSsd80:
+        setLayout<80, 1, 10, 256, false>();
+        break;
+    case DfsDsd40:
+        setLayout<40, 2, 10, 256, true>();
+        break;
+    case DfsDsd80:
+        setLayout<80, 2, 10, 256, true>();
+        break;
+    case AdfsL:
+    case UnknownFormat:
+        // Unknown images are treated as ADFS L (the original default)
+        setLayout<80, 2, 16, 256, true>();
+        break;
+    }
+}
+
+DiscGeometry::Format DiscGeometry::getFormat() const
+{
+    return format;
+}
+
+// Get the name of the format (as used by the Acorn documentation)
+QString DiscGeometry::getFormatName() const
+{
+    switch (format) {
+    case AdfsS: return "ADFS S";
+    case AdfsM: return "ADFS M";
+    case AdfsL: return "ADFS L";
+    case AdfsD: return "ADFS D";
+    case AdfsE: return "ADFS E";
+    case AdfsEPlus: return "ADFS E+";
+    case AdfsF: return "ADFS F";
+    case AdfsFPlus: return "ADFS F+";
+    case DfsSsd40: return "DFS 40 track single sided";
+    case DfsSsd80: return "DFS 80 track single sided";
+    case DfsDsd40: return "DFS 40 track double sided";
+    case DfsDsd80: return "DFS 80 track double sided";
+    case UnknownFormat: break;
+    }
+
+    return "Unknown";
+}
+
+qint64 DiscGeometry::getTracks() const
+{
+    return tracks;
+}
+
+qint64 DiscGeometry::getSides() const
+{
+    return sides;
+}
+
+qint64 DiscGeometry::getSectorsPerTrack() const
+{
+    return sectorsPerTrack;
+}
+
+qint64 DiscGeometry::getSectorSize() const
+{
+    return sectorSize;
+}
+
+bool DiscGeometry::isInterleaved() const
+{
+    return interleaved;
+}
+
+qint64 DiscGeometry::getTotalSectors() const
+{
+    return tracks * sides * sectorsPerTrack;
+}
+
+// Get the size of a complete image of the format in bytes
+qint64 DiscGeometry::getImageSize() const
+{
+    return getTotalSectors() * sectorSize;
+}
+
+DiscGeometry::SectorTranslator DiscGeometry::getSectorTranslator() const
+{
+    return sectorTranslator;
+}
+
+DiscGeometry::ContiguousSectorCounter DiscGeometry::getContiguousSectorCounter() const
+{
+    return contiguousSectorCounter;
+}
+
+// Guess the format of an image from its size alone
+// Note: Sizes shared by more than one format give the most common of them
+// (800K is D/E/E+, 1600K is F/F+ and 200K is also a 40 track DSD)
+DiscGeometry::Format DiscGeometry::getFormatForImageSize(qint64 imageSize)
+{
+    switch (imageSize) {
+    case 163840: return AdfsS;
+    case 327680: return AdfsM;
+    case 655360: return AdfsL;
+    case 819200: return AdfsE;
+    case 1638400: return AdfsF;
+    case 102400: return DfsSsd40;
+    case 204800: return DfsSsd80;
+    case 409600: return DfsDsd80;
+    }
+
+    return UnknownFormat;
+}
+
+// Private methods
+
+// Set the geometry and select the sector translation for it
+template <quint64 Tracks, quint64 Sides, quint64 SectorsPerTrack, quint64 SectorSize, bool Interleaved>
+void DiscGeometry::setLayout()
+{
+    tracks = Tracks;
+    sides = Sides;
+    sectorsPerTrack = SectorsPerTrack;
+    sectorSize = SectorSize;
+    interleaved = Interleaved;
+
+    sectorTranslator = &DiscSectorLayout<Tracks, SectorsPerTrack, SectorSize, Interleaved>::translateSectorToByte;
+    contiguousSectorCounter = &DiscSectorLayout<Tracks, SectorsPerTrack, SectorSize, Interleaved>::getContiguousSectors;
+}
@@ -0,0 +1,130 @@
+/************************************************************************
+
+    discgeometry.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef DISCGEOMETRY_H
+#define DISCGEOMETRY_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QMetaType>
+
+// Translation of logical sector numbers to byte positions in a disc image file
+// for a specific disc layout.  The geometry is a template parameter, so the
+// divisions and modulos reduce to shifts and masks for power-of-two layouts
+// (and to multiplications by a constant for the others)
+//
+// Interleaved (.adl and .dsd) images store the tracks of both sides alternately
+// (side 0 track 0, side 1 track 0, side 0 track 1...) whilst the logical sectors
+// run through all of side 0 before side 1; other images are stored in logical
+// sector order
+template <quint64 Tracks, quint64 SectorsPerTrack, quint64 SectorSize, bool Interleaved>
+struct DiscSectorLayout
+{
+    static qint64 translateSectorToByte(qint64 sector)
+    {
+        if (sector < 0) return -1;
+        quint64 logicalSector = static_cast<quint64>(sector);
+
+        if (!Interleaved) return static_cast<qint64>(logicalSector * SectorSize);
+
+        quint64 side = logicalSector / (Tracks * SectorsPerTrack);
+        quint64 sideSector = logicalSector % (Tracks * SectorsPerTrack);
+        quint64 track = sideSector / SectorsPerTrack;
+        quint64 trackSector = sideSector % SectorsPerTrack;
+
+        return static_cast<qint64>((((track * 2) + side) * SectorsPerTrack + trackSector) * SectorSize);
+    }
+
+    // Count the sectors (from the start sector) that are physically contiguous
+    static qint64 getContiguousSectors(qint64 startSector, qint64 numberOfSectors)
+    {
+        if (!Interleaved || startSector < 0) return numberOfSectors;
+
+        // Consecutive tracks of an interleaved image are never adjacent
+        qint64 runLength = static_cast<qint64>(SectorsPerTrack - (static_cast<quint64>(startSector) % SectorsPerTrack));
+        return qMin(runLength, numberOfSectors);
+    }
+};
+
+// Describes the physical layout of each supported disc image format
+class DiscGeometry
+{
+public:
+    enum Format {
+        UnknownFormat,
+        AdfsS,          // 160K single sided (40 tracks)
+        AdfsM,          // 320K single sided (80 tracks)
+        AdfsL,          // 640K double sided, interleaved
+        AdfsD,          // 800K double sided, 1024 byte sectors
+        AdfsE,          // 800K as D, new map
+        AdfsEPlus,      // 800K as E, big directories
+        AdfsF,          // 1600K double sided, 1024 byte sectors, new map
+        AdfsFPlus,      // 1600K as F, big directories
+        DfsSsd40,       // 100K single sided (40 tracks)
+        DfsSsd80,       // 200K single sided (80 tracks)
+        DfsDsd40,       // 200K double sided (40 tracks), interleaved
+        DfsDsd80        // 400K double sided (80 tracks), interleaved
+    };
+
+    typedef qint64 (*SectorTranslator)(qint64 sector);
+    typedef qint64 (*ContiguousSectorCounter)(qint64 startSector, qint64 numberOfSectors);
+
+    DiscGeometry(Format formatParam = AdfsL);
+
+    Format getFormat() const;
+    QString getFormatName() const;
+    qint64 getTracks() const;
+    qint64 getSides() const;
+    qint64 getSectorsPerTrack() const;
+    qint64 getSectorSize() const;
+    bool isInterleaved() const;
+    qint64 getTotalSectors() const;
+    qint64 getImageSize() const;
+
+    SectorTranslator getSectorTranslator() const;
+    ContiguousSectorCounter getContiguousSectorCounter() const;
+
+    static Format getFormatForImageSize(qint64 imageSize);
+
+private:
+    Format format;
+    qint64 tracks;
+    qint64 sides;
+    qint64 sectorsPerTrack;
+    qint64 sectorSize;
+    bool interleaved;
+
+    SectorTranslator sectorTranslator;
+    ContiguousSectorCounter contiguousSectorCounter;
+
+    template <quint64 Tracks, quint64 Sides, quint64 SectorsPerTrack, quint64 SectorSize, bool Interleaved>
+    void setLayout();
+};
+
+Q_DECLARE_METATYPE(DiscGeometry::Format)
+
+#endif // DISCGEOMETRY_H
@@ -25,38 +25,53 @@
 ************************************************************************/
 
 #include "discimage.h"
+#include "logcategories.h"
+#include "tracerecorder.h"
+
+#include <QSaveFile>
 
 // Class constructor
-DiscImage::DiscImage(QString filename)
+// Note: If the format is not specified it is guessed from the size of the image
+// (images of an unrecognised size are treated as ADFS L)
+DiscImage::DiscImage(QString filename, AccessMode accessModeParam, DiscGeometry::Format formatParam)
 {
-    // Set the default image attributes (ADFS L format only!)
-    tracks = 80; // Tracks per side/head
-    sides = 2; // Number of sides/heads
-    sectorsPerTrack = 16; // Number of sectors per track
-    sectorSize = 256;
-    startSector = 0; // Number of first sector
+    setGeometry(formatParam);
 
     // Open the file
     discImageOpen = false;
+    discImageReadOnly = false;
+    mapRequested = (accessModeParam == MappedAccess);
+    mappedImage = nullptr;
+    mappedImageSize = 0;
+    sectorCache = nullptr;
+    numberOfModifiedSectors.store(0);
     discImageFile = new QFile(filename);
 
-    if (!discImageFile->open(QIODevice::ReadWrite)) {
-        qDebug() << "DiscImage::DiscImage(): Failed to open disc image file";
-    }
+    // Compressed images are read through a decompressing device
+    compressedImage = nullptr;
+    if (CompressedImageFile::isCompressedImage(filename)) compressedImage = new CompressedImageFile(filename);
 
-    // Disc image file opened successfully
-    discImageOpen = true;
+    if (!openImageFile()) return;
+
+    if (formatParam == DiscGeometry::UnknownFormat) {
+        setGeometry(DiscGeometry::getFormatForImageSize(getImageSize()));
+        if (geometry.getFormat() == DiscGeometry::UnknownFormat)
+            qCDebug(lcDiscImage) << "DiscImage::DiscImage(): Image size is not recognised - assuming ADFS L";
+    }
 }
 
 // Class destructor
+// Note: Modified sectors that have not been committed are discarded
 DiscImage::~DiscImage()
 {
-    // Is there an open file?
-    if (discImageOpen) {
-        qDebug() << "DiscImage::~DiscImage(): Closing disc image file";
-        discImageOpen = false;
-        discImageFile->close();
-    }
+    if (!modifiedSectors.isEmpty())
+        qCDebugHotPath(lcDiscImage) << "DiscImage::~DiscImage(): Discarding" << modifiedSectors.size() << "uncommitted sectors";
+
+    closeImageFile();
+
+    delete sectorCache;
+    delete compressedImage;
+    delete discImageFile;
 }
 
 // Read a single sector from a disc image
@@ -67,23 +82,13 @@ QByteArray DiscImage::readSector(qint64 sectorNumber)
 
     // Check that a disc image has been successfully opened
     if (!discImageOpen) {
-        qDebug() << "DiscImage::readSector(S): Disc image is not open!";
+        qCDebug(lcDiscImage) << "DiscImage::readSector(S): Disc image is not open!";
         return sectorData; // Returns an empty sector
     }
 
-    // Seek to the required sector
-    if (!discImageFile->seek(translateSectorToByte(sectorNumber))) {
-        // Seek operation failed...
-        qDebug() << "DiscImage::readSector(S): Could not seek to sector" << sectorNumber;
-        return sectorData; // Returns an empty sector
-    }
-
-    qint64 bytesRead = 0;
-    bytesRead = discImageFile->read(sectorData.data(), sectorSize);
-
-    // Was read operation successful?
-    if (bytesRead == -1) {
-        qDebug() << "DiscImage::readSector(S): Could not read sector" << sectorNumber;
+    // Read the sector into the buffer
+    if (!readSectorRuns(sectorNumber, 1, sectorData.data())) {
+        qCDebug(lcDiscImage) << "DiscImage::readSector(S): Could not read sector" << sectorNumber;
     }
 
     return sectorData;
@@ -96,18 +101,211 @@ QByteArray DiscImage::readSector(qint64 startSectorNumber, qint64 numberOfSector
 
     // Check that a disc image has been successfully opened
     if (!discImageOpen) {
-        qDebug() << "DiscImage::readSector(M): Disc image is not open!";
+        qCDebug(lcDiscImage) << "DiscImage::readSector(M): Disc image is not open!";
         return sectorData; // Returns an empty sector
     }
 
-    // Read the required sectors from the disc image
-    for (qint64 sectorOffset = 0; sectorOffset < numberOfSectors; sectorOffset++) {
-        sectorData.append(readSector(startSectorNumber + sectorOffset));
+    // Read the required sectors from the disc image into a single buffer
+    sectorData.resize(numberOfSectors * sectorSize);
+    if (!readSectorRuns(startSectorNumber, numberOfSectors, sectorData.data())) {
+        qCDebug(lcDiscImage) << "DiscImage::readSector(M): Could not read sectors" << startSectorNumber <<
+                    "to" << startSectorNumber + numberOfSectors - 1;
     }
 
     return sectorData;
 }
 
+// Read multiple sectors from a disc image into a caller supplied buffer
+// Note: The buffer must hold numberOfSectors * getSectorSize() bytes
+bool DiscImage::readSector(qint64 startSectorNumber, qint64 numberOfSectors, char *buffer)
+{
+    // Check that a disc image has been successfully opened
+    if (!discImageOpen) {
+        qCDebug(lcDiscImage) << "DiscImage::readSector(B): Disc image is not open!";
+        return false;
+    }
+
+    if (!readSectorRuns(startSectorNumber, numberOfSectors, buffer)) {
+        qCDebug(lcDiscImage) << "DiscImage::readSector(B): Could not read sectors" << startSectorNumber <<
+                    "to" << startSectorNumber + numberOfSectors - 1;
+        return false;
+    }
+
+    return true;
+}
+
+// Read bytes from a disc image by their position on the disc (the sector number
+// multiplied by the sector size, plus the offset within the sector) into a
+// caller supplied buffer.  File systems that address the disc in units other
+// than the image's sectors (old map D format, new map fragments) read this way
+bool DiscImage::readBytes(qint64 discBytePosition, qint64 length, char *buffer)
+{
+    if (discBytePosition < 0 || length < 0) {
+        qCDebug(lcDiscImage) << "DiscImage::readBytes(): Invalid byte range" << discBytePosition << "length" << length;
+        return false;
+    }
+    if (length == 0) return true;
+
+    qint64 startSectorNumber = discBytePosition / sectorSize;
+    qint64 sectorOffset = discBytePosition % sectorSize;
+    qint64 numberOfSectors = (sectorOffset + length + sectorSize - 1) / sectorSize;
+
+    // Whole sectors are read directly into the buffer
+    if (sectorOffset == 0 && (length % sectorSize) == 0) return readSector(startSectorNumber, numberOfSectors, buffer);
+
+    QByteArray sectorData(static_cast<int>(numberOfSectors * sectorSize), 0);
+    if (!readSector(startSectorNumber, numberOfSectors, sectorData.data())) return false;
+    memcpy(buffer, sectorData.constData() + sectorOffset, length);
+
+    return true;
+}
+
+// Write a single sector to a disc image
+// Note: The sector is held in memory until commit() is called
+bool DiscImage::writeSector(qint64 sectorNumber, const QByteArray &sectorData)
+{
+    if (sectorData.size() != sectorSize) {
+        qCDebug(lcDiscImage) << "DiscImage::writeSector(S): Sector data is" << sectorData.size() << "bytes, expected" << sectorSize;
+        return false;
+    }
+
+    return writeSector(sectorNumber, 1, sectorData.constData());
+}
+
+// Write multiple sectors to a disc image
+// Note: The sectors are held in memory until commit() is called; writing a
+// sector again before committing simply replaces the pending data
+bool DiscImage::writeSector(qint64 startSectorNumber, qint64 numberOfSectors, const char *buffer)
+{
+    QMutexLocker locker(&ioMutex);
+
+    if (!discImageOpen || discImageReadOnly) {
+        qCDebug(lcDiscImage) << "DiscImage::writeSector(M): Disc image is not open for writing!";
+        return false;
+    }
+
+    // Check all of the sectors before modifying any of them
+    for (qint64 sector = 0; sector < numberOfSectors; sector++) {
+        qint64 bytePosition = translateSectorToByte(startSectorNumber + sector);
+
+        if (bytePosition < 0 || bytePosition + sectorSize > getImageSize()) {
+            qCDebug(lcDiscImage) << "DiscImage::writeSector(M): Sector" << startSectorNumber + sector << "is outside of the disc image";
+            return false;
+        }
+    }
+
+    for (qint64 sector = 0; sector < numberOfSectors; sector++) {
+        qint64 bytePosition = translateSectorToByte(startSectorNumber + sector);
+        modifiedSectors.insert(bytePosition, QByteArray(buffer + (sector * sectorSize), static_cast<int>(sectorSize)));
+    }
+    numberOfModifiedSectors.store(modifiedSectors.size());
+
+    return true;
+}
+
+// Write the modified sectors to the disc image file
+bool DiscImage::commit(CommitMode commitMode)
+{
+    QMutexLocker locker(&ioMutex);
+
+    if (modifiedSectors.isEmpty()) return true;
+
+    if (!discImageOpen || discImageReadOnly) {
+        qCDebug(lcDiscImage) << "DiscImage::commit(): Disc image is not open for writing!";
+        return false;
+    }
+
+    bool committed = (commitMode == SafeCommit) ? commitSafely() : commitInPlace();
+    if (!committed) return false;
+
+    modifiedSectors.clear();
+    numberOfModifiedSectors.store(0);
+
+    return true;
+}
+
+// Discard the modified sectors without writing them
+void DiscImage::discardChanges()
+{
+    QMutexLocker locker(&ioMutex);
+
+    modifiedSectors.clear();
+    numberOfModifiedSectors.store(0);
+}
+
+// Determine if there are modified sectors waiting to be committed
+bool DiscImage::isModified()
+{
+    return numberOfModifiedSectors.load() != 0;
+}
+
+qint64 DiscImage::getNumberOfModifiedSectors()
+{
+    return numberOfModifiedSectors.load();
+}
+
+// Get a view of a single sector within a mapped disc image
+// Note: Returns a null view if the image is not mapped
+DiscSectorView DiscImage::getSectorView(qint64 sectorNumber)
+{
+    return getSectorView(sectorNumber, 1);
+}
+
+// Get a view of multiple sectors within a mapped disc image
+// Note: Returns a null view if the image is not mapped, if the sectors are not
+// physically contiguous in the image (i.e. the range crosses an interleaved track)
+// or if any of the sectors have been modified but not committed.  A safe commit
+// unmaps the image, so views must not be used across a commit
+DiscSectorView DiscImage::getSectorView(qint64 startSectorNumber, qint64 numberOfSectors)
+{
+    // The mapping can be replaced by a commit on another thread
+    QMutexLocker locker(&ioMutex);
+
+    if (mappedImage == nullptr || numberOfSectors < 1) return DiscSectorView();
+
+    // Modified sectors are only in memory until committed, so must be read
+    if (numberOfModifiedSectors.load() != 0 && hasModifiedSectors(translateSectorToByte(startSectorNumber), numberOfSectors * sectorSize))
+        return DiscSectorView();
+
+    // Are the sectors contiguous in the image?
+    if (getContiguousSectors(startSectorNumber, numberOfSectors) != numberOfSectors) return DiscSectorView();
+
+    qint64 startBytePosition = translateSectorToByte(startSectorNumber);
+    if (!isSectorInImage(startBytePosition, numberOfSectors)) {
+        qCDebug(lcDiscImage) << "DiscImage::getSectorView(): Sectors are outside of the disc image";
+        return DiscSectorView();
+    }
+
+    return DiscSectorView(mappedImage + startBytePosition, numberOfSectors * sectorSize);
+}
+
+// Get a view of bytes within a mapped disc image by their position on the disc
+// Note: Returns a null view under the same conditions as getSectorView()
+DiscSectorView DiscImage::getByteView(qint64 discBytePosition, qint64 length)
+{
+    if (discBytePosition < 0 || length < 1) return DiscSectorView();
+
+    qint64 sectorOffset = discBytePosition % sectorSize;
+    DiscSectorView sectorView = getSectorView(discBytePosition / sectorSize, (sectorOffset + length + sectorSize - 1) / sectorSize);
+    if (sectorView.isNull()) return sectorView;
+
+    return DiscSectorView(sectorView.data() + sectorOffset, length);
+}
+
+// Get the disc image I/O statistics
+DiscImageIoStatistics DiscImage::getIoStatistics()
+{
+    QMutexLocker locker(&ioMutex);
+    return ioStatistics;
+}
+
+// Reset the disc image I/O statistics
+void DiscImage::resetIoStatistics()
+{
+    QMutexLocker locker(&ioMutex);
+    ioStatistics = DiscImageIoStatistics();
+}
+
 // Get and set methods
 
 // Get the current sector size
@@ -116,6 +314,12 @@ qint64 DiscImage::getSectorSize()
     return sectorSize;
 }
 
+// Get the disc geometry of the image
+DiscGeometry DiscImage::getGeometry()
+{
+    return geometry;
+}
+
 // Determine if the disc image is valid
 bool DiscImage::isValid()
 {
@@ -124,19 +328,408 @@ bool DiscImage::isValid()
     return true;
 }
 
+// Determine if the disc image could only be opened for reading
+bool DiscImage::isReadOnly()
+{
+    return discImageReadOnly;
+}
+
+// Determine if the disc image is compressed (and so can only be read)
+bool DiscImage::isCompressed()
+{
+    return compressedImage != nullptr;
+}
+
+// Determine if the disc image is memory mapped
+bool DiscImage::isMapped()
+{
+    QMutexLocker locker(&ioMutex);
+    return mappedImage != nullptr;
+}
+
+// Set the sector cache byte budget for this image (0 disables the cache)
+// Note: The cache only applies to file access; mapped images are read directly
+// from memory and are already cached by the operating system
+void DiscImage::setCacheSize(qint64 maximumBytes)
+{
+    QMutexLocker locker(&ioMutex);
+
+    if (maximumBytes <= 0) {
+        delete sectorCache;
+        sectorCache = nullptr;
+        return;
+    }
+
+    // The cache must hold at least one whole track
+    qint64 trackSize = sectorsPerTrack * sectorSize;
+    if (maximumBytes < trackSize) maximumBytes = trackSize;
+
+    if (sectorCache == nullptr) sectorCache = new DiscSectorCache(trackSize, maximumBytes);
+    else sectorCache->setMaximumBytes(maximumBytes);
+}
+
+// Get the sector cache statistics (all zero if the cache is disabled)
+DiscSectorCacheStatistics DiscImage::getCacheStatistics()
+{
+    QMutexLocker locker(&ioMutex);
+    if (sectorCache == nullptr) return DiscSectorCacheStatistics();
+
+    return sectorCache->getStatistics();
+}
+
+// Discard the contents of the sector cache
+void DiscImage::clearCache()
+{
+    QMutexLocker locker(&ioMutex);
+    if (sectorCache != nullptr) sectorCache->clear();
+}
+
 // Private methods ----------------------------------------------------------------------------------------------------
 
-// Translate a sector number to a byte position
-qint64 DiscImage::translateSectorToByte(qint64 sector)
+// Set the disc geometry and the sector translation for it
+void DiscImage::setGeometry(DiscGeometry::Format format)
+{
+    geometry = DiscGeometry(format);
+    sectorsPerTrack = geometry.getSectorsPerTrack();
+    sectorSize = geometry.getSectorSize();
+    sectorTranslator = geometry.getSectorTranslator();
+    contiguousSectorCounter = geometry.getContiguousSectorCounter();
+}
+
+// Read sectors into the supplied buffer using one operation per physically
+// contiguous run of sectors
+// Note: Reads are serialised so that a disc image can be shared between threads
+// (sector views of a mapped image do not need the lock)
+bool DiscImage::readSectorRuns(qint64 startSectorNumber, qint64 numberOfSectors, char *buffer)
+{
+    // The traced latency includes waiting for other threads' reads
+    TraceScope trace("io", "DiscImage::read");
+    trace.setSector(startSectorNumber);
+    if (TraceRecorder::isEnabled()) trace.setBytePosition(translateSectorToByte(startSectorNumber));
+    trace.setBytes(numberOfSectors * sectorSize);
+
+    QMutexLocker locker(&ioMutex);
+    bool readSuccessful = true;
+
+    ioStatistics.readRequests++;
+    ioStatistics.sectorsRequested += numberOfSectors;
+
+    qint64 sectorOffset = 0;
+    while (sectorOffset < numberOfSectors) {
+        // Get the next physical run of sectors
+        qint64 runLength = getContiguousSectors(startSectorNumber + sectorOffset, numberOfSectors - sectorOffset);
+        qint64 bytePosition = translateSectorToByte(startSectorNumber + sectorOffset);
+        qint64 runBytes = runLength * sectorSize;
+        char *runBuffer = buffer + (sectorOffset * sectorSize);
+
+        ioStatistics.sectorRuns++;
+
+        if (mappedImage != nullptr) {
+            // Copy the run directly from the mapped image (no seek or read required)
+            if (!isSectorInImage(bytePosition, runLength)) {
+                readSuccessful = false;
+                break;
+            }
+
+            memcpy(runBuffer, mappedImage + bytePosition, runBytes);
+            ioStatistics.systemCallsSaved += 2 * runLength;
+        } else {
+            // Read the run from the file (or sector cache) in as few operations as possible
+            qint64 systemCallsBefore = ioStatistics.systemCalls;
+            bool runRead = (sectorCache != nullptr) ? readCachedRun(bytePosition, runBuffer, runBytes)
+                                                    : readFile(bytePosition, runBuffer, runBytes);
+            ioStatistics.systemCallsSaved += (2 * runLength) - (ioStatistics.systemCalls - systemCallsBefore);
+
+            if (!runRead) {
+                readSuccessful = false;
+                break;
+            }
+        }
+
+        // Reads always see modified sectors, whether committed or not
+        if (!modifiedSectors.isEmpty()) overlayModifiedSectors(bytePosition, runBuffer, runBytes);
+
+        ioStatistics.sectorsRead += runLength;
+        ioStatistics.bytesRead += runBytes;
+        sectorOffset += runLength;
+    }
+
+    return readSuccessful;
+}
+
+// Get the size of the image (uncompressed, if the image is compressed)
+qint64 DiscImage::getImageSize()
+{
+    if (compressedImage != nullptr) return compressedImage->size();
+
+    return discImageFile->size();
+}
+
+// Read bytes from the image file with a single read operation (seeking first
+// only if the file is not already at the required position)
+// Note: Compressed images count the reads made on the compressed file
+bool DiscImage::readFile(qint64 bytePosition, char *buffer, qint64 length)
+{
+    if (compressedImage != nullptr) {
+        qint64 fileReadsBefore = compressedImage->getStatistics().fileReads;
+        bool dataRead = compressedImage->seek(bytePosition) && compressedImage->read(buffer, length) == length;
+        ioStatistics.systemCalls += compressedImage->getStatistics().fileReads - fileReadsBefore;
+
+        return dataRead;
+    }
+
+    if (discImageFile->pos() != bytePosition) {
+        ioStatistics.systemCalls++;
+        if (!discImageFile->seek(bytePosition)) return false;
+    }
+
+    ioStatistics.systemCalls++;
+    return discImageFile->read(buffer, length) == length;
+}
+
+// Read a physically contiguous run of bytes via the sector cache.  Cached tracks are
+// copied from the cache; the first missing track and all tracks after it in the run
+// are filled from the file with a single read and added to the cache
+// Note: The fill stops at the end of the image, so an image truncated part way
+// through a track can still be read (the partial track is not cached)
+bool DiscImage::readCachedRun(qint64 bytePosition, char *buffer, qint64 length)
+{
+    qint64 trackSize = sectorCache->getTrackSize();
+    qint64 firstTrack = bytePosition / trackSize;
+    qint64 lastTrack = (bytePosition + length - 1) / trackSize;
+
+    qint64 trackNumber = firstTrack;
+    QByteArray *track = nullptr;
+
+    // Copy from the cached tracks until a track is missing
+    while (trackNumber <= lastTrack) {
+        track = sectorCache->getTrack(trackNumber);
+        if (track == nullptr) break;
+
+        copyTrackData(*track, trackNumber * trackSize, bytePosition, buffer, length);
+        trackNumber++;
+    }
+
+    if (trackNumber > lastTrack) return true;
+
+    // Fill the remaining tracks from the image
+    qint64 fillStart = trackNumber * trackSize;
+    qint64 fillEnd = qMin((lastTrack + 1) * trackSize, getImageSize());
+    if (fillEnd < bytePosition + length) return false;
+
+    QByteArray trackData;
+    trackData.resize(fillEnd - fillStart);
+    if (!readFile(fillStart, trackData.data(), trackData.size())) return false;
+
+    for (qint64 fillTrack = trackNumber; fillTrack <= lastTrack; fillTrack++) {
+        QByteArray fillData = trackData.mid((fillTrack - trackNumber) * trackSize, trackSize);
+
+        copyTrackData(fillData, fillTrack * trackSize, bytePosition, buffer, length);
+        if (fillData.size() == trackSize) sectorCache->insertTrack(fillTrack, fillData);
+    }
+
+    return true;
+}
+
+// Copy the part of a track that overlaps the requested byte range into the buffer
+void DiscImage::copyTrackData(const QByteArray &trackData, qint64 trackPosition, qint64 bytePosition, char *buffer, qint64 length)
+{
+    qint64 copyStart = qMax(bytePosition, trackPosition);
+    qint64 copyEnd = qMin(bytePosition + length, trackPosition + trackData.size());
+
+    if (copyEnd > copyStart)
+        memcpy(buffer + (copyStart - bytePosition), trackData.constData() + (copyStart - trackPosition), copyEnd - copyStart);
+}
+
+// Check that the required sectors (starting at the given byte position) are
+// within the mapped disc image
+bool DiscImage::isSectorInImage(qint64 bytePosition, qint64 numberOfSectors)
+{
+    if (bytePosition < 0) return false;
+    if (bytePosition + (numberOfSectors * sectorSize) > mappedImageSize) return false;
+
+    return true;
+}
+
+// Write bytes to the image file with a single write operation (seeking first
+// only if the file is not already at the required position)
+bool DiscImage::writeFile(qint64 bytePosition, const char *buffer, qint64 length)
+{
+    if (discImageFile->pos() != bytePosition) {
+        ioStatistics.systemCalls++;
+        if (!discImageFile->seek(bytePosition)) return false;
+    }
+
+    ioStatistics.systemCalls++;
+    return discImageFile->write(buffer, length) == length;
+}
+
+// Copy any modified sectors within the byte range over the data read from the image
+void DiscImage::overlayModifiedSectors(qint64 bytePosition, char *buffer, qint64 length)
+{
+    QMap<qint64, QByteArray>::const_iterator i = modifiedSectors.lowerBound(bytePosition);
+
+    for (; i != modifiedSectors.constEnd() && i.key() < bytePosition + length; ++i) {
+        memcpy(buffer + (i.key() - bytePosition), i.value().constData(), sectorSize);
+    }
+}
+
+// Determine if any sectors within the byte range have been modified
+// Note: The I/O mutex must be held
+bool DiscImage::hasModifiedSectors(qint64 bytePosition, qint64 length)
+{
+    QMap<qint64, QByteArray>::const_iterator i = modifiedSectors.lowerBound(bytePosition);
+    return i != modifiedSectors.constEnd() && i.key() < bytePosition + length;
+}
+
+// Write the modified sectors in file order, coalescing physically adjacent
+// sectors into a single write
+bool DiscImage::commitInPlace()
+{
+    QByteArray runData;
+    qint64 runStart = -1;
+
+    QMap<qint64, QByteArray>::const_iterator i = modifiedSectors.constBegin();
+    while (true) {
+        bool endOfRun = (i == modifiedSectors.constEnd()) || (runStart >= 0 && i.key() != runStart + runData.size());
+
+        // Write the completed run
+        if (endOfRun && runStart >= 0) {
+            if (!writeFile(runStart, runData.constData(), runData.size())) {
+                qCDebug(lcDiscImage) << "DiscImage::commitInPlace(): Failed to write to the disc image file at byte" << runStart;
+                return false;
+            }
+
+            if (sectorCache != nullptr) sectorCache->updateData(runStart, runData.constData(), runData.size());
+
+            ioStatistics.writeRuns++;
+            ioStatistics.sectorsWritten += runData.size() / sectorSize;
+            ioStatistics.bytesWritten += runData.size();
+
+            runData.clear();
+            runStart = -1;
+        }
+
+        if (i == modifiedSectors.constEnd()) break;
+
+        if (runStart < 0) runStart = i.key();
+        runData.append(i.value());
+        ++i;
+    }
+
+    // A mapped image shares the file's pages, so already sees the new data
+    return discImageFile->flush();
+}
+
+// Write a complete copy of the image (including the modified sectors) to a
+// temporary file and replace the original with it.  The original is unmapped and
+// closed first (an open file cannot be replaced on Windows, and elsewhere the old
+// mapping would go on showing the old file), then reopened whether or not it was
+// replaced.  Once the new image is in place the modified sectors are cleared,
+// even if the image cannot then be reopened
+// Note: This always rewrites the whole image
+bool DiscImage::commitSafely()
 {
-    // Which disc side is the required sector on?
-    qint64 side = sector / (tracks * sectorsPerTrack);
+    // Read the whole of the current image
+    QByteArray imageData;
+    imageData.resize(static_cast<int>(discImageFile->size()));
+
+    if (mappedImage != nullptr) memcpy(imageData.data(), mappedImage, imageData.size());
+    else if (!readFile(0, imageData.data(), imageData.size())) {
+        qCDebug(lcDiscImage) << "DiscImage::commitSafely(): Failed to read the disc image file";
+        return false;
+    }
+
+    overlayModifiedSectors(0, imageData.data(), imageData.size());
+
+    closeImageFile();
+
+    // Write the new image and replace the original
+    QSaveFile saveFile(discImageFile->fileName());
+    bool committed = saveFile.open(QIODevice::WriteOnly) && saveFile.write(imageData) == imageData.size() && saveFile.commit();
+
+    if (committed) {
+        ioStatistics.systemCalls++;
+        ioStatistics.writeRuns++;
+        ioStatistics.sectorsWritten += imageData.size() / sectorSize;
+        ioStatistics.bytesWritten += imageData.size();
 
-    // Calculate the actual byte location in the file, compensating
-    // for track interleave on a double-sided disc image
-    qint64 imageOffset = (sector % sectorsPerTrack) +
-            (2 * sectorsPerTrack * (sector / sectorsPerTrack)) +
-            (sectorsPerTrack * side);
+        modifiedSectors.clear();
+        numberOfModifiedSectors.store(0);
+        if (sectorCache != nullptr) sectorCache->clear();
+    } else {
+        qCDebug(lcDiscImage) << "DiscImage::commitSafely(): Failed to write the disc image file -" << saveFile.errorString();
+    }
+
+    if (!openImageFile())
+        qCDebug(lcDiscImage) << "DiscImage::commitSafely(): Failed to reopen the disc image file";
+
+    return committed;
+}
+
+// Open (and, if requested, map) the disc image file
+// Note: Reads are coalesced into physical runs by the class, so the file is
+// opened unbuffered to ensure each run costs a single read operation
+bool DiscImage::openImageFile()
+{
+    // Compressed images are only ever read (and are not mapped)
+    if (compressedImage != nullptr) {
+        if (!compressedImage->open(QIODevice::ReadOnly)) {
+            qCDebug(lcDiscImage) << "DiscImage::openImageFile(): Failed to open compressed disc image file";
+            return false;
+        }
+
+        discImageReadOnly = true;
+        discImageOpen = true;
+        return true;
+    }
+
+    discImageReadOnly = false;
+    if (!discImageFile->open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+        // Images can still be read without write permission
+        if (!discImageFile->open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+            qCDebug(lcDiscImage) << "DiscImage::openImageFile(): Failed to open disc image file";
+            return false;
+        }
+        discImageReadOnly = true;
+    }
+
+    // Disc image file opened successfully
+    discImageOpen = true;
+
+    // Map the whole image into memory if requested
+    if (mapRequested && discImageFile->size() > 0) {
+        mappedImage = discImageFile->map(0, discImageFile->size());
+
+        if (mappedImage != nullptr) {
+            mappedImageSize = discImageFile->size();
+        } else {
+            qCDebug(lcDiscImage) << "DiscImage::openImageFile(): Failed to map disc image file - using file access";
+        }
+    }
+
+    return true;
+}
+
+// Unmap and close the disc image file
+void DiscImage::closeImageFile()
+{
+    // Is there an open file?
+    if (!discImageOpen) return;
+
+    qCDebugHotPath(lcDiscImage) << "DiscImage::closeImageFile(): Closing disc image file";
+    discImageOpen = false;
+
+    if (compressedImage != nullptr) {
+        compressedImage->close();
+        return;
+    }
+
+    if (mappedImage != nullptr) {
+        discImageFile->unmap(mappedImage);
+        mappedImage = nullptr;
+        mappedImageSize = 0;
+    }
 
-    return imageOffset * sectorSize;
+    discImageFile->close();
 }
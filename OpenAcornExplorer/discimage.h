@@ -27,34 +27,158 @@
 #ifndef DISCIMAGE_H
 #define DISCIMAGE_H
 
-#include <QApplication>
+#include <QCoreApplication>
 #include <QDebug>
 #include <QFile>
+#include <QMutex>
+#include <QMap>
+#include <QAtomicInt>
+
+#include "compressedimagefile.h"
+#include "discsectorcache.h"
+#include "discgeometry.h"
+
+// Lightweight non-owning view of sector data within a memory-mapped disc image.
+// The view is only valid whilst the DiscImage that created it remains open, and
+// until its modified sectors are committed (a safe commit remaps the image)
+class DiscSectorView
+{
+public:
+    DiscSectorView() : viewData(nullptr), viewSize(0) {}
+    DiscSectorView(const uchar *viewDataParam, qint64 viewSizeParam) : viewData(viewDataParam), viewSize(viewSizeParam) {}
+
+    const uchar *data() const { return viewData; }
+    qint64 size() const { return viewSize; }
+    bool isNull() const { return viewData == nullptr; }
+    quint8 at(qint64 position) const { return viewData[position]; }
+
+    // Wrap the view in a QByteArray without copying (valid only as long as the view is)
+    QByteArray toRawByteArray() const { return QByteArray::fromRawData(reinterpret_cast<const char *>(viewData), static_cast<int>(viewSize)); }
+
+private:
+    const uchar *viewData;
+    qint64 viewSize;
+};
+
+// Disc image I/O statistics
+struct DiscImageIoStatistics
+{
+    qint64 readRequests = 0;        // Number of read requests made to the disc image
+    qint64 sectorsRequested = 0;    // Number of sectors requested
+    qint64 sectorsRead = 0;         // Number of sectors successfully read
+    qint64 sectorRuns = 0;          // Number of physically contiguous runs the requests were split into
+    qint64 systemCalls = 0;         // Number of seek and read operations performed on the file
+    qint64 systemCallsSaved = 0;    // Seek and read operations avoided compared to per-sector reads
+    qint64 bytesRead = 0;           // Number of bytes copied from the image
+    qint64 sectorsWritten = 0;      // Number of sectors written to the image on commit
+    qint64 writeRuns = 0;           // Number of physically contiguous runs the writes were coalesced into
+    qint64 bytesWritten = 0;        // Number of bytes written to the image file
+};
 
 class DiscImage
 {
 public:
-    DiscImage(QString filename);
+    // File access is via seek/read on the image file; mapped access maps the
+    // whole image into memory and falls back to file access if mapping fails
+    enum AccessMode {
+        FileAccess,
+        MappedAccess
+    };
+
+    // In-place commits write only the modified sectors to the image file; safe
+    // commits write a complete new image to a temporary file and then replace
+    // the original, so the image is never left partially written
+    enum CommitMode {
+        InPlaceCommit,
+        SafeCommit
+    };
+
+    DiscImage(QString filename, AccessMode accessModeParam = MappedAccess,
+              DiscGeometry::Format formatParam = DiscGeometry::UnknownFormat);
     ~DiscImage();
 
     QByteArray readSector(qint64 sectorNumber);
     QByteArray readSector(qint64 startSectorNumber, qint64 numberOfSectors);
+    bool readSector(qint64 startSectorNumber, qint64 numberOfSectors, char *buffer);
+    bool readBytes(qint64 discBytePosition, qint64 length, char *buffer);
+
+    bool writeSector(qint64 sectorNumber, const QByteArray &sectorData);
+    bool writeSector(qint64 startSectorNumber, qint64 numberOfSectors, const char *buffer);
+    bool commit(CommitMode commitMode = InPlaceCommit);
+    void discardChanges();
+    bool isModified();
+    qint64 getNumberOfModifiedSectors();
+
+    DiscSectorView getSectorView(qint64 sectorNumber);
+    DiscSectorView getSectorView(qint64 startSectorNumber, qint64 numberOfSectors);
+    DiscSectorView getByteView(qint64 discBytePosition, qint64 length);
 
     qint64 getSectorSize();
+    DiscGeometry getGeometry();
     bool isValid();
+    bool isMapped();
+    bool isReadOnly();
+    bool isCompressed();
+
+    DiscImageIoStatistics getIoStatistics();
+    void resetIoStatistics();
+
+    void setCacheSize(qint64 maximumBytes);
+    DiscSectorCacheStatistics getCacheStatistics();
+    void clearCache();
 
 private:
+    Q_DISABLE_COPY(DiscImage)
+
     QFile *discImageFile;
     bool discImageOpen;
+    bool discImageReadOnly;
+    bool mapRequested;
+
+    // Compressed (gzip or zip) image, decompressed as it is read (null if the
+    // image is not compressed)
+    CompressedImageFile *compressedImage;
+
+    // Memory mapped image (null if the image is accessed via the file)
+    uchar *mappedImage;
+    qint64 mappedImageSize;
 
-    // Disc geometry
-    qint64 tracks;
-    qint64 sides;
+    DiscImageIoStatistics ioStatistics;
+
+    // Optional sector cache (null if disabled)
+    DiscSectorCache *sectorCache;
+
+    // Modified sectors waiting to be committed (byte position -> sector data),
+    // so iterating the map visits them in the order they are stored in the file
+    QMap<qint64, QByteArray> modifiedSectors;
+    QAtomicInt numberOfModifiedSectors;
+
+    // Serialises file access, statistics, the cache and modified sectors between threads
+    QMutex ioMutex;
+
+    // Disc geometry (and its sector translation, selected when the image is opened)
+    DiscGeometry geometry;
     qint64 sectorsPerTrack;
     qint64 sectorSize;
-    qint64 startSector;
-
-    qint64 translateSectorToByte(qint64 sector);
+    DiscGeometry::SectorTranslator sectorTranslator;
+    DiscGeometry::ContiguousSectorCounter contiguousSectorCounter;
+
+    void setGeometry(DiscGeometry::Format format);
+    qint64 translateSectorToByte(qint64 sector) { return sectorTranslator(sector); }
+    qint64 getContiguousSectors(qint64 startSectorNumber, qint64 numberOfSectors) { return contiguousSectorCounter(startSectorNumber, numberOfSectors); }
+    bool readSectorRuns(qint64 startSectorNumber, qint64 numberOfSectors, char *buffer);
+    qint64 getImageSize();
+    bool readFile(qint64 bytePosition, char *buffer, qint64 length);
+    bool writeFile(qint64 bytePosition, const char *buffer, qint64 length);
+    void overlayModifiedSectors(qint64 bytePosition, char *buffer, qint64 length);
+    bool hasModifiedSectors(qint64 bytePosition, qint64 length);
+    bool commitInPlace();
+    bool commitSafely();
+    bool openImageFile();
+    void closeImageFile();
+    bool readCachedRun(qint64 bytePosition, char *buffer, qint64 length);
+    void copyTrackData(const QByteArray &trackData, qint64 trackPosition, qint64 bytePosition, char *buffer, qint64 length);
+    bool isSectorInImage(qint64 bytePosition, qint64 numberOfSectors);
 };
 
 #endif // DISCIMAGE_H
@@ -0,0 +1,159 @@
+/************************************************************************
+
+    discimagehashtree.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "discimagehashtree.h"
+#include "xxhash64.h"
+
+DiscImageHashTree::DiscImageHashTree()
+{
+    clear();
+}
+
+// Hash every track of the disc image and build the tree above them
+// Note: The sectors of a mapped image are hashed in place
+bool DiscImageHashTree::build(DiscImage *discImage)
+{
+    clear();
+
+    DiscGeometry geometry = discImage->getGeometry();
+    sectorsPerLeaf = geometry.getSectorsPerTrack();
+    sectorSize = discImage->getSectorSize();
+    numberOfSectors = geometry.getTotalSectors();
+    if (sectorsPerLeaf < 1 || numberOfSectors < 1) return false;
+
+    QVector<quint64> leaves;
+    leaves.reserve(static_cast<int>((numberOfSectors + sectorsPerLeaf - 1) / sectorsPerLeaf));
+
+    QByteArray trackData;
+    for (qint64 startSector = 0; startSector < numberOfSectors; startSector += sectorsPerLeaf) {
+        qint64 trackSectors = qMin(sectorsPerLeaf, numberOfSectors - startSector);
+        DiscSectorView trackView = discImage->getSectorView(startSector, trackSectors);
+
+        if (!trackView.isNull()) {
+            leaves.append(XxHash64::hash(reinterpret_cast<const char *>(trackView.data()), trackView.size()));
+        } else {
+            trackData.resize(static_cast<int>(trackSectors * sectorSize));
+            if (!discImage->readSector(startSector, trackSectors, trackData.data())) {
+                clear();
+                return false;
+            }
+            leaves.append(XxHash64::hash(trackData.constData(), trackData.size()));
+        }
+    }
+    levels.append(leaves);
+
+    // Hash each pair of nodes into their parent until only the root is left
+    while (levels.last().size() > 1) {
+        const QVector<quint64> &children = levels.last();
+        QVector<quint64> parents;
+        parents.reserve((children.size() + 1) / 2);
+
+        for (qint64 index = 0; index < children.size(); index += 2) {
+            if (index + 1 == children.size()) {
+                parents.append(children[index]);
+                continue;
+            }
+
+            quint64 pair[2] = { children[index], children[index + 1] };
+            parents.append(XxHash64::hash(reinterpret_cast<const char *>(pair), sizeof(pair)));
+        }
+
+        levels.append(parents);
+    }
+
+    return true;
+}
+
+void DiscImageHashTree::clear()
+{
+    sectorsPerLeaf = 0;
+    sectorSize = 0;
+    numberOfSectors = 0;
+    levels.clear();
+}
+
+quint64 DiscImageHashTree::getRootHash() const
+{
+    if (levels.isEmpty()) return 0;
+    return levels.last().first();
+}
+
+qint64 DiscImageHashTree::getNumberOfLeaves() const
+{
+    if (levels.isEmpty()) return 0;
+    return levels.first().size();
+}
+
+qint64 DiscImageHashTree::getSectorsPerLeaf() const
+{
+    return sectorsPerLeaf;
+}
+
+qint64 DiscImageHashTree::getSectorSize() const
+{
+    return sectorSize;
+}
+
+qint64 DiscImageHashTree::getNumberOfSectors() const
+{
+    return numberOfSectors;
+}
+
+// Trees can only be compared if their images have the same geometry (and so
+// the same shape of tree)
+bool DiscImageHashTree::isComparable(const DiscImageHashTree &other) const
+{
+    return !levels.isEmpty() && !other.levels.isEmpty() && sectorsPerLeaf == other.sectorsPerLeaf &&
+            sectorSize == other.sectorSize && numberOfSectors == other.numberOfSectors;
+}
+
+// Get the leaves (tracks) whose hashes differ from those of another tree, in
+// order; returns nothing if the trees cannot be compared
+QVector<qint64> DiscImageHashTree::getChangedLeaves(const DiscImageHashTree &other) const
+{
+    QVector<qint64> changedLeaves;
+    if (!isComparable(other)) return changedLeaves;
+
+    findChangedLeaves(other, levels.size() - 1, 0, &changedLeaves);
+    return changedLeaves;
+}
+
+// Private methods
+
+void DiscImageHashTree::findChangedLeaves(const DiscImageHashTree &other, qint64 level, qint64 index,
+                                          QVector<qint64> *changedLeaves) const
+{
+    if (levels[level][index] == other.levels[level][index]) return;
+
+    if (level == 0) {
+        changedLeaves->append(index);
+        return;
+    }
+
+    findChangedLeaves(other, level - 1, 2 * index, changedLeaves);
+    if (2 * index + 1 < levels[level - 1].size()) findChangedLeaves(other, level - 1, 2 * index + 1, changedLeaves);
+}
@@ -0,0 +1,71 @@
+/************************************************************************
+
+    discimagehashtree.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef DISCIMAGEHASHTREE_H
+#define DISCIMAGEHASHTREE_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QVector>
+
+#include "discimage.h"
+
+// A Merkle tree of the tracks of a disc image.  Each leaf is the XXH64 hash of
+// a track's sectors (in logical sector order) and each node above it hashes its
+// two children, so two images of the same geometry are compared by descending
+// only into the subtrees whose hashes differ; identical images compare equal
+// at the root
+class DiscImageHashTree
+{
+public:
+    DiscImageHashTree();
+
+    bool build(DiscImage *discImage);
+    void clear();
+
+    quint64 getRootHash() const;
+    qint64 getNumberOfLeaves() const;
+    qint64 getSectorsPerLeaf() const;
+    qint64 getSectorSize() const;
+    qint64 getNumberOfSectors() const;
+
+    bool isComparable(const DiscImageHashTree &other) const;
+    QVector<qint64> getChangedLeaves(const DiscImageHashTree &other) const;
+
+private:
+    qint64 sectorsPerLeaf;
+    qint64 sectorSize;
+    qint64 numberOfSectors;
+
+    // Node hashes of each level of the tree, from the leaves (level 0) up to
+    // the root.  A node without a pair is carried up to the next level as it is
+    QVector<QVector<quint64> > levels;
+
+    void findChangedLeaves(const DiscImageHashTree &other, qint64 level, qint64 index, QVector<qint64> *changedLeaves) const;
+};
+
+#endif // DISCIMAGEHASHTREE_H
@@ -0,0 +1,140 @@
+/************************************************************************
+
+    discimageloader.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "discimageloader.h"
+#include "logcategories.h"
+#include "discimageprober.h"
+#include "tracerecorder.h"
+#include "adfscataloguescanner.h"
+
+#include <QElapsedTimer>
+
+// Maximum interval between directory batches (in milliseconds) and the maximum
+// number of directories in a batch
+static const qint64 batchInterval = 50;
+static const qint64 batchSize = 64;
+
+DiscImageLoader::DiscImageLoader(QObject *parent) : QObject(parent)
+{
+    // Directory records are passed to the GUI thread via queued signals
+    qRegisterMetaType<QVector<AdfsDirectoryRecord> >("QVector<AdfsDirectoryRecord>");
+    qRegisterMetaType<AdfsDirectoryRecord>("AdfsDirectoryRecord");
+    qRegisterMetaType<QSharedPointer<DiscImage> >("QSharedPointer<DiscImage>");
+    qRegisterMetaType<QSharedPointer<AdfsImage> >("QSharedPointer<AdfsImage>");
+    qRegisterMetaType<AdfsCatalogue>("AdfsCatalogue");
+
+    cancelledLoadId.store(-1);
+}
+
+// Request that a load (and any earlier load) is stopped, or not started if it is
+// still queued (may be called from any thread)
+void DiscImageLoader::cancel(qint64 loadId)
+{
+    qint64 previousLoadId = cancelledLoadId.loadAcquire();
+    while (loadId > previousLoadId && !cancelledLoadId.testAndSetOrdered(previousLoadId, loadId, previousLoadId)) {}
+}
+
+// Open and validate a disc image, then scan the catalogue (in parallel), emitting
+// the directories in batches as they are read.  The open image and its root
+// directory are passed to the GUI thread, so the image is only opened and
+// validated once
+// Note: The ADFS image is released before the disc image by both threads, so
+// whichever finishes with them last deletes them in that order
+void DiscImageLoader::load(qint64 loadId, QString filename)
+{
+    TraceScope trace("load", "DiscImageLoader::load");
+
+    if (isCancelled(loadId)) {
+        emit loadFinished(loadId, true);
+        return;
+    }
+
+    // Identify the format of the disc image
+    DiscImageProber discImageProber;
+    discImageProber.probe(filename);
+    DiscGeometry::Format format = discImageProber.getBestFormat();
+
+    // Open the disc image and validate the file system
+    QSharedPointer<DiscImage> discImage(new DiscImage(filename, DiscImage::MappedAccess, format));
+    QSharedPointer<AdfsImage> adfsImage(new AdfsImage(discImage.data()));
+
+    AdfsDirectoryRecord rootDirectoryRecord;
+    if (!adfsImage->isValid() || !adfsImage->readDirectoryRecord(adfsImage->getRootDirectorySector(), &rootDirectoryRecord)) {
+        emit imageOpened(loadId, false, filename, QSharedPointer<DiscImage>(), QSharedPointer<AdfsImage>(), rootDirectoryRecord);
+        emit loadFinished(loadId, false);
+        return;
+    }
+
+    emit imageOpened(loadId, true, filename, discImage, adfsImage, rootDirectoryRecord);
+
+    // Scan the catalogue on all cores, sending the directories to the GUI thread
+    // in batches as the workers read them (the callback is only called by one
+    // worker at a time)
+    QVector<AdfsDirectoryRecord> batch;
+    QElapsedTimer batchTimer;
+    batchTimer.start();
+
+    AdfsCatalogueScanner scanner(adfsImage.data());
+    scanner.setDirectoryCallback([&](const AdfsDirectoryRecord &directoryRecord, qint64 directoriesRead, qint64 directoriesFound) {
+        batch.append(directoryRecord);
+
+        // Send the batch if it is full or has been waiting long enough
+        if (batch.size() >= batchSize || batchTimer.elapsed() >= batchInterval) {
+            emit directoriesLoaded(loadId, batch);
+            emit progressChanged(loadId, directoriesRead, directoriesFound);
+            batch.clear();
+            batchTimer.restart();
+        }
+
+        return !isCancelled(loadId);
+    });
+
+    AdfsCatalogue catalogue;
+    scanner.scan(&catalogue);
+
+    if (scanner.getStatistics().stopped) {
+        qCDebug(lcModel) << "DiscImageLoader::load(): Catalogue scan cancelled";
+        emit loadFinished(loadId, true);
+        return;
+    }
+
+    qint64 directoriesRead = scanner.getStatistics().directoriesRead + scanner.getStatistics().directoriesInvalid;
+    if (!batch.isEmpty()) emit directoriesLoaded(loadId, batch);
+    emit progressChanged(loadId, directoriesRead, directoriesRead);
+
+    // The complete catalogue is used for searching
+    emit catalogueLoaded(loadId, catalogue);
+
+    emit loadFinished(loadId, false);
+}
+
+// Private methods
+
+bool DiscImageLoader::isCancelled(qint64 loadId) const
+{
+    return loadId <= cancelledLoadId.loadAcquire();
+}
@@ -0,0 +1,75 @@
+/************************************************************************
+
+    discimageloader.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef DISCIMAGELOADER_H
+#define DISCIMAGELOADER_H
+
+#include <QObject>
+#include <QDebug>
+#include <QAtomicInteger>
+#include <QVector>
+#include <QSharedPointer>
+
+#include "discimage.h"
+#include "adfsimage.h"
+#include "adfscatalogue.h"
+
+// Opens, validates and scans the catalogue of a disc image.  Intended to be moved
+// to a worker thread; the open image is handed to the GUI thread (which shares it
+// with the scan) and the catalogue is streamed back in batches of directories so
+// that the GUI thread stays responsive whilst large images are scanned, and then
+// as a whole once the scan is complete.  Each load is identified by a load ID,
+// which must increase from one load to the next
+class DiscImageLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DiscImageLoader(QObject *parent = 0);
+
+    void cancel(qint64 loadId);
+
+public slots:
+    void load(qint64 loadId, QString filename);
+
+signals:
+    void imageOpened(qint64 loadId, bool valid, QString filename, QSharedPointer<DiscImage> discImage,
+                     QSharedPointer<AdfsImage> adfsImage, AdfsDirectoryRecord rootDirectoryRecord);
+    void directoriesLoaded(qint64 loadId, QVector<AdfsDirectoryRecord> directoryRecords);
+    void progressChanged(qint64 loadId, qint64 directoriesRead, qint64 directoriesFound);
+    void catalogueLoaded(qint64 loadId, AdfsCatalogue catalogue);
+    void loadFinished(qint64 loadId, bool cancelled);
+
+private:
+    // Set from the GUI thread to stop a load (and any earlier load), whether or
+    // not it has started yet
+    QAtomicInteger<qint64> cancelledLoadId;
+
+    bool isCancelled(qint64 loadId) const;
+};
+
+#endif // DISCIMAGELOADER_H
@@ -0,0 +1,299 @@
+/************************************************************************
+
+    discimageprober.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "discimageprober.h"
+#include "logcategories.h"
+#include "adfsnewmap.h"
+#include "compressedimagefile.h"
+#include "tracerecorder.h"
+
+#include <QScopedPointer>
+
+#include <algorithm>
+
+// Bytes read from the start of the image - enough for the old map, the root
+// directory signatures, an E format map zone, the boot block disc record and
+// both DFS catalogues of a double sided image
+static const qint64 headerSize = 4096;
+
+// Position of the disc record within the boot block (and within a map zone)
+static const qint64 bootBlockDiscRecord = 0xC00 + 0x1C0;
+static const qint64 zoneDiscRecord = 4;
+static const qint64 discRecordSize = 60;
+
+DiscImageProber::DiscImageProber()
+{
+    bytesRead = 0;
+}
+
+// Probe a disc image; the possible formats are available from getResults()
+// Returns false if the image could not be read
+bool DiscImageProber::probe(const QString &filename)
+{
+    TraceScope trace("parse", "DiscImageProber::probe");
+
+    results.clear();
+    bytesRead = 0;
+
+    // Compressed images are probed by their uncompressed contents
+    QScopedPointer<QIODevice> imageFile(CompressedImageFile::createImageDevice(filename));
+    if (!imageFile->open(QIODevice::ReadOnly)) {
+        qCDebug(lcDiscImage) << "DiscImageProber::probe(): Cannot open disc image" << filename;
+        return false;
+    }
+
+    qint64 imageSize = imageFile->size();
+
+    QByteArray header;
+    if (!readImage(imageFile.data(), 0, qMin(headerSize, imageSize), &header)) return false;
+
+    // Pad short images so that each probe can check its signatures directly
+    header.append(QByteArray(static_cast<int>(headerSize - header.size()), 0));
+
+    probeAdfsOldMap(header, imageSize);
+    probeAdfsNewMap(imageFile.data(), header, imageSize);
+    probeDfs(header, imageSize);
+
+    // Fall back on the image size alone
+    DiscGeometry::Format sizeFormat = DiscGeometry::getFormatForImageSize(imageSize);
+    if (sizeFormat != DiscGeometry::UnknownFormat) addResult(sizeFormat, 10, "Image size");
+
+    // Rank the results, most confident first
+    std::stable_sort(results.begin(), results.end(), [](const DiscImageProbeResult &a, const DiscImageProbeResult &b) {
+        return a.confidence > b.confidence;
+    });
+
+    return true;
+}
+
+// Get the possible formats, most confident first
+QVector<DiscImageProbeResult> DiscImageProber::getResults() const
+{
+    return results;
+}
+
+// Get the most likely format (UnknownFormat if the image was not recognised)
+DiscGeometry::Format DiscImageProber::getBestFormat() const
+{
+    if (results.isEmpty()) return DiscGeometry::UnknownFormat;
+    return results.first().format;
+}
+
+qint64 DiscImageProber::getBestConfidence() const
+{
+    if (results.isEmpty()) return 0;
+    return results.first().confidence;
+}
+
+// Get the number of bytes read from the image by the last probe
+qint64 DiscImageProber::getBytesRead() const
+{
+    return bytesRead;
+}
+
+// Private methods
+
+bool DiscImageProber::readImage(QIODevice *imageFile, qint64 bytePosition, qint64 length, QByteArray *data)
+{
+    if (!imageFile->seek(bytePosition)) return false;
+
+    *data = imageFile->read(length);
+    bytesRead += data->size();
+
+    return data->size() == length;
+}
+
+// Add a result, keeping only the most confident result for each format
+void DiscImageProber::addResult(DiscGeometry::Format format, qint64 confidence, const QString &evidence)
+{
+    for (DiscImageProbeResult &result : results) {
+        if (result.format != format) continue;
+
+        if (confidence > result.confidence) {
+            result.confidence = confidence;
+            result.evidence = evidence;
+        }
+        return;
+    }
+
+    DiscImageProbeResult result;
+    result.format = format;
+    result.confidence = confidence;
+    result.evidence = evidence;
+    results.append(result);
+}
+
+// ADFS S, M, L and D - old free space map in the first two (256 byte) sectors
+void DiscImageProber::probeAdfsOldMap(const QByteArray &header, qint64 imageSize)
+{
+    const char *map = header.constData();
+
+    // Both map sectors end with a checksum
+    if (static_cast<quint8>(map[255]) != calculateOldMapChecksum(map) ||
+            static_cast<quint8>(map[256 + 255]) != calculateOldMapChecksum(map + 256)) return;
+
+    // Total sectors on the disc (bytes 252-254 of sector 0)
+    qint64 totalSectors = static_cast<quint8>(map[252]) | (static_cast<quint8>(map[253]) << 8) |
+            (static_cast<quint8>(map[254]) << 16);
+
+    // The root directory follows the map ("Hugo" directories at sector 2, or a D
+    // format "Nick" directory at 1024 bytes)
+    bool hugoRoot = (header.mid(0x201, 4) == "Hugo");
+    bool nickRoot = (header.mid(0x401, 4) == "Nick");
+
+    DiscGeometry::Format format = DiscGeometry::UnknownFormat;
+    if (hugoRoot && totalSectors == 640) format = DiscGeometry::AdfsS;
+    else if (hugoRoot && totalSectors == 1280) format = DiscGeometry::AdfsM;
+    else if (hugoRoot && totalSectors == 2560) format = DiscGeometry::AdfsL;
+    else if (nickRoot && totalSectors == 3200) format = DiscGeometry::AdfsD;
+
+    if (format == DiscGeometry::UnknownFormat) {
+        // A valid map without a recognised root (possibly a hard disc image)
+        if (hugoRoot) addResult(DiscGeometry::getFormatForImageSize(totalSectors * 256), 40, "Old map checksums and root directory");
+        return;
+    }
+
+    // The image should be the size of the disc
+    if (imageSize == DiscGeometry(format).getImageSize()) addResult(format, 100, "Old map checksums, root directory and image size");
+    else addResult(format, 80, "Old map checksums and root directory");
+}
+
+// ADFS E, E+, F and F+ - new map with zone check bytes
+void DiscImageProber::probeAdfsNewMap(QIODevice *imageFile, const QByteArray &header, qint64 imageSize)
+{
+    // E format - a single zone map at the start of the disc
+    const char *zone = header.constData();
+    if (static_cast<quint8>(zone[0]) == AdfsNewMap::calculateZoneCheck(zone, 1024) && isDiscRecordValid(zone + zoneDiscRecord, 5, 1)) {
+        // Big directories ("SBPr") are indicated by the disc record's format version
+        bool bigDirectories = (zone[zoneDiscRecord + 0x2C] != 0) || (header.mid(0x804, 4) == "SBPr");
+        DiscGeometry::Format format = bigDirectories ? DiscGeometry::AdfsEPlus : DiscGeometry::AdfsE;
+
+        addResult(format, (imageSize == DiscGeometry(format).getImageSize()) ? 100 : 80, "New map zone check and disc record");
+        return;
+    }
+
+    // F format - the boot block holds a copy of the disc record, which locates the
+    // map in the middle of the disc
+    const char *discRecord = header.constData() + bootBlockDiscRecord;
+    if (!isDiscRecordValid(discRecord, 10, 4)) return;
+
+    qint64 mapPosition, mapLength;
+    if (!AdfsNewMap::getMapLocation(header.mid(bootBlockDiscRecord, discRecordSize), &mapPosition, &mapLength)) return;
+    qint64 sectorSize = 1 << static_cast<quint8>(discRecord[0]);
+
+    QByteArray mapZone;
+    if (mapPosition < 0 || mapPosition + sectorSize > imageSize) return;
+    if (!readImage(imageFile, mapPosition, sectorSize, &mapZone)) return;
+
+    if (static_cast<quint8>(mapZone[0]) != AdfsNewMap::calculateZoneCheck(mapZone.constData(), sectorSize)) {
+        addResult(DiscGeometry::AdfsF, 30, "Boot block disc record (map zone check failed)");
+        return;
+    }
+
+    bool bigDirectories = (mapZone[static_cast<int>(zoneDiscRecord + 0x2C)] != 0);
+    DiscGeometry::Format format = bigDirectories ? DiscGeometry::AdfsFPlus : DiscGeometry::AdfsF;
+
+    addResult(format, (imageSize == DiscGeometry(format).getImageSize()) ? 100 : 80, "Boot block disc record and map zone check");
+}
+
+// DFS - catalogue in sectors 0 and 1 of each side
+void DiscImageProber::probeDfs(const QByteArray &header, qint64 imageSize)
+{
+    qint64 totalSectors = 0;
+    if (!isDfsCatalogueValid(header, 0, &totalSectors)) return;
+
+    qint64 tracks = (totalSectors == 400) ? 40 : 80;
+
+    // The second side of an interleaved image starts with its own catalogue
+    // after the first track of side 0
+    qint64 sideTwoSectors = 0;
+    bool doubleSided = isDfsCatalogueValid(header, 10 * 256, &sideTwoSectors) && sideTwoSectors == totalSectors;
+
+    DiscGeometry::Format format;
+    if (doubleSided) format = (tracks == 40) ? DiscGeometry::DfsDsd40 : DiscGeometry::DfsDsd80;
+    else format = (tracks == 40) ? DiscGeometry::DfsSsd40 : DiscGeometry::DfsSsd80;
+
+    // DFS images are often truncated after the last used sector, so the image
+    // only needs to be no larger than the disc.  The catalogue has no checksum,
+    // so even a full match is less certain than an ADFS map
+    if (imageSize <= DiscGeometry(format).getImageSize()) addResult(format, doubleSided ? 70 : 60, "DFS catalogue");
+    else addResult(format, 20, "DFS catalogue (image larger than disc)");
+}
+
+// Check that a new map disc record is consistent with an 800K or 1600K floppy
+bool DiscImageProber::isDiscRecordValid(const char *discRecord, qint64 sectorsPerTrack, qint64 zones)
+{
+    if (static_cast<quint8>(discRecord[0]) != 10) return false;             // 1024 byte sectors
+    if (static_cast<quint8>(discRecord[1]) != sectorsPerTrack) return false;
+    if (static_cast<quint8>(discRecord[2]) != 2) return false;              // Heads
+    if (static_cast<quint8>(discRecord[9]) != zones) return false;
+
+    // Bytes per map bit must be at least a sector (and sensibly small)
+    qint64 log2BytesPerMapBit = static_cast<quint8>(discRecord[5]);
+    return log2BytesPerMapBit >= 6 && log2BytesPerMapBit <= 12;
+}
+
+// Check a DFS catalogue and get the number of sectors on the disc
+bool DiscImageProber::isDfsCatalogueValid(const QByteArray &header, qint64 catalogueOffset, qint64 *totalSectors)
+{
+    const char *catalogue = header.constData() + catalogueOffset;
+
+    // Sector 1 - byte 5 is the number of files * 8; bytes 6 (bits 0-1) and 7 are
+    // the number of sectors on the disc
+    qint64 fileOffset = static_cast<quint8>(catalogue[256 + 5]);
+    *totalSectors = ((static_cast<quint8>(catalogue[256 + 6]) & 0x03) << 8) | static_cast<quint8>(catalogue[256 + 7]);
+
+    if ((fileOffset & 0x07) != 0 || fileOffset > 31 * 8) return false;
+    if (*totalSectors != 400 && *totalSectors != 800) return false;
+
+    // Each catalogue entry must have a printable name and lie within the disc
+    for (qint64 entry = 8; entry <= fileOffset; entry += 8) {
+        for (qint64 character = 0; character < 7; character++) {
+            quint8 nameCharacter = static_cast<quint8>(catalogue[entry + character]) & 0x7F;
+            if (nameCharacter < 0x20) return false;
+        }
+
+        qint64 startSector = ((static_cast<quint8>(catalogue[256 + entry + 6]) & 0x03) << 8) |
+                static_cast<quint8>(catalogue[256 + entry + 7]);
+        if (startSector < 2 || startSector >= *totalSectors) return false;
+    }
+
+    return true;
+}
+
+// Calculate the checksum of an old map sector (as AdfsFreeSpaceMap)
+qint64 DiscImageProber::calculateOldMapChecksum(const char *sector)
+{
+    quint16 sum = 255;
+
+    for (qint64 pointer = 254; pointer >= 0; pointer--) {
+        if (sum > 255) sum = (sum + 1) & 0xFF;
+        sum += static_cast<quint8>(sector[pointer]);
+    }
+
+    return sum & 0xFF;
+}
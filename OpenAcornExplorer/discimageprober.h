@@ -0,0 +1,78 @@
+/************************************************************************
+
+    discimageprober.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef DISCIMAGEPROBER_H
+#define DISCIMAGEPROBER_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QIODevice>
+#include <QVector>
+
+#include "discgeometry.h"
+
+// A possible format for a disc image and how confident the prober is of it
+struct DiscImageProbeResult
+{
+    DiscGeometry::Format format = DiscGeometry::UnknownFormat;
+    qint64 confidence = 0;      // 0 to 100
+    QString evidence;           // What the format was identified from
+};
+
+// Identifies the format of a disc image from its size and a few targeted
+// reads: the start of the image (old map, root directory signatures, new map
+// zone 0 of an E format disc, the boot block and the DFS catalogue) and, for F
+// format discs, the first zone of the map in the middle of the disc.  At most
+// two reads are made, and the image is never read in full
+class DiscImageProber
+{
+public:
+    DiscImageProber();
+
+    bool probe(const QString &filename);
+    QVector<DiscImageProbeResult> getResults() const;
+    DiscGeometry::Format getBestFormat() const;
+    qint64 getBestConfidence() const;
+    qint64 getBytesRead() const;
+
+private:
+    QVector<DiscImageProbeResult> results;
+    qint64 bytesRead;
+
+    bool readImage(QIODevice *imageFile, qint64 bytePosition, qint64 length, QByteArray *data);
+    void addResult(DiscGeometry::Format format, qint64 confidence, const QString &evidence);
+
+    void probeAdfsOldMap(const QByteArray &header, qint64 imageSize);
+    void probeAdfsNewMap(QIODevice *imageFile, const QByteArray &header, qint64 imageSize);
+    void probeDfs(const QByteArray &header, qint64 imageSize);
+
+    bool isDiscRecordValid(const char *discRecord, qint64 sectorsPerTrack, qint64 zones);
+    bool isDfsCatalogueValid(const QByteArray &header, qint64 catalogueOffset, qint64 *totalSectors);
+    qint64 calculateOldMapChecksum(const char *sector);
+};
+
+#endif // DISCIMAGEPROBER_H
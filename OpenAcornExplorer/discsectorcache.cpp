@@ -0,0 +1,124 @@
+/************************************************************************
+
+    discsectorcache.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+#include "discsectorcache.h"
+
+#include <climits>
+
+// Class constructor
+// Note: The cost of each cached track is its size in bytes, so QCache's
+// maximum cost is the cache byte budget
+DiscSectorCache::DiscSectorCache(qint64 trackSizeParam, qint64 maximumBytesParam)
+{
+    trackSize = trackSizeParam;
+    setMaximumBytes(maximumBytesParam);
+}
+
+// Get a cached track (returns nullptr on a cache miss)
+// Note: The returned track is only valid until the next insertion into the cache
+QByteArray *DiscSectorCache::getTrack(qint64 trackNumber)
+{
+    QByteArray *track = trackCache.object(trackNumber);
+
+    if (track != nullptr) statistics.hits++;
+    else statistics.misses++;
+
+    return track;
+}
+
+// Insert a track that has been read from the image into the cache
+void DiscSectorCache::insertTrack(qint64 trackNumber, const QByteArray &trackData)
+{
+    // Replacing a track is not an eviction
+    bool replacingTrack = trackCache.contains(trackNumber);
+    qint64 tracksBefore = trackCache.count();
+
+    statistics.bytesRead += trackData.size();
+
+    // QCache discards least-recently-used tracks to make room for the new one
+    trackCache.insert(trackNumber, new QByteArray(trackData), trackData.size());
+
+    qint64 expectedTracks = replacingTrack ? tracksBefore : tracksBefore + 1;
+    if (trackCache.count() < expectedTracks) statistics.evictions += expectedTracks - trackCache.count();
+}
+
+// Update any cached tracks overlapping the given byte range so that the cache
+// remains consistent when data is written to the image (write-through)
+void DiscSectorCache::updateData(qint64 bytePosition, const char *data, qint64 length)
+{
+    qint64 firstTrack = bytePosition / trackSize;
+    qint64 lastTrack = (bytePosition + length - 1) / trackSize;
+
+    for (qint64 trackNumber = firstTrack; trackNumber <= lastTrack; trackNumber++) {
+        // Look up without affecting the hit/miss statistics (the lookup does make
+        // the track the most recently used, as the track has just been accessed)
+        QByteArray *track = trackCache.object(trackNumber);
+        if (track == nullptr) continue;
+
+        qint64 trackStart = trackNumber * trackSize;
+        qint64 copyStart = qMax(bytePosition, trackStart);
+        qint64 copyEnd = qMin(bytePosition + length, trackStart + trackSize);
+
+        memcpy(track->data() + (copyStart - trackStart), data + (copyStart - bytePosition), copyEnd - copyStart);
+    }
+}
+
+// Discard all cached tracks
+void DiscSectorCache::clear()
+{
+    trackCache.clear();
+}
+
+// Get the size of a cached track in bytes
+qint64 DiscSectorCache::getTrackSize()
+{
+    return trackSize;
+}
+
+// Set the cache byte budget (shrinking the budget evicts tracks immediately)
+void DiscSectorCache::setMaximumBytes(qint64 maximumBytesParam)
+{
+    qint64 tracksBefore = trackCache.count();
+
+    trackCache.setMaxCost(static_cast<int>(qMin(maximumBytesParam, static_cast<qint64>(INT_MAX))));
+    statistics.evictions += tracksBefore - trackCache.count();
+}
+
+// Get the cache statistics
+DiscSectorCacheStatistics DiscSectorCache::getStatistics()
+{
+    DiscSectorCacheStatistics currentStatistics = statistics;
+    currentStatistics.cachedBytes = trackCache.totalCost();
+    currentStatistics.maximumBytes = trackCache.maxCost();
+
+    return currentStatistics;
+}
+
+// Reset the cache statistics (the cache contents are unaffected)
+void DiscSectorCache::resetStatistics()
+{
+    statistics = DiscSectorCacheStatistics();
+}
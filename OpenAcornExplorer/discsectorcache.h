@@ -0,0 +1,69 @@
+/************************************************************************
+
+    discsectorcache.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+#ifndef DISCSECTORCACHE_H
+#define DISCSECTORCACHE_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QCache>
+
+// Sector cache statistics
+struct DiscSectorCacheStatistics
+{
+    qint64 hits = 0;            // Track lookups satisfied from the cache
+    qint64 misses = 0;          // Track lookups that required a read from the image
+    qint64 evictions = 0;       // Tracks discarded to stay within the byte budget
+    qint64 bytesRead = 0;       // Bytes read from the image to fill the cache
+    qint64 cachedBytes = 0;     // Bytes currently held in the cache
+    qint64 maximumBytes = 0;    // Cache byte budget
+};
+
+// Least-recently-used cache of whole physical tracks from a disc image.
+// Tracks are keyed by their position in the image file (byte position / track size)
+class DiscSectorCache
+{
+public:
+    DiscSectorCache(qint64 trackSizeParam, qint64 maximumBytesParam);
+
+    QByteArray *getTrack(qint64 trackNumber);
+    void insertTrack(qint64 trackNumber, const QByteArray &trackData);
+    void updateData(qint64 bytePosition, const char *data, qint64 length);
+    void clear();
+
+    qint64 getTrackSize();
+    void setMaximumBytes(qint64 maximumBytesParam);
+    DiscSectorCacheStatistics getStatistics();
+    void resetStatistics();
+
+private:
+    QCache<qint64, QByteArray> trackCache;
+    qint64 trackSize;
+
+    DiscSectorCacheStatistics statistics;
+};
+
+#endif // DISCSECTORCACHE_H
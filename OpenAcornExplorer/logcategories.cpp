@@ -0,0 +1,36 @@
+/************************************************************************
+
+    logcategories.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "logcategories.h"
+
+Q_LOGGING_CATEGORY(lcDiscImage, "oae.discimage")
+Q_LOGGING_CATEGORY(lcMap, "oae.map")
+Q_LOGGING_CATEGORY(lcDirectory, "oae.directory")
+Q_LOGGING_CATEGORY(lcImage, "oae.image")
+Q_LOGGING_CATEGORY(lcFiles, "oae.files")
+Q_LOGGING_CATEGORY(lcModel, "oae.model")
+Q_LOGGING_CATEGORY(lcTrace, "oae.trace")
@@ -0,0 +1,53 @@
+/************************************************************************
+
+    logcategories.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef LOGCATEGORIES_H
+#define LOGCATEGORIES_H
+
+#include <QLoggingCategory>
+
+// Diagnostic output is grouped by subsystem so that it can be enabled and
+// disabled with logging rules, e.g. QT_LOGGING_RULES="oae.directory.debug=false"
+Q_DECLARE_LOGGING_CATEGORY(lcDiscImage)
+Q_DECLARE_LOGGING_CATEGORY(lcMap)
+Q_DECLARE_LOGGING_CATEGORY(lcDirectory)
+Q_DECLARE_LOGGING_CATEGORY(lcImage)
+Q_DECLARE_LOGGING_CATEGORY(lcFiles)
+Q_DECLARE_LOGGING_CATEGORY(lcModel)
+Q_DECLARE_LOGGING_CATEGORY(lcTrace)
+
+// Debug output on the hot paths (made for every sector, directory or file read)
+// is only compiled into builds with OAE_HOT_PATH_LOGGING defined (debug builds
+// by default); otherwise the message is discarded at compile time and nothing
+// is formatted
+#ifdef OAE_HOT_PATH_LOGGING
+#define qCDebugHotPath(category) qCDebug(category)
+#else
+#define qCDebugHotPath(category) while (false) QMessageLogger().noDebug()
+#endif
+
+#endif // LOGCATEGORIES_H
@@ -0,0 +1,130 @@
+/************************************************************************
+
+    logringbuffer.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "logringbuffer.h"
+
+#include <QFile>
+
+#include <atomic>
+#include <cstring>
+
+// Longest message kept (longer messages are truncated)
+static const int maximumMessageLength = 240;
+
+// A message in the ring.  The sequence number is the message's ticket plus one
+// once the message has been written and 0 while it is being written, so that a
+// reader can detect a slot that was overwritten while it was being copied
+struct LogRingBufferSlot
+{
+    std::atomic<quint64> sequence;
+    int length;
+    char text[maximumMessageLength];
+};
+
+static LogRingBufferSlot *ringSlots = nullptr;
+static qint64 ringCapacity = 0;
+static std::atomic<quint64> nextTicket(0);
+static QtMessageHandler previousHandler = nullptr;
+
+// Install the ring buffer as the message handler; the buffer lasts for the
+// rest of the process so that it can be dumped at any point
+void LogRingBuffer::install(qint64 capacity)
+{
+    if (isInstalled() || capacity < 1) return;
+
+    ringSlots = new LogRingBufferSlot[capacity]();
+    ringCapacity = capacity;
+    previousHandler = qInstallMessageHandler(messageHandler);
+}
+
+bool LogRingBuffer::isInstalled()
+{
+    return ringSlots != nullptr;
+}
+
+// Return the messages held in the ring, oldest first
+QStringList LogRingBuffer::getMessages()
+{
+    QStringList messages;
+    if (!isInstalled()) return messages;
+
+    quint64 endTicket = nextTicket.load(std::memory_order_acquire);
+    quint64 startTicket = endTicket > static_cast<quint64>(ringCapacity) ? endTicket - ringCapacity : 0;
+
+    char text[maximumMessageLength];
+    for (quint64 ticket = startTicket; ticket < endTicket; ticket++) {
+        LogRingBufferSlot &slot = ringSlots[ticket % ringCapacity];
+
+        // Skip messages that are still being written or have been overwritten
+        quint64 sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != ticket + 1) continue;
+
+        int length = qBound(0, slot.length, maximumMessageLength);
+        memcpy(text, slot.text, length);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+
+        messages.append(QString::fromUtf8(text, length));
+    }
+
+    return messages;
+}
+
+// Write the messages held in the ring to a file, one per line
+bool LogRingBuffer::dump(const QString &filename)
+{
+    QFile dumpFile(filename);
+    if (!dumpFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    for (const QString &message : getMessages()) {
+        dumpFile.write(message.toUtf8());
+        dumpFile.write("\n");
+    }
+
+    return dumpFile.error() == QFileDevice::NoError;
+}
+
+// Private methods
+
+void LogRingBuffer::messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    QByteArray text = qFormatLogMessage(type, context, message).toUtf8();
+    int length = qMin(text.size(), maximumMessageLength);
+
+    // Claim the next slot, overwriting the oldest message once the ring is full
+    quint64 ticket = nextTicket.fetch_add(1, std::memory_order_relaxed);
+    LogRingBufferSlot &slot = ringSlots[ticket % ringCapacity];
+
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.length = length;
+    memcpy(slot.text, text.constData(), length);
+    slot.sequence.store(ticket + 1, std::memory_order_release);
+
+    if (previousHandler != nullptr) previousHandler(type, context, message);
+}
@@ -1,6 +1,6 @@
 /************************************************************************
 
-    adfsdirectoryitem.h
+    logringbuffer.h
 
     OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
     Copyright (C) 2018 Simon Inns
@@ -24,36 +24,28 @@
 
 ************************************************************************/
 
-#ifndef ADFSDIRECTORYITEM_H
-#define ADFSDIRECTORYITEM_H
 
-#include <QList>
-#include <QVariant>
-#include <QVector>
+#ifndef LOGRINGBUFFER_H
+#define LOGRINGBUFFER_H
+
+#include <QCoreApplication>
 #include <QStringList>
 
-class AdfsDirectoryItem
+// Keeps the most recent log messages in memory so that they can be written out
+// after a failure.  Once installed every message (that is not disabled by its
+// category) is copied into a fixed ring of slots without taking a lock, and is
+// then passed on to the previously installed message handler
+class LogRingBuffer
 {
 public:
-    explicit AdfsDirectoryItem(const QVector<QVariant> &data, AdfsDirectoryItem *parent = 0);
-    ~AdfsDirectoryItem();
-
-    AdfsDirectoryItem *child(int number);
-    int childCount() const;
-    int columnCount() const;
-    QVariant data(int column) const;
-    bool insertChildren(int position, int count, int columns);
-    bool insertColumns(int position, int columns);
-    AdfsDirectoryItem *parent();
-    bool removeChildren(int position, int count);
-    bool removeColumns(int position, int columns);
-    int childNumber() const;
-    bool setData(int column, const QVariant &value);
+    static void install(qint64 capacity = 4096);
+    static bool isInstalled();
+
+    static QStringList getMessages();
+    static bool dump(const QString &filename);
 
 private:
-    QList<AdfsDirectoryItem*> childItems;
-    QVector<QVariant> itemData;
-    AdfsDirectoryItem *parentItem;
+    static void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message);
 };
 
-#endif // ADFSDIRECTORYITEM_H
+#endif // LOGRINGBUFFER_H
@@ -25,13 +25,37 @@
 ************************************************************************/
 
 #include "mainwindow.h"
+#include "tracerecorder.h"
+#include "logringbuffer.h"
 #include <QApplication>
+#include <QDebug>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    // Setting OAE_TRACE to a file name records a Chrome trace of the session
+    QString traceFilename = QString::fromLocal8Bit(qgetenv("OAE_TRACE"));
+    if (!traceFilename.isEmpty()) TraceRecorder::setEnabled(true);
+
+    // Setting OAE_LOG_DUMP to a file name keeps the most recent debug output in
+    // memory and writes it to the file on exit
+    QString logDumpFilename = QString::fromLocal8Bit(qgetenv("OAE_LOG_DUMP"));
+    if (!logDumpFilename.isEmpty()) LogRingBuffer::install();
+
     MainWindow w;
     w.show();
 
-    return a.exec();
+    int result = a.exec();
+
+    if (!traceFilename.isEmpty()) {
+        TraceRecorder::setEnabled(false);
+        if (!TraceRecorder::writeChromeTrace(traceFilename)) qDebug() << "main(): Cannot write trace to" << traceFilename;
+    }
+
+    if (!logDumpFilename.isEmpty() && !LogRingBuffer::dump(logDumpFilename)) {
+        qDebug() << "main(): Cannot write log dump to" << logDumpFilename;
+    }
+
+    return result;
 }
@@ -27,6 +27,11 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
+#include <QElapsedTimer>
+
+// Maximum number of search results shown
+static const qint64 maximumSearchResults = 1000;
+
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow)
@@ -40,6 +45,46 @@ MainWindow::MainWindow(QWidget *parent) :
     // Set the status
     status->setText(tr("No disc image loaded"));
 
+    // Add a progress bar and cancel button for disc image loading
+    loadProgressBar = new QProgressBar;
+    loadProgressBar->setMaximumWidth(200);
+    ui->statusBar->addPermanentWidget(loadProgressBar);
+    cancelLoadButton = new QPushButton(tr("Cancel"));
+    ui->statusBar->addPermanentWidget(cancelLoadButton);
+    connect(cancelLoadButton, &QPushButton::clicked, this, &MainWindow::cancelLoad);
+    showLoadProgress(false);
+
+    // Add the name search to the tool bar, with the results beside the tree view
+    searchEdit = new QLineEdit;
+    searchEdit->setPlaceholderText(tr("Search names"));
+    searchEdit->setClearButtonEnabled(true);
+    searchEdit->setMaximumWidth(300);
+    ui->mainToolBar->addWidget(searchEdit);
+    connect(searchEdit, &QLineEdit::textChanged, this, &MainWindow::searchTextChanged);
+
+    searchResults = new QListWidget;
+    ui->verticalLayout->insertWidget(0, searchResults);
+    connect(searchResults, &QListWidget::itemActivated, this, &MainWindow::searchResultActivated);
+    searchResults->setVisible(false);
+
+    // No disc image is open
+    adfsDirectoryModel = nullptr;
+
+    // Start the disc image loader thread
+    currentLoadId = 0;
+    loaderThread = new QThread(this);
+    discImageLoader = new DiscImageLoader;
+    discImageLoader->moveToThread(loaderThread);
+
+    connect(this, &MainWindow::loadRequested, discImageLoader, &DiscImageLoader::load);
+    connect(discImageLoader, &DiscImageLoader::imageOpened, this, &MainWindow::imageOpened);
+    connect(discImageLoader, &DiscImageLoader::directoriesLoaded, this, &MainWindow::directoriesLoaded);
+    connect(discImageLoader, &DiscImageLoader::progressChanged, this, &MainWindow::loadProgressChanged);
+    connect(discImageLoader, &DiscImageLoader::catalogueLoaded, this, &MainWindow::catalogueLoaded);
+    connect(discImageLoader, &DiscImageLoader::loadFinished, this, &MainWindow::loadFinished);
+
+    loaderThread->start();
+
 
 
     // Test code for model
@@ -70,7 +115,18 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    // Stop the disc image loader thread
+    discImageLoader->cancel(currentLoadId);
+    loaderThread->quit();
+    loaderThread->wait();
+    delete discImageLoader;
+
     delete ui;
+
+    // The model reads from the disc image, so it must be deleted first
+    delete adfsDirectoryModel;
+    adfsImage.clear();
+    discImage.clear();
 }
 
 // Menu bar trigger methods -------------------------------------------------------------------------------------------
@@ -93,36 +149,67 @@ void MainWindow::on_actionExit_triggered()
 void MainWindow::on_actionOpen_triggered()
 {
     // Display the open file dialogue
-    discImageFilename = QFileDialog::getOpenFileName(this,
+    QString filename = QFileDialog::getOpenFileName(this,
             tr("Open Acorn disc image"),
             //QDir::homePath(),
             "D:\\simon\\Documents\\GitHub\\OpenAcornExplorer\\ADFS Test images",
-            tr("ADFS images (*.adl *.adf *.dat);;DFS images (*.ssd *.dsd *.img);;All files (*.*)"));
+            tr("ADFS images (*.adl *.adf *.dat);;DFS images (*.ssd *.dsd *.img);;Compressed images (*.gz *.zip);;All files (*.*)"));
 
     // Check for empty response
-    if (discImageFilename.isEmpty()) return;
+    if (filename.isEmpty()) return;
+
+    // Stop any disc image that is still loading and ignore its results
+    discImageLoader->cancel(currentLoadId);
+    currentLoadId++;
+
+    // Open, validate and scan the disc image on the loader thread
+    status->setText(tr("Opening disc image..."));
+    loadProgressBar->setRange(0, 0);
+    showLoadProgress(true);
+
+    emit loadRequested(currentLoadId, filename);
+}
+
+// Disc image loader slots --------------------------------------------------------------------------------------------
 
-    // Open the disc image file
-    discImage = new DiscImage(discImageFilename);
+// The loader has opened and validated the disc image and read its root directory
+void MainWindow::imageOpened(qint64 loadId, bool valid, QString filename, QSharedPointer<DiscImage> loadedDiscImage,
+                             QSharedPointer<AdfsImage> loadedAdfsImage, AdfsDirectoryRecord rootDirectoryRecord)
+{
+    // Ignore results from superseded loads
+    if (loadId != currentLoadId) return;
 
     // Is the disc image valid?
-    if (!discImage->isValid()) {
+    if (!valid) {
+        showLoadProgress(false);
+        if (adfsDirectoryModel == nullptr) status->setText(tr("No disc image loaded"));
+        else status->setText(tr("Disc image loaded"));
         QMessageBox::information(this, tr("Unable to open disc image"),
             tr("Disc image invalid"));
-
-        // Delete the disc image object
-        delete discImage;
-
-        // Exit
         return;
     }
 
-    // Determine the disc image type
-    // Not implemented yet - always ADFS L
+    // Create the model from the loader's image (directories not yet scanned by
+    // the loader are read on demand as the view expands them) and update the UI
+    // treeview
+    AdfsDirectoryModel *newAdfsDirectoryModel = new AdfsDirectoryModel(loadedAdfsImage.data(), rootDirectoryRecord);
+    ui->treeView->setModel(newAdfsDirectoryModel);
+
+    // Close any previously opened disc image (the model reads from the image on
+    // demand, so the model is deleted first)
+    delete adfsDirectoryModel;
+    adfsImage.clear();
+    discImage.clear();
+    adfsDirectoryModel = newAdfsDirectoryModel;
+    adfsImage = loadedAdfsImage;
+    discImage = loadedDiscImage;
+    discImageFilename = filename;
+
+    // The previous image's catalogue can no longer be searched
+    catalogue.clear();
+    nameIndex.clear();
+    clearSearch();
 
-    // Create the model and update the UI treeview
-    adfsDirectoryModel = new AdfsDirectoryModel(*discImage);
-    ui->treeView->setModel(adfsDirectoryModel);
     ui->treeView->setColumnWidth(0,200);    // Filename
     ui->treeView->setColumnWidth(1,50);     // Attr
     ui->treeView->setColumnWidth(2,50);     // Seq
@@ -132,7 +219,120 @@ void MainWindow::on_actionOpen_triggered()
     ui->treeView->setColumnWidth(6,50);     // Sector
 
     // Update the status bar
-    status->setText(tr("Disc image loaded"));
+    status->setText(tr("%1 disc image loaded - reading catalogue...").arg(discImage->getGeometry().getFormatName()));
+}
+
+// The loader has read a batch of directories
+void MainWindow::directoriesLoaded(qint64 loadId, QVector<AdfsDirectoryRecord> directoryRecords)
+{
+    if (loadId != currentLoadId || adfsDirectoryModel == nullptr) return;
+
+    adfsDirectoryModel->addDirectoryRecords(directoryRecords);
+}
+
+void MainWindow::loadProgressChanged(qint64 loadId, qint64 directoriesRead, qint64 directoriesFound)
+{
+    if (loadId != currentLoadId) return;
+
+    loadProgressBar->setRange(0, static_cast<int>(directoriesFound));
+    loadProgressBar->setValue(static_cast<int>(directoriesRead));
+}
+
+// The loader has scanned the whole catalogue; index it for searching
+void MainWindow::catalogueLoaded(qint64 loadId, AdfsCatalogue loadedCatalogue)
+{
+    if (loadId != currentLoadId || adfsDirectoryModel == nullptr) return;
+
+    catalogue = loadedCatalogue;
+    nameIndex.clear();
+    nameIndex.addCatalogue(catalogue);
+
+    // Search with any text entered whilst the catalogue was being scanned
+    clearSearch();
+    searchTextChanged(searchEdit->text());
+}
+
+void MainWindow::loadFinished(qint64 loadId, bool cancelled)
+{
+    if (loadId != currentLoadId) return;
+
+    showLoadProgress(false);
+
+    // Update the status bar (if the image could be opened)
+    if (adfsDirectoryModel == nullptr) return;
+    if (cancelled) status->setText(tr("Disc image loaded - catalogue scan cancelled"));
+    else status->setText(tr("Disc image loaded"));
+}
+
+// User clicked the cancel button whilst a disc image was loading
+void MainWindow::cancelLoad()
+{
+    discImageLoader->cancel(currentLoadId);
+}
+
+// Show or hide the disc image loading progress
+void MainWindow::showLoadProgress(bool visible)
+{
+    loadProgressBar->setVisible(visible);
+    cancelLoadButton->setVisible(visible);
+}
+
+// Search methods -----------------------------------------------------------------------------------------------------
+
+// Search the catalogue as the user types.  Text that extends the previous
+// search text can only match names that matched before, so just those names
+// are searched again
+void MainWindow::searchTextChanged(const QString &text)
+{
+    if (text.isEmpty() || nameIndex.getNumberOfNodes() == 0) {
+        clearSearch();
+        return;
+    }
+
+    QElapsedTimer searchTimer;
+    searchTimer.start();
+
+    QVector<qint32> names;
+    if (!previousSearchText.isEmpty() && text.contains(previousSearchText, Qt::CaseInsensitive)) {
+        names = nameIndex.refineNames(previousSearchNames, text);
+    } else {
+        names = nameIndex.findNames(text);
+    }
+    previousSearchText = text;
+    previousSearchNames = names;
+
+    QVector<AdfsNameMatch> matches = nameIndex.getMatches(names, maximumSearchResults);
+
+    searchResults->clear();
+    for (const AdfsNameMatch &match : matches) searchResults->addItem(catalogue.getNodePath(match.nodeNumber));
+    searchResults->setVisible(true);
+
+    if (matches.size() >= maximumSearchResults) {
+        statusBar()->showMessage(tr("First %1 matches (%2 ms)").arg(matches.size()).arg(searchTimer.elapsed()));
+    } else {
+        statusBar()->showMessage(tr("%1 matches (%2 ms)").arg(matches.size()).arg(searchTimer.elapsed()));
+    }
+}
+
+// User activated a search result; show it in the tree view
+void MainWindow::searchResultActivated(QListWidgetItem *item)
+{
+    if (adfsDirectoryModel == nullptr) return;
+
+    QModelIndex index = adfsDirectoryModel->findPath(item->text());
+    if (!index.isValid()) return;
+
+    ui->treeView->setCurrentIndex(index);
+    ui->treeView->scrollTo(index);
+}
+
+// Clear the search results
+void MainWindow::clearSearch()
+{
+    previousSearchText.clear();
+    previousSearchNames.clear();
+    searchResults->clear();
+    searchResults->setVisible(false);
 }
 
 // Model methods (Test) -----------------------------------------------------------------------------------------------
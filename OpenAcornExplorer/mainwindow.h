@@ -32,10 +32,20 @@
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QModelIndex>
+#include <QThread>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QSharedPointer>
 
 #include "aboutdialog.h"
 #include "discimage.h"
+#include "adfsimage.h"
 #include "adfsdirectorymodel.h"
+#include "adfscatalogue.h"
+#include "adfsnameindex.h"
+#include "discimageloader.h"
 
 namespace Ui {
 class MainWindow;
@@ -49,10 +59,26 @@ public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
 
+signals:
+    void loadRequested(qint64 loadId, QString filename);
+
 public slots:
     // Model slots
     void updateActions();
 
+    // Disc image loader slots
+    void imageOpened(qint64 loadId, bool valid, QString filename, QSharedPointer<DiscImage> loadedDiscImage,
+                     QSharedPointer<AdfsImage> loadedAdfsImage, AdfsDirectoryRecord rootDirectoryRecord);
+    void directoriesLoaded(qint64 loadId, QVector<AdfsDirectoryRecord> directoryRecords);
+    void loadProgressChanged(qint64 loadId, qint64 directoriesRead, qint64 directoriesFound);
+    void catalogueLoaded(qint64 loadId, AdfsCatalogue loadedCatalogue);
+    void loadFinished(qint64 loadId, bool cancelled);
+    void cancelLoad();
+
+    // Search slots
+    void searchTextChanged(const QString &text);
+    void searchResultActivated(QListWidgetItem *item);
+
 private slots:
     // Model slots
     void insertChild();
@@ -70,10 +96,31 @@ private:
     Ui::MainWindow *ui;
     AboutDialog *aboutDialog;
     QLabel *status;
+    QProgressBar *loadProgressBar;
+    QPushButton *cancelLoadButton;
     QString discImageFilename;
 
-    DiscImage *discImage;
+    // The disc image is shared with the loader whilst it scans the catalogue
+    QSharedPointer<DiscImage> discImage;
+    QSharedPointer<AdfsImage> adfsImage;
     AdfsDirectoryModel *adfsDirectoryModel;
+
+    // Disc images are opened and scanned by the loader on a worker thread
+    QThread *loaderThread;
+    DiscImageLoader *discImageLoader;
+    qint64 currentLoadId;
+
+    // Name search over the catalogue of the disc image (available once the
+    // loader has scanned the whole catalogue)
+    QLineEdit *searchEdit;
+    QListWidget *searchResults;
+    AdfsCatalogue catalogue;
+    AdfsNameIndex nameIndex;
+    QString previousSearchText;
+    QVector<qint32> previousSearchNames;
+
+    void showLoadProgress(bool visible);
+    void clearSearch();
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,168 @@
+/************************************************************************
+
+    tracerecorder.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "tracerecorder.h"
+#include "logcategories.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QThread>
+
+// Events recorded before further events are dropped (the counters include
+// every event)
+static const qint64 maximumEvents = 1 << 20;
+
+std::atomic<bool> TraceRecorder::enabled(false);
+
+// Recorded events and counters (keyed by the address of the event's name)
+static QMutex traceMutex;
+static QElapsedTimer traceTimer;
+static QVector<TraceEvent> traceEvents;
+static QHash<const char *, TracePhaseCounters> traceCounters;
+static qint64 droppedEvents = 0;
+
+// Start or stop tracing; timestamps are from when tracing was first started
+void TraceRecorder::setEnabled(bool enabledParam)
+{
+    QMutexLocker locker(&traceMutex);
+    if (enabledParam && !traceTimer.isValid()) traceTimer.start();
+
+    enabled.store(enabledParam, std::memory_order_relaxed);
+}
+
+void TraceRecorder::record(const TraceEvent &event)
+{
+    TraceEvent threadEvent = event;
+    threadEvent.threadId = reinterpret_cast<quint64>(QThread::currentThreadId());
+
+    QMutexLocker locker(&traceMutex);
+
+    TracePhaseCounters &counters = traceCounters[event.name];
+    if (counters.count == 0) {
+        counters.category = QString::fromLatin1(event.category);
+        counters.name = QString::fromLatin1(event.name);
+    }
+    counters.count++;
+    counters.totalNanoseconds += event.durationNanoseconds;
+    counters.maximumNanoseconds = qMax(counters.maximumNanoseconds, event.durationNanoseconds);
+    if (event.bytes > 0) counters.bytes += event.bytes;
+
+    if (traceEvents.size() < maximumEvents) traceEvents.append(threadEvent);
+    else droppedEvents++;
+}
+
+// Get the time since tracing was started in nanoseconds
+qint64 TraceRecorder::getTimestamp()
+{
+    return traceTimer.isValid() ? traceTimer.nsecsElapsed() : 0;
+}
+
+// Discard the recorded events and counters
+void TraceRecorder::clear()
+{
+    QMutexLocker locker(&traceMutex);
+    traceEvents.clear();
+    traceCounters.clear();
+    droppedEvents = 0;
+}
+
+qint64 TraceRecorder::getNumberOfEvents()
+{
+    QMutexLocker locker(&traceMutex);
+    return traceEvents.size();
+}
+
+qint64 TraceRecorder::getDroppedEvents()
+{
+    QMutexLocker locker(&traceMutex);
+    return droppedEvents;
+}
+
+// Get the counters of each phase, ordered by category and name (phases with
+// the same name are combined)
+QVector<TracePhaseCounters> TraceRecorder::getPhaseCounters()
+{
+    QMutexLocker locker(&traceMutex);
+
+    QMap<QString, TracePhaseCounters> phases;
+    for (const TracePhaseCounters &counters : traceCounters) {
+        TracePhaseCounters &phase = phases[counters.category + '/' + counters.name];
+        phase.category = counters.category;
+        phase.name = counters.name;
+        phase.count += counters.count;
+        phase.totalNanoseconds += counters.totalNanoseconds;
+        phase.maximumNanoseconds = qMax(phase.maximumNanoseconds, counters.maximumNanoseconds);
+        phase.bytes += counters.bytes;
+    }
+
+    return phases.values().toVector();
+}
+
+// Write the recorded events in the Chrome trace event format (complete events
+// with times in microseconds)
+bool TraceRecorder::writeChromeTrace(const QString &filename)
+{
+    QFile traceFile(filename);
+    if (!traceFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qCDebug(lcTrace) << "TraceRecorder::writeChromeTrace(): Cannot open" << filename;
+        return false;
+    }
+
+    QMutexLocker locker(&traceMutex);
+
+    // Number the threads in the order they were first seen
+    QHash<quint64, qint64> threadNumbers;
+
+    QByteArray line;
+    traceFile.write("{\"traceEvents\":[\n");
+    for (qint64 eventNumber = 0; eventNumber < traceEvents.size(); eventNumber++) {
+        const TraceEvent &event = traceEvents.at(eventNumber);
+        if (!threadNumbers.contains(event.threadId)) threadNumbers.insert(event.threadId, threadNumbers.size() + 1);
+
+        line = "{\"name\":\"" + QByteArray(event.name) + "\",\"cat\":\"" + QByteArray(event.category) +
+                "\",\"ph\":\"X\",\"ts\":" + QByteArray::number(event.startNanoseconds / 1000.0, 'f', 3) +
+                ",\"dur\":" + QByteArray::number(event.durationNanoseconds / 1000.0, 'f', 3) +
+                ",\"pid\":1,\"tid\":" + QByteArray::number(threadNumbers.value(event.threadId)) + ",\"args\":{";
+
+        QByteArray arguments;
+        if (event.sector >= 0) arguments += "\"sector\":" + QByteArray::number(event.sector);
+        if (event.bytePosition >= 0) arguments += QByteArray(arguments.isEmpty() ? "" : ",") + "\"bytePosition\":" + QByteArray::number(event.bytePosition);
+        if (event.bytes >= 0) arguments += QByteArray(arguments.isEmpty() ? "" : ",") + "\"bytes\":" + QByteArray::number(event.bytes);
+
+        line += arguments + "}}";
+        if (eventNumber + 1 < traceEvents.size()) line += ",";
+        line += "\n";
+
+        if (traceFile.write(line) != line.size()) return false;
+    }
+    traceFile.write("]}\n");
+
+    return true;
+}
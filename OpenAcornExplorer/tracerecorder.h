@@ -0,0 +1,120 @@
+/************************************************************************
+
+    tracerecorder.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QVector>
+
+#include <atomic>
+
+// A traced operation.  The name and category must be string literals (only the
+// pointers are kept); the sector, byte position and bytes are optional (-1 if
+// not known)
+struct TraceEvent
+{
+    const char *category = nullptr;
+    const char *name = nullptr;
+    qint64 startNanoseconds = 0;
+    qint64 durationNanoseconds = 0;
+    quint64 threadId = 0;
+    qint64 sector = -1;
+    qint64 bytePosition = -1;
+    qint64 bytes = -1;
+};
+
+// Counters aggregated over every traced operation with the same name
+struct TracePhaseCounters
+{
+    QString category;
+    QString name;
+    qint64 count = 0;
+    qint64 totalNanoseconds = 0;
+    qint64 maximumNanoseconds = 0;
+    qint64 bytes = 0;
+};
+
+// Records the time taken by traced operations (disc image reads, map and
+// directory parsing, catalogue and model building) across all threads.  The
+// recorded events can be written as a Chrome trace (for chrome://tracing or
+// Perfetto) and are aggregated into per-phase counters.  Tracing is disabled
+// by default, when a trace scope costs a single relaxed atomic load
+class TraceRecorder
+{
+public:
+    static void setEnabled(bool enabled);
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    static void record(const TraceEvent &event);
+    static qint64 getTimestamp();
+    static void clear();
+
+    static qint64 getNumberOfEvents();
+    static qint64 getDroppedEvents();
+    static QVector<TracePhaseCounters> getPhaseCounters();
+    static bool writeChromeTrace(const QString &filename);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+// Traces the lifetime of a scope as an operation
+class TraceScope
+{
+public:
+    TraceScope(const char *category, const char *name)
+    {
+        active = TraceRecorder::isEnabled();
+        if (!active) return;
+
+        event.category = category;
+        event.name = name;
+        event.startNanoseconds = TraceRecorder::getTimestamp();
+    }
+
+    ~TraceScope()
+    {
+        if (!active) return;
+
+        event.durationNanoseconds = TraceRecorder::getTimestamp() - event.startNanoseconds;
+        TraceRecorder::record(event);
+    }
+
+    void setSector(qint64 sector) { event.sector = sector; }
+    void setBytePosition(qint64 bytePosition) { event.bytePosition = bytePosition; }
+    void setBytes(qint64 bytes) { event.bytes = bytes; }
+
+private:
+    Q_DISABLE_COPY(TraceScope)
+
+    bool active;
+    TraceEvent event;
+};
+
+#endif // TRACERECORDER_H
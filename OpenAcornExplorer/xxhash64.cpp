@@ -0,0 +1,176 @@
+/************************************************************************
+
+    xxhash64.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+#include "xxhash64.h"
+
+#include <QtEndian>
+
+#include <cstring>
+
+static const quint64 prime1 = Q_UINT64_C(11400714785074694791);
+static const quint64 prime2 = Q_UINT64_C(14029467366897019727);
+static const quint64 prime3 = Q_UINT64_C(1609587929392839161);
+static const quint64 prime4 = Q_UINT64_C(9650029242287828579);
+static const quint64 prime5 = Q_UINT64_C(2870177450012600261);
+
+static inline quint64 rotateLeft(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline quint64 read64(const uchar *data)
+{
+    return qFromLittleEndian<quint64>(data);
+}
+
+static inline quint64 read32(const uchar *data)
+{
+    return qFromLittleEndian<quint32>(data);
+}
+
+static inline quint64 hashRound(quint64 accumulator, quint64 input)
+{
+    accumulator += input * prime2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * prime1;
+}
+
+static inline quint64 mergeRound(quint64 accumulator, quint64 lane)
+{
+    accumulator ^= hashRound(0, lane);
+    return (accumulator * prime1) + prime4;
+}
+
+XxHash64::XxHash64(quint64 seedParam)
+{
+    seed = seedParam;
+    reset();
+}
+
+// Start a new hash
+void XxHash64::reset()
+{
+    lanes[0] = seed + prime1 + prime2;
+    lanes[1] = seed + prime2;
+    lanes[2] = seed;
+    lanes[3] = seed - prime1;
+    totalLength = 0;
+    stripeLength = 0;
+}
+
+// Add data to the hash
+void XxHash64::addData(const char *data, qint64 length)
+{
+    const uchar *input = reinterpret_cast<const uchar *>(data);
+    totalLength += static_cast<quint64>(length);
+
+    // Complete a partial stripe first
+    if (stripeLength > 0) {
+        qint64 stripeBytes = qMin(length, static_cast<qint64>(32) - stripeLength);
+        memcpy(stripe + stripeLength, input, static_cast<size_t>(stripeBytes));
+        stripeLength += stripeBytes;
+        input += stripeBytes;
+        length -= stripeBytes;
+
+        if (stripeLength < 32) return;
+        addStripes(stripe, 1);
+        stripeLength = 0;
+    }
+
+    // Hash whole stripes directly from the input and keep the remainder
+    addStripes(input, length / 32);
+    stripeLength = length % 32;
+    memcpy(stripe, input + (length - stripeLength), static_cast<size_t>(stripeLength));
+}
+
+// Get the hash of the data added so far
+quint64 XxHash64::result() const
+{
+    quint64 hash;
+    if (totalLength >= 32) {
+        hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) + rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+        for (qint64 lane = 0; lane < 4; lane++) hash = mergeRound(hash, lanes[lane]);
+    } else {
+        hash = seed + prime5;
+    }
+    hash += totalLength;
+
+    // Hash the remaining input (less than a stripe)
+    const uchar *input = stripe;
+    const uchar *end = stripe + stripeLength;
+    for (; input + 8 <= end; input += 8) {
+        hash ^= hashRound(0, read64(input));
+        hash = (rotateLeft(hash, 27) * prime1) + prime4;
+    }
+    if (input + 4 <= end) {
+        hash ^= read32(input) * prime1;
+        hash = (rotateLeft(hash, 23) * prime2) + prime3;
+        input += 4;
+    }
+    for (; input < end; input++) {
+        hash ^= (*input) * prime5;
+        hash = rotateLeft(hash, 11) * prime1;
+    }
+
+    // Avalanche
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+// Hash a block of data in one call
+quint64 XxHash64::hash(const char *data, qint64 length, quint64 seed)
+{
+    XxHash64 xxHash64(seed);
+    xxHash64.addData(data, length);
+
+    return xxHash64.result();
+}
+
+// Private methods
+
+// Hash whole 32 byte stripes; the four lanes are independent so the compiler
+// can interleave (and vectorise) their multiplies
+void XxHash64::addStripes(const uchar *data, qint64 numberOfStripes)
+{
+    quint64 lane0 = lanes[0], lane1 = lanes[1], lane2 = lanes[2], lane3 = lanes[3];
+
+    for (qint64 stripeNumber = 0; stripeNumber < numberOfStripes; stripeNumber++, data += 32) {
+        lane0 = hashRound(lane0, read64(data));
+        lane1 = hashRound(lane1, read64(data + 8));
+        lane2 = hashRound(lane2, read64(data + 16));
+        lane3 = hashRound(lane3, read64(data + 24));
+    }
+
+    lanes[0] = lane0;
+    lanes[1] = lane1;
+    lanes[2] = lane2;
+    lanes[3] = lane3;
+}
@@ -0,0 +1,59 @@
+/************************************************************************
+
+    xxhash64.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+#ifndef XXHASH64_H
+#define XXHASH64_H
+
+#include <QCoreApplication>
+
+// Streaming XXH64 hash (the 64-bit xxHash algorithm by Yann Collet).  Data is
+// consumed 32 bytes at a time in four independent 64-bit lanes, so the hash
+// runs at close to memory bandwidth; the result matches the reference
+// implementation for any split of the data between addData() calls
+class XxHash64
+{
+public:
+    XxHash64(quint64 seedParam = 0);
+
+    void reset();
+    void addData(const char *data, qint64 length);
+    quint64 result() const;
+
+    static quint64 hash(const char *data, qint64 length, quint64 seed = 0);
+
+private:
+    quint64 seed;
+    quint64 lanes[4];
+    quint64 totalLength;
+
+    // Input waiting for a complete 32 byte stripe
+    uchar stripe[32];
+    qint64 stripeLength;
+
+    void addStripes(const uchar *data, qint64 numberOfStripes);
+};
+
+#endif // XXHASH64_H
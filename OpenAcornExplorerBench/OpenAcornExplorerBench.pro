@@ -0,0 +1,31 @@
+#-------------------------------------------------
+#
+# OpenAcornExplorer core parsing benchmarks
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TARGET = oaebench
+TEMPLATE = app
+
+# The following define makes your compiler emit warnings if you use
+# any feature of Qt which has been marked as deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../OpenAcornExplorer/core.pri)
+
+SOURCES += \
+        main.cpp \
+    corebenchmark.cpp \
+    allocationcounter.cpp
+
+HEADERS += \
+    corebenchmark.h \
+    allocationcounter.h
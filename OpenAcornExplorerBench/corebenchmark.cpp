@@ -0,0 +1,177 @@
+/************************************************************************
+
+    corebenchmark.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "corebenchmark.h"
+#include "allocationcounter.h"
+#include "adfsimage.h"
+#include "adfscatalogue.h"
+#include "adfscataloguescanner.h"
+
+#include <QElapsedTimer>
+#include <QFileInfo>
+
+CoreBenchmark::CoreBenchmark(qint64 minimumMillisecondsParam)
+{
+    minimumMilliseconds = minimumMillisecondsParam;
+}
+
+// Run all of the benchmarks on a disc image
+// Note: The file system benchmarks need a valid ADFS old map image; for any
+// other image only the open benchmark is run and getSkipReason() says why
+QVector<CoreBenchmarkResult> CoreBenchmark::run(const QString &filename, DiscImage::AccessMode accessMode)
+{
+    QVector<CoreBenchmarkResult> results;
+    skipReason.clear();
+
+    results.append(measure("open", filename, accessMode, [&](qint64 iterations, DiscImageIoStatistics *ioStatistics) {
+        for (qint64 iteration = 0; iteration < iterations; iteration++) {
+            DiscImage discImage(filename, accessMode);
+            if (!discImage.isValid()) return false;
+
+            DiscImageIoStatistics openStatistics = discImage.getIoStatistics();
+            ioStatistics->sectorsRead += openStatistics.sectorsRead;
+            ioStatistics->systemCalls += openStatistics.systemCalls;
+        }
+        return true;
+    }));
+
+    // The remaining benchmarks share one open disc image
+    DiscImage discImage(filename, accessMode);
+    if (!discImage.isValid()) {
+        skipReason = "Cannot open disc image";
+        return results;
+    }
+
+    AdfsImage adfsImage(&discImage);
+    if (!adfsImage.isValid()) {
+        skipReason = "Not an ADFS image";
+        return results;
+    }
+
+    results.append(measure("fsm", filename, accessMode, [&](qint64 iterations, DiscImageIoStatistics *ioStatistics) {
+        discImage.resetIoStatistics();
+        for (qint64 iteration = 0; iteration < iterations; iteration++) {
+            AdfsImage benchmarkImage(&discImage);
+            if (!benchmarkImage.isValid()) return false;
+        }
+        *ioStatistics = discImage.getIoStatistics();
+        return true;
+    }));
+
+    results.append(measure("rootdir", filename, accessMode, [&](qint64 iterations, DiscImageIoStatistics *ioStatistics) {
+        discImage.resetIoStatistics();
+        for (qint64 iteration = 0; iteration < iterations; iteration++) {
+            AdfsDirectoryRecord rootRecord;
+            if (!adfsImage.readDirectoryRecord(adfsImage.getRootDirectorySector(), &rootRecord)) return false;
+        }
+        *ioStatistics = discImage.getIoStatistics();
+        return true;
+    }));
+
+    results.append(measure("traverse", filename, accessMode, [&](qint64 iterations, DiscImageIoStatistics *ioStatistics) {
+        discImage.resetIoStatistics();
+        for (qint64 iteration = 0; iteration < iterations; iteration++) {
+            AdfsCatalogue catalogue;
+            AdfsCatalogueScanner scanner(&adfsImage);
+            scanner.setMaximumThreads(1);
+            if (!scanner.scan(&catalogue)) return false;
+        }
+        *ioStatistics = discImage.getIoStatistics();
+        return true;
+    }));
+
+    results.append(measure("ptraverse", filename, accessMode, [&](qint64 iterations, DiscImageIoStatistics *ioStatistics) {
+        discImage.resetIoStatistics();
+        for (qint64 iteration = 0; iteration < iterations; iteration++) {
+            AdfsCatalogue catalogue;
+            AdfsCatalogueScanner scanner(&adfsImage);
+            if (!scanner.scan(&catalogue)) return false;
+        }
+        *ioStatistics = discImage.getIoStatistics();
+        return true;
+    }));
+
+    return results;
+}
+
+// Get the reason the file system benchmarks were not run on the last image
+QString CoreBenchmark::getSkipReason()
+{
+    return skipReason;
+}
+
+// Private methods
+
+// Measure an operation, increasing the number of iterations until the run
+// takes at least the minimum time.  If the operation fails the result is only
+// marked as failed, as the time of a partial run is meaningless
+CoreBenchmarkResult CoreBenchmark::measure(const QString &benchmark, const QString &filename,
+                                           DiscImage::AccessMode accessMode, Operation operation)
+{
+    CoreBenchmarkResult result;
+    result.benchmark = benchmark;
+    result.image = QFileInfo(filename).fileName();
+    result.access = (accessMode == DiscImage::MappedAccess) ? "mapped" : "file";
+
+    // Warm up (so the image is in the operating system's file cache)
+    DiscImageIoStatistics warmUpStatistics;
+    if (!operation(1, &warmUpStatistics)) {
+        result.failed = true;
+        return result;
+    }
+
+    qint64 iterations = 1;
+    QElapsedTimer timer;
+
+    while (true) {
+        qint64 allocationsBefore = AllocationCounter::getAllocations();
+        timer.start();
+        DiscImageIoStatistics ioStatistics;
+        bool success = operation(iterations, &ioStatistics);
+        qint64 elapsedNanoseconds = timer.nsecsElapsed();
+        qint64 allocations = AllocationCounter::getAllocations() - allocationsBefore;
+
+        if (!success) {
+            result.iterations = iterations;
+            result.failed = true;
+            break;
+        }
+
+        if (elapsedNanoseconds >= minimumMilliseconds * 1000000 || iterations >= (Q_INT64_C(1) << 30)) {
+            result.iterations = iterations;
+            result.nanosecondsPerOperation = static_cast<double>(elapsedNanoseconds) / iterations;
+            result.sectorsPerOperation = static_cast<double>(ioStatistics.sectorsRead) / iterations;
+            result.systemCallsPerOperation = static_cast<double>(ioStatistics.systemCalls) / iterations;
+            result.allocationsPerOperation = static_cast<double>(allocations) / iterations;
+            break;
+        }
+
+        iterations *= 2;
+    }
+
+    return result;
+}
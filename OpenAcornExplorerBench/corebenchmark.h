@@ -0,0 +1,84 @@
+/************************************************************************
+
+    corebenchmark.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef COREBENCHMARK_H
+#define COREBENCHMARK_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QVector>
+
+#include <functional>
+
+#include "discimage.h"
+
+// The result of a benchmark on one disc image with one access mode.  All of
+// the measurements are averages per operation
+struct CoreBenchmarkResult
+{
+    QString benchmark;
+    QString image;
+    QString access;
+    qint64 iterations = 0;
+    bool failed = false;                    // An operation failed, so there are no measurements
+    double nanosecondsPerOperation = 0;
+    double sectorsPerOperation = 0;         // Sectors read from the image file
+    double systemCallsPerOperation = 0;     // Seeks and reads of the image file
+    double allocationsPerOperation = 0;     // Heap allocations (see AllocationCounter)
+};
+
+// Benchmarks the core disc image parsing operations on a disc image:
+//
+//   open      - Open (and map) the disc image and close it again
+//   fsm       - Read and validate the free space map
+//   rootdir   - Read and decode the root directory
+//   traverse  - Read the whole catalogue (on a single thread)
+//   ptraverse - Read the whole catalogue (on every core)
+//
+// Each benchmark is repeated, doubling the number of iterations, until a run
+// takes at least the minimum time; the results are from that final run
+class CoreBenchmark
+{
+public:
+    CoreBenchmark(qint64 minimumMillisecondsParam);
+
+    QVector<CoreBenchmarkResult> run(const QString &filename, DiscImage::AccessMode accessMode);
+    QString getSkipReason();
+
+private:
+    // Performs a number of iterations of an operation, accumulating the I/O
+    // statistics.  Returns false if any iteration failed
+    typedef std::function<bool(qint64 iterations, DiscImageIoStatistics *ioStatistics)> Operation;
+
+    qint64 minimumMilliseconds;
+    QString skipReason;
+
+    CoreBenchmarkResult measure(const QString &benchmark, const QString &filename,
+                                DiscImage::AccessMode accessMode, Operation operation);
+};
+
+#endif // COREBENCHMARK_H
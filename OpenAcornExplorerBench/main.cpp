@@ -0,0 +1,129 @@
+/************************************************************************
+
+    main.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QTextStream>
+
+#include "corebenchmark.h"
+
+// Version of the output format; increase it if the columns change so that
+// results from different releases are only compared when they match
+static const qint64 outputFormatVersion = 1;
+
+// Debug output from the core classes would interleave with the results
+static void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    Q_UNUSED(context);
+
+    if (type == QtDebugMsg) return;
+    fprintf(stderr, "%s\n", message.toLocal8Bit().constData());
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("oaebench");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    qInstallMessageHandler(messageHandler);
+
+    // Define the command line
+    QCommandLineParser parser;
+    parser.setApplicationDescription("OpenAcornExplorer core parsing benchmarks.  Benchmarks every .adf and .adl "
+                                     "image in a directory and writes the results as tab separated values.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("directory", "Directory of disc images (default 'ADFS Test images')", "[directory]");
+
+    QCommandLineOption minimumTimeOption(QStringList() << "t" << "min-time",
+                                         "Minimum time to run each benchmark for (default 200)", "milliseconds", "200");
+    QCommandLineOption filterOption(QStringList() << "b" << "benchmark",
+                                    "Only report the named benchmark (open, fsm, rootdir, traverse or ptraverse)", "name");
+    parser.addOption(minimumTimeOption);
+    parser.addOption(filterOption);
+
+    parser.process(a);
+
+    QString directoryName = "ADFS Test images";
+    if (!parser.positionalArguments().isEmpty()) directoryName = parser.positionalArguments().first();
+
+    QDir directory(directoryName);
+    QStringList images = directory.entryList(QStringList() << "*.adf" << "*.adl", QDir::Files, QDir::Name);
+    if (images.isEmpty()) {
+        fprintf(stderr, "oaebench: No disc images found in '%s'\n", directoryName.toLocal8Bit().constData());
+        return 1;
+    }
+
+    bool minimumTimeValid = false;
+    qint64 minimumTime = parser.value(minimumTimeOption).toLongLong(&minimumTimeValid);
+    if (!minimumTimeValid || minimumTime < 1) {
+        fprintf(stderr, "oaebench: Invalid minimum time\n");
+        return 1;
+    }
+
+    // Benchmark each image with each access mode, writing the results as they
+    // are produced.  Lines starting with '#' are comments
+    QTextStream output(stdout);
+    output << "# oaebench format " << outputFormatVersion << "\n";
+    output << "# benchmark\timage\taccess\titerations\tns_per_op\tsectors_per_op\tsyscalls_per_op\tallocations_per_op\n";
+    output.flush();
+
+    CoreBenchmark coreBenchmark(minimumTime);
+    QList<DiscImage::AccessMode> accessModes = QList<DiscImage::AccessMode>() << DiscImage::FileAccess << DiscImage::MappedAccess;
+
+    for (const QString &image : images) {
+        for (DiscImage::AccessMode accessMode : accessModes) {
+            QVector<CoreBenchmarkResult> results = coreBenchmark.run(directory.filePath(image), accessMode);
+
+            for (const CoreBenchmarkResult &result : results) {
+                if (parser.isSet(filterOption) && result.benchmark != parser.value(filterOption)) continue;
+
+                if (result.failed) {
+                    output << "# failed\t" << result.benchmark << "\t" << result.image << "\t" << result.access << "\n";
+                    continue;
+                }
+
+                output << result.benchmark << "\t" << result.image << "\t" << result.access << "\t"
+                       << result.iterations << "\t"
+                       << QString::number(result.nanosecondsPerOperation, 'f', 1) << "\t"
+                       << QString::number(result.sectorsPerOperation, 'f', 2) << "\t"
+                       << QString::number(result.systemCallsPerOperation, 'f', 2) << "\t"
+                       << QString::number(result.allocationsPerOperation, 'f', 2) << "\n";
+            }
+
+            if (!coreBenchmark.getSkipReason().isEmpty()) {
+                output << "# skipped\t" << image << "\t" << results.first().access << "\t"
+                       << coreBenchmark.getSkipReason() << "\n";
+            }
+            output.flush();
+        }
+    }
+
+    return 0;
+}
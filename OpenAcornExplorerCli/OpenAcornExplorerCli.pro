@@ -0,0 +1,33 @@
+#-------------------------------------------------
+#
+# OpenAcornExplorer command line tool
+#
+#-------------------------------------------------
+
+QT       += core concurrent
+QT       -= gui
+
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TARGET = oaecli
+TEMPLATE = app
+
+# The following define makes your compiler emit warnings if you use
+# any feature of Qt which has been marked as deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../OpenAcornExplorer/core.pri)
+
+SOURCES += \
+        main.cpp \
+    cliimagereport.cpp \
+    cliduplicatereport.cpp \
+    cliimagediff.cpp
+
+HEADERS += \
+    cliimagereport.h \
+    cliduplicatereport.h \
+    cliimagediff.h
@@ -0,0 +1,108 @@
+/************************************************************************
+
+    cliduplicatereport.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+#include "cliduplicatereport.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+CliDuplicateReport::CliDuplicateReport()
+{
+}
+
+// Add the hash of a whole image
+void CliDuplicateReport::addImage(const QString &filename, const AdfsContentHash &imageHash)
+{
+    QString key = getHashKey(imageHash);
+
+    QMutexLocker locker(&reportMutex);
+    if (!images.contains(key)) imageKeys.append(key);
+    images[key].append({filename, QString()});
+}
+
+// Add the hash of a file on an image
+void CliDuplicateReport::addFile(const QString &filename, const QString &path, const AdfsContentHash &fileHash)
+{
+    QString key = getHashKey(fileHash);
+
+    QMutexLocker locker(&reportMutex);
+    if (!files.contains(key)) fileKeys.append(key);
+    files[key].append({filename, path});
+}
+
+// Append a line for each set of identical images, then each set of identical files
+void CliDuplicateReport::appendReport(QByteArray *output)
+{
+    QMutexLocker locker(&reportMutex);
+
+    appendDuplicates("images", imageKeys, images, output);
+    appendDuplicates("files", fileKeys, files, output);
+}
+
+// Get the key identifying some contents: the length and XXH64 hash, and the
+// SHA-256 hash if there is one
+QString CliDuplicateReport::getHashKey(const AdfsContentHash &contentHash)
+{
+    return QString("%1:%2:%3").arg(contentHash.length)
+            .arg(contentHash.xxHash64, 16, 16, QChar('0'))
+            .arg(QString::fromLatin1(contentHash.sha256.toHex()));
+}
+
+// Private methods
+
+void CliDuplicateReport::appendDuplicates(const QString &type, const QVector<QString> &keys,
+                                          const QHash<QString, QVector<ContentCopy> > &copies, QByteArray *output)
+{
+    for (const QString &key : keys) {
+        const QVector<ContentCopy> contentCopies = copies.value(key);
+        if (contentCopies.size() < 2) continue;
+
+        QJsonArray copyArray;
+        for (const ContentCopy &contentCopy : contentCopies) {
+            if (contentCopy.path.isEmpty()) {
+                copyArray.append(contentCopy.image);
+            } else {
+                QJsonObject copyObject;
+                copyObject.insert("image", contentCopy.image);
+                copyObject.insert("path", contentCopy.path);
+                copyArray.append(copyObject);
+            }
+        }
+
+        QStringList keyParts = key.split(':');
+
+        QJsonObject object;
+        object.insert("duplicate", type);
+        object.insert("length", keyParts.at(0).toLongLong());
+        object.insert("xxh64", keyParts.at(1));
+        if (!keyParts.at(2).isEmpty()) object.insert("sha256", keyParts.at(2));
+        object.insert("copies", copyArray);
+
+        output->append(QJsonDocument(object).toJson(QJsonDocument::Compact));
+        output->append('\n');
+    }
+}
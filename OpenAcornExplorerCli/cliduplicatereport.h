@@ -0,0 +1,72 @@
+/************************************************************************
+
+    cliduplicatereport.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+#ifndef CLIDUPLICATEREPORT_H
+#define CLIDUPLICATEREPORT_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include "adfsfilehasher.h"
+
+// Collects the content hashes of the images (and the files on them) processed
+// by the command line tool and reports the identical images and files across
+// all of them.  Images are added from the worker threads as they are hashed
+class CliDuplicateReport
+{
+public:
+    CliDuplicateReport();
+
+    void addImage(const QString &filename, const AdfsContentHash &imageHash);
+    void addFile(const QString &filename, const QString &path, const AdfsContentHash &fileHash);
+    void appendReport(QByteArray *output);
+
+    static QString getHashKey(const AdfsContentHash &contentHash);
+
+private:
+    // A copy of some contents (an image, or a file on an image)
+    struct ContentCopy
+    {
+        QString image;
+        QString path;       // Empty for a whole image
+    };
+
+    // Content hash key -> the copies with that content, and the key order first seen
+    QHash<QString, QVector<ContentCopy> > images;
+    QHash<QString, QVector<ContentCopy> > files;
+    QVector<QString> imageKeys;
+    QVector<QString> fileKeys;
+
+    QMutex reportMutex;
+
+    void appendDuplicates(const QString &type, const QVector<QString> &keys, const QHash<QString, QVector<ContentCopy> > &copies,
+                          QByteArray *output);
+};
+
+#endif // CLIDUPLICATEREPORT_H
@@ -0,0 +1,245 @@
+/************************************************************************
+
+    cliimagediff.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+#include "cliimagediff.h"
+#include "cliimagereport.h"
+#include "adfscataloguescanner.h"
+#include "discimageprober.h"
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+CliImageDiff::CliImageDiff()
+{
+    identical = false;
+}
+
+// Compare two images; returns false if either image could not be read
+// Note: The catalogues are only read if the images are not identical
+bool CliImageDiff::process(const QString &oldFilename, const QString &newFilename, QByteArray *output)
+{
+    identical = false;
+
+    QScopedPointer<DiscImage> oldDiscImage;
+    QScopedPointer<AdfsImage> oldImage;
+    QScopedPointer<DiscImage> newDiscImage;
+    QScopedPointer<AdfsImage> newImage;
+    if (!openImage(oldFilename, &oldDiscImage, &oldImage, output)) return false;
+    if (!openImage(newFilename, &newDiscImage, &newImage, output)) return false;
+
+    AdfsImageComparer comparer(oldImage.data(), newImage.data());
+
+    QElapsedTimer compareTimer;
+    compareTimer.start();
+    if (!comparer.compareSectors()) {
+        appendError(newFilename, "Cannot read the disc images", output);
+        return false;
+    }
+    qint64 compareNanoseconds = compareTimer.nsecsElapsed();
+
+    identical = comparer.isIdentical();
+    if (!identical) {
+        AdfsCatalogue oldCatalogue;
+        AdfsCatalogue newCatalogue;
+        if (!readCatalogue(oldImage.data(), &oldCatalogue)) {
+            appendError(oldFilename, "Cannot read the root directory", output);
+            return false;
+        }
+        if (!readCatalogue(newImage.data(), &newCatalogue)) {
+            appendError(newFilename, "Cannot read the root directory", output);
+            return false;
+        }
+
+        comparer.compareCatalogues(oldCatalogue, newCatalogue);
+        for (const AdfsCatalogueChange &change : comparer.getChanges()) {
+            appendChange(change, oldCatalogue, newCatalogue, output);
+        }
+    }
+
+    appendSummary(oldFilename, newFilename, comparer, compareNanoseconds, output);
+    return true;
+}
+
+bool CliImageDiff::isIdentical() const
+{
+    return identical;
+}
+
+// Private methods
+
+bool CliImageDiff::openImage(const QString &filename, QScopedPointer<DiscImage> *discImage, QScopedPointer<AdfsImage> *adfsImage,
+                             QByteArray *output) const
+{
+    DiscImageProber discImageProber;
+    if (!discImageProber.probe(filename)) {
+        appendError(filename, "Cannot read disc image", output);
+        return false;
+    }
+
+    discImage->reset(new DiscImage(filename, DiscImage::MappedAccess, discImageProber.getBestFormat()));
+    if (!(*discImage)->isValid()) {
+        appendError(filename, "Cannot open disc image", output);
+        return false;
+    }
+
+    adfsImage->reset(new AdfsImage(discImage->data()));
+    if (!(*adfsImage)->isValid()) {
+        appendError(filename, "Disc image does not contain a valid ADFS free space map", output);
+        return false;
+    }
+
+    return true;
+}
+
+// Read the whole catalogue of an image (on all cores, as only one image is read
+// at a time)
+bool CliImageDiff::readCatalogue(AdfsImage *adfsImage, AdfsCatalogue *catalogue) const
+{
+    AdfsCatalogueScanner scanner(adfsImage);
+
+    return scanner.scan(catalogue);
+}
+
+// Append a line for a file or directory that was added, removed or changed,
+// with its entries in the old and new images
+void CliImageDiff::appendChange(const AdfsCatalogueChange &change, const AdfsCatalogue &oldCatalogue, const AdfsCatalogue &newCatalogue,
+                                QByteArray *output) const
+{
+    static const struct {
+        AdfsCatalogueChange::Field field;
+        const char *name;
+    } fieldNames[] = {
+        { AdfsCatalogueChange::Content, "content" },
+        { AdfsCatalogueChange::Length, "length" },
+        { AdfsCatalogueChange::LoadAddress, "load" },
+        { AdfsCatalogueChange::ExecutionAddress, "exec" },
+        { AdfsCatalogueChange::Attributes, "attributes" },
+        { AdfsCatalogueChange::Moved, "sector" }
+    };
+
+    QJsonObject object;
+    object.insert("path", change.path);
+    object.insert("type", change.directory ? "directory" : "file");
+
+    switch (change.type) {
+    case AdfsCatalogueChange::Added:
+        object.insert("change", QString("added"));
+        break;
+    case AdfsCatalogueChange::Removed:
+        object.insert("change", QString("removed"));
+        break;
+    case AdfsCatalogueChange::Changed:
+        object.insert("change", QString("changed"));
+
+        QJsonArray changedFields;
+        for (const auto &fieldName : fieldNames) {
+            if (change.changedFields & fieldName.field) changedFields.append(QString(fieldName.name));
+        }
+        object.insert("fields", changedFields);
+        break;
+    }
+
+    if (change.oldNodeNumber >= 0) object.insert("old", getEntryObject(oldCatalogue.getNode(change.oldNodeNumber).entry));
+    if (change.newNodeNumber >= 0) object.insert("new", getEntryObject(newCatalogue.getNode(change.newNodeNumber).entry));
+
+    appendJsonLine(object, output);
+}
+
+// Append the summary line, with the runs of changed sectors
+void CliImageDiff::appendSummary(const QString &oldFilename, const QString &newFilename, const AdfsImageComparer &comparer,
+                                 qint64 compareNanoseconds, QByteArray *output) const
+{
+    qint64 added = 0;
+    qint64 removed = 0;
+    qint64 changed = 0;
+    for (const AdfsCatalogueChange &change : comparer.getChanges()) {
+        if (change.type == AdfsCatalogueChange::Added) added++;
+        else if (change.type == AdfsCatalogueChange::Removed) removed++;
+        else changed++;
+    }
+
+    QJsonObject object;
+    object.insert("old", oldFilename);
+    object.insert("new", newFilename);
+    object.insert("identical", identical);
+    object.insert("sectorComparison", comparer.isSectorComparable());
+
+    if (comparer.isSectorComparable()) {
+        QJsonArray changedRegions;
+        for (const DiscSectorRange &range : comparer.getChangedSectors()) {
+            QJsonObject region;
+            region.insert("sector", range.startSector);
+            region.insert("sectors", range.numberOfSectors);
+            changedRegions.append(region);
+        }
+
+        object.insert("sectorSize", comparer.getSectorSize());
+        object.insert("changedSectors", comparer.getNumberOfChangedSectors());
+        object.insert("changedRegions", changedRegions);
+        // Unknown (null) if the sectors of some files or directories could not be found
+        if (comparer.getUnownedChangedSectors() < 0) object.insert("unownedChangedSectors", QJsonValue());
+        else object.insert("unownedChangedSectors", comparer.getUnownedChangedSectors());
+    }
+
+    object.insert("added", added);
+    object.insert("removed", removed);
+    object.insert("changed", changed);
+    object.insert("unresolved", comparer.getUnresolvedObjects());
+    object.insert("compareMicroseconds", compareNanoseconds / 1000);
+
+    appendJsonLine(object, output);
+}
+
+QJsonObject CliImageDiff::getEntryObject(const AdfsDirectoryEntry &entry) const
+{
+    QJsonObject object;
+    object.insert("attributes", entry.getAttributeString());
+    object.insert("sector", static_cast<qint64>(entry.startSector));
+
+    if (!entry.isDirectory()) {
+        object.insert("load", static_cast<qint64>(entry.loadAddress));
+        object.insert("exec", static_cast<qint64>(entry.executionAddress));
+        object.insert("length", static_cast<qint64>(entry.length));
+    }
+
+    return object;
+}
+
+// Append a line reporting that an image could not be processed
+void CliImageDiff::appendError(const QString &filename, const QString &error, QByteArray *output) const
+{
+    QJsonObject object;
+    object.insert("image", filename);
+    object.insert("error", error);
+    appendJsonLine(object, output);
+}
+
+void CliImageDiff::appendJsonLine(const QJsonObject &object, QByteArray *output) const
+{
+    output->append(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    output->append('\n');
+}
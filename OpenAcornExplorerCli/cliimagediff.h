@@ -0,0 +1,66 @@
+/************************************************************************
+
+    cliimagediff.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+#ifndef CLIIMAGEDIFF_H
+#define CLIIMAGEDIFF_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonObject>
+#include <QScopedPointer>
+
+#include "discimage.h"
+#include "adfsimage.h"
+#include "adfscatalogue.h"
+#include "adfsimagecomparer.h"
+
+// Produces the JSON lines output of the command line tool's diff command: a
+// line per file or directory added, removed or changed between two images,
+// then a summary of the sectors that changed
+class CliImageDiff
+{
+public:
+    CliImageDiff();
+
+    bool process(const QString &oldFilename, const QString &newFilename, QByteArray *output);
+    bool isIdentical() const;
+
+private:
+    bool identical;
+
+    bool openImage(const QString &filename, QScopedPointer<DiscImage> *discImage, QScopedPointer<AdfsImage> *adfsImage,
+                   QByteArray *output) const;
+    bool readCatalogue(AdfsImage *adfsImage, AdfsCatalogue *catalogue) const;
+    void appendChange(const AdfsCatalogueChange &change, const AdfsCatalogue &oldCatalogue, const AdfsCatalogue &newCatalogue,
+                      QByteArray *output) const;
+    void appendSummary(const QString &oldFilename, const QString &newFilename, const AdfsImageComparer &comparer,
+                       qint64 compareNanoseconds, QByteArray *output) const;
+    QJsonObject getEntryObject(const AdfsDirectoryEntry &entry) const;
+    void appendError(const QString &filename, const QString &error, QByteArray *output) const;
+    void appendJsonLine(const QJsonObject &object, QByteArray *output) const;
+};
+
+#endif // CLIIMAGEDIFF_H
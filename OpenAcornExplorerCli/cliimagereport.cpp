@@ -0,0 +1,501 @@
+/************************************************************************
+
+    cliimagereport.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "cliimagereport.h"
+#include "adfscataloguescanner.h"
+#include "adfsfreespaceindex.h"
+#include "adfsfileextractor.h"
+#include "adfspathindex.h"
+#include "adfsfilehasher.h"
+#include "adfsimagechecker.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSet>
+
+CliImageReport::CliImageReport(Command commandParam, bool recursiveParam)
+{
+    command = commandParam;
+    recursive = recursiveParam;
+    sha256Enabled = false;
+    duplicateReport = nullptr;
+    scanThreads = 1;
+}
+
+// Set the directory images are extracted to; each image is extracted into a
+// sub-directory named after the image file
+void CliImageReport::setOutputDirectory(const QString &outputDirectoryParam)
+{
+    outputDirectory = outputDirectoryParam;
+}
+
+// Set the ADFS path patterns (which may use the '#' and '*' wildcards) that ls
+// and extract are limited to; an empty list means the whole image
+void CliImageReport::setPathPatterns(const QStringList &pathPatternsParam)
+{
+    pathPatterns = pathPatternsParam;
+}
+
+// Also hash each image and file with SHA-256 (hash)
+void CliImageReport::setSha256Enabled(bool sha256EnabledParam)
+{
+    sha256Enabled = sha256EnabledParam;
+}
+
+// Add the hashes of each image and its files to a duplicate report (hash)
+// Note: The report is not owned by the image report
+void CliImageReport::setDuplicateReport(CliDuplicateReport *duplicateReportParam)
+{
+    duplicateReport = duplicateReportParam;
+}
+
+// Set the number of threads each image's catalogue is read with.  Images are
+// processed in parallel, so this is only worth raising when there are fewer
+// images than cores
+void CliImageReport::setScanThreads(qint64 scanThreadsParam)
+{
+    scanThreads = qMax(scanThreadsParam, static_cast<qint64>(1));
+}
+
+// Process a disc image, appending the JSON lines output for it
+// Note: An image that cannot be processed produces a single line with an
+// "error" member (and returns false) rather than no output
+bool CliImageReport::process(const QString &filename, QByteArray *output) const
+{
+    // Identify the format of the image
+    DiscImageProber discImageProber;
+    if (!discImageProber.probe(filename)) {
+        appendError(filename, "Cannot read disc image", output);
+        return false;
+    }
+
+    if (command == ProbeCommand) return appendProbe(filename, discImageProber, output);
+
+    DiscImage discImage(filename, DiscImage::MappedAccess, discImageProber.getBestFormat());
+    if (!discImage.isValid()) {
+        appendError(filename, "Cannot open disc image", output);
+        return false;
+    }
+
+    AdfsImage adfsImage(&discImage);
+    if (!adfsImage.isValid()) {
+        appendError(filename, "Disc image does not contain a valid ADFS free space map", output);
+        return false;
+    }
+
+    switch (command) {
+    case ListCommand:
+        return appendList(filename, &adfsImage, output);
+    case StatCommand:
+        return appendStat(filename, &adfsImage, output);
+    case FreeSpaceCommand:
+        return appendFreeSpace(filename, &adfsImage, output);
+    case ExtractCommand:
+        return appendExtract(filename, &adfsImage, output);
+    case HashCommand:
+        return appendHashes(filename, &adfsImage, output);
+    case CheckCommand:
+        return appendCheck(filename, &adfsImage, output);
+    case ProbeCommand:
+        break;
+    }
+
+    return false;
+}
+
+// Private methods
+
+// List the root directory, or every file and directory if recursive
+bool CliImageReport::appendList(const QString &filename, AdfsImage *adfsImage, QByteArray *output) const
+{
+    if (!recursive && pathPatterns.isEmpty()) {
+        // Only the root directory is needed
+        AdfsDirectoryRecord rootRecord;
+        if (!adfsImage->readDirectoryRecord(adfsImage->getRootDirectorySector(), &rootRecord)) {
+            appendError(filename, "Cannot read the root directory", output);
+            return false;
+        }
+
+        for (const AdfsDirectoryEntry &entry : rootRecord.entries) {
+            appendEntry(filename, "$." + rootRecord.getEntryName(entry), entry, output);
+        }
+        return true;
+    }
+
+    AdfsCatalogue catalogue;
+    if (!readCatalogue(adfsImage, &catalogue)) {
+        appendError(filename, "Cannot read the root directory", output);
+        return false;
+    }
+
+    if (!pathPatterns.isEmpty()) {
+        QVector<qint64> nodeNumbers = matchPathPatterns(catalogue);
+        if (nodeNumbers.isEmpty()) {
+            appendError(filename, "No files or directories match the paths", output);
+            return false;
+        }
+
+        for (qint64 nodeNumber : nodeNumbers) appendNode(filename, catalogue, nodeNumber, output);
+        return true;
+    }
+
+    // Node 0 is the root directory itself
+    for (qint64 nodeNumber = 1; nodeNumber < catalogue.getNumberOfNodes(); nodeNumber++) {
+        appendEntry(filename, catalogue.getNodePath(nodeNumber), catalogue.getNode(nodeNumber).entry, output);
+    }
+
+    return true;
+}
+
+// Summarise the image and its file system
+bool CliImageReport::appendStat(const QString &filename, AdfsImage *adfsImage, QByteArray *output) const
+{
+    AdfsCatalogue catalogue;
+    if (!readCatalogue(adfsImage, &catalogue)) {
+        appendError(filename, "Cannot read the root directory", output);
+        return false;
+    }
+
+    qint64 fileBytes = 0;
+    qint64 unreadableDirectories = 0;
+    for (const AdfsCatalogueNode &node : catalogue.getNodes()) {
+        if (!node.isDirectory()) fileBytes += node.entry.length;
+        else if (!catalogue.getDirectoryRecords().contains(node.entry.startSector)) unreadableDirectories++;
+    }
+
+    QJsonObject object;
+    object.insert("image", filename);
+    object.insert("imageBytes", QFileInfo(filename).size());
+    object.insert("format", adfsImage->getDiscImage()->getGeometry().getFormatName());
+    object.insert("sectorSize", adfsImage->getDiscImage()->getSectorSize());
+
+    if (adfsImage->getMapType() == AdfsImage::NewMap) {
+        AdfsNewMap *newMap = adfsImage->getNewMap();
+        object.insert("map", QString("new"));
+        object.insert("totalSectors", newMap->getDiscSize() / newMap->getSectorSize());
+        object.insert("discIdentifier", newMap->getDiscIdentifier());
+        object.insert("bootOption", newMap->getBootOptionNumber());
+        object.insert("zones", newMap->getNumberOfZones());
+        object.insert("fragments", newMap->getNumberOfFragments());
+    } else {
+        AdfsFreeSpaceMap *freeSpaceMap = adfsImage->getFreeSpaceMap();
+        object.insert("map", QString("old"));
+        object.insert("totalSectors", freeSpaceMap->getTotalSectorsOnDisc());
+        object.insert("discIdentifier", freeSpaceMap->getDiscIdentifier());
+        object.insert("bootOption", freeSpaceMap->getBootOptionNumber());
+    }
+
+    object.insert("directories", catalogue.getNumberOfDirectories());
+    object.insert("files", catalogue.getNumberOfFiles());
+    object.insert("fileBytes", fileBytes);
+    object.insert("unreadableDirectories", unreadableDirectories);
+    appendJsonLine(object, output);
+
+    return true;
+}
+
+// Report the free space on the image
+// Note: Old map discs are reported in 256 byte sectors and new map discs in the
+// sector size of the disc record
+bool CliImageReport::appendFreeSpace(const QString &filename, AdfsImage *adfsImage, QByteArray *output) const
+{
+    if (adfsImage->getMapType() == AdfsImage::NewMap) return appendNewMapFreeSpace(filename, adfsImage->getNewMap(), output);
+
+    AdfsFreeSpaceMap *freeSpaceMap = adfsImage->getFreeSpaceMap();
+    qint64 sectorSize = 256;
+
+    AdfsFreeSpaceIndex freeSpaceIndex;
+    if (!freeSpaceIndex.build(freeSpaceMap)) {
+        appendError(filename, "Free space map entries are not valid", output);
+        return false;
+    }
+
+    QJsonObject object;
+    object.insert("image", filename);
+    object.insert("totalSectors", freeSpaceMap->getTotalSectorsOnDisc());
+    object.insert("usedSectors", freeSpaceMap->getTotalSectorsOnDisc() - freeSpaceIndex.getFreeSectors());
+    object.insert("freeSectors", freeSpaceIndex.getFreeSectors());
+    object.insert("freeBytes", freeSpaceIndex.getFreeSectors() * sectorSize);
+    object.insert("freeExtents", freeSpaceIndex.getNumberOfFreeExtents());
+    object.insert("largestFreeExtent", freeSpaceIndex.getLargestFreeExtent());
+    appendJsonLine(object, output);
+
+    return true;
+}
+
+// Report the free space on a new map image
+bool CliImageReport::appendNewMapFreeSpace(const QString &filename, AdfsNewMap *newMap, QByteArray *output) const
+{
+    qint64 sectorSize = newMap->getSectorSize();
+    qint64 totalSectors = newMap->getDiscSize() / sectorSize;
+
+    qint64 largestFreeExtent = 0;
+    for (const AdfsDiscExtent &extent : newMap->getFreeExtents()) largestFreeExtent = qMax(largestFreeExtent, extent.length);
+
+    QJsonObject object;
+    object.insert("image", filename);
+    object.insert("totalSectors", totalSectors);
+    object.insert("usedSectors", totalSectors - newMap->getFreeBytes() / sectorSize);
+    object.insert("freeSectors", newMap->getFreeBytes() / sectorSize);
+    object.insert("freeBytes", newMap->getFreeBytes());
+    object.insert("freeExtents", newMap->getFreeExtents().size());
+    object.insert("largestFreeExtent", largestFreeExtent / sectorSize);
+    appendJsonLine(object, output);
+
+    return true;
+}
+
+// Extract every file on the image
+bool CliImageReport::appendExtract(const QString &filename, AdfsImage *adfsImage, QByteArray *output) const
+{
+    AdfsCatalogue catalogue;
+    if (!readCatalogue(adfsImage, &catalogue)) {
+        appendError(filename, "Cannot read the root directory", output);
+        return false;
+    }
+
+    // Extract the matching paths, or the contents of the root directory (rather
+    // than the root itself)
+    QString imageDirectory = QDir(outputDirectory).filePath(QFileInfo(filename).completeBaseName());
+    const AdfsCatalogueNode &rootNode = catalogue.getNode(0);
+
+    QVector<qint64> nodeNumbers;
+    if (!pathPatterns.isEmpty()) {
+        nodeNumbers = matchPathPatterns(catalogue);
+        if (nodeNumbers.isEmpty()) {
+            appendError(filename, "No files or directories match the paths", output);
+            return false;
+        }
+    } else {
+        for (qint64 child = rootNode.firstChild; child < rootNode.firstChild + rootNode.childCount; child++) nodeNumbers.append(child);
+    }
+
+    AdfsFileExtractor fileExtractor(adfsImage);
+    bool extracted = fileExtractor.extract(catalogue, nodeNumbers, imageDirectory);
+    AdfsExtractionStatistics statistics = fileExtractor.getStatistics();
+
+    QJsonObject object;
+    object.insert("image", filename);
+    object.insert("directory", imageDirectory);
+    object.insert("files", statistics.files);
+    object.insert("directories", statistics.directories);
+    object.insert("bytesWritten", statistics.bytesWritten);
+    object.insert("failures", statistics.failures);
+    appendJsonLine(object, output);
+
+    return extracted;
+}
+
+// Hash the image and every file on it, writing a manifest line per file and
+// then a line for the image
+bool CliImageReport::appendHashes(const QString &filename, AdfsImage *adfsImage, QByteArray *output) const
+{
+    AdfsContentHash imageHash;
+    if (!AdfsFileHasher::hashImageFile(filename, sha256Enabled, &imageHash)) {
+        appendError(filename, "Cannot read disc image", output);
+        return false;
+    }
+
+    AdfsCatalogue catalogue;
+    if (!readCatalogue(adfsImage, &catalogue)) {
+        appendError(filename, "Cannot read the root directory", output);
+        return false;
+    }
+
+    AdfsFileHasher fileHasher(adfsImage);
+    fileHasher.setSha256Enabled(sha256Enabled);
+    bool allFilesHashed = fileHasher.hash(catalogue);
+
+    for (const AdfsContentHash &fileHash : fileHasher.getFileHashes()) {
+        QString path = catalogue.getNodePath(fileHash.nodeNumber);
+
+        QJsonObject object;
+        object.insert("image", filename);
+        object.insert("path", path);
+        object.insert("length", fileHash.length);
+        if (fileHash.valid) {
+            object.insert("xxh64", getHashString(fileHash.xxHash64));
+            if (sha256Enabled) object.insert("sha256", QString::fromLatin1(fileHash.sha256.toHex()));
+        } else {
+            object.insert("error", QString("Cannot read file"));
+        }
+        appendJsonLine(object, output);
+
+        if (fileHash.valid && duplicateReport != nullptr) duplicateReport->addFile(filename, path, fileHash);
+    }
+
+    QJsonObject object;
+    object.insert("image", filename);
+    object.insert("imageBytes", imageHash.length);
+    object.insert("xxh64", getHashString(imageHash.xxHash64));
+    if (sha256Enabled) object.insert("sha256", QString::fromLatin1(imageHash.sha256.toHex()));
+    object.insert("files", fileHasher.getFileHashes().size());
+    object.insert("bytesHashed", fileHasher.getBytesHashed());
+    appendJsonLine(object, output);
+
+    if (duplicateReport != nullptr) duplicateReport->addImage(filename, imageHash);
+
+    return allFilesHashed;
+}
+
+// Check the integrity of the file system, writing a line for the image with
+// the count of each kind of problem and a description of each problem found
+bool CliImageReport::appendCheck(const QString &filename, AdfsImage *adfsImage, QByteArray *output) const
+{
+    AdfsCatalogue catalogue;
+    if (!readCatalogue(adfsImage, &catalogue)) {
+        appendError(filename, "Cannot read the root directory", output);
+        return false;
+    }
+
+    AdfsImageChecker imageChecker(adfsImage);
+    bool clean = imageChecker.check(catalogue);
+    const AdfsCheckResults &results = imageChecker.getResults();
+
+    QJsonObject object;
+    object.insert("image", filename);
+    object.insert("clean", clean);
+    object.insert("sectorSize", results.sectorSize);
+    object.insert("totalSectors", results.totalSectors);
+    object.insert("crossLinkedSectors", results.crossLinkedSectors);
+    object.insert("freeSpaceOverlapSectors", results.freeSpaceOverlapSectors);
+    object.insert("lostSectors", results.lostSectors);
+    object.insert("sequenceNumberMismatches", results.sequenceNumberMismatches);
+    object.insert("badCheckBytes", results.badCheckBytes);
+    object.insert("unreadableDirectories", results.unreadableDirectories);
+    object.insert("invalidAddresses", results.invalidAddresses);
+    object.insert("problems", QJsonArray::fromStringList(results.problems));
+    appendJsonLine(object, output);
+
+    return clean;
+}
+
+// Report the possible formats of the image
+bool CliImageReport::appendProbe(const QString &filename, const DiscImageProber &discImageProber, QByteArray *output) const
+{
+    QJsonArray candidates;
+    for (const DiscImageProbeResult &result : discImageProber.getResults()) {
+        QJsonObject candidate;
+        candidate.insert("format", DiscGeometry(result.format).getFormatName());
+        candidate.insert("confidence", result.confidence);
+        candidate.insert("evidence", result.evidence);
+        candidates.append(candidate);
+    }
+
+    QJsonObject object;
+    object.insert("image", filename);
+    object.insert("format", DiscGeometry(discImageProber.getBestFormat()).getFormatName());
+    object.insert("confidence", discImageProber.getBestConfidence());
+    object.insert("bytesRead", discImageProber.getBytesRead());
+    object.insert("candidates", candidates);
+    appendJsonLine(object, output);
+
+    return discImageProber.getBestFormat() != DiscGeometry::UnknownFormat;
+}
+
+// Append a node, and if listing recursively the contents of a directory node
+void CliImageReport::appendNode(const QString &filename, const AdfsCatalogue &catalogue, qint64 nodeNumber, QByteArray *output) const
+{
+    const AdfsCatalogueNode &node = catalogue.getNode(nodeNumber);
+    appendEntry(filename, catalogue.getNodePath(nodeNumber), node.entry, output);
+
+    if (!recursive || !node.isDirectory()) return;
+    for (qint64 child = node.firstChild; child < node.firstChild + node.childCount; child++) appendNode(filename, catalogue, child, output);
+}
+
+// Append a line describing a file or directory
+void CliImageReport::appendEntry(const QString &filename, const QString &path, const AdfsDirectoryEntry &entry, QByteArray *output) const
+{
+    QJsonObject object;
+    object.insert("image", filename);
+    object.insert("path", path);
+    object.insert("type", entry.isDirectory() ? "directory" : "file");
+    object.insert("attributes", entry.getAttributeString());
+    object.insert("sequence", entry.sequenceNumber);
+    object.insert("sector", static_cast<qint64>(entry.startSector));
+
+    if (!entry.isDirectory()) {
+        object.insert("load", static_cast<qint64>(entry.loadAddress));
+        object.insert("exec", static_cast<qint64>(entry.executionAddress));
+        object.insert("length", static_cast<qint64>(entry.length));
+    }
+
+    appendJsonLine(object, output);
+}
+
+// Append a line reporting that the image could not be processed
+void CliImageReport::appendError(const QString &filename, const QString &error, QByteArray *output) const
+{
+    QJsonObject object;
+    object.insert("image", filename);
+    object.insert("error", error);
+    appendJsonLine(object, output);
+}
+
+void CliImageReport::appendJsonLine(const QJsonObject &object, QByteArray *output) const
+{
+    output->append(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    output->append('\n');
+}
+
+// Read the whole catalogue of the image
+bool CliImageReport::readCatalogue(AdfsImage *adfsImage, AdfsCatalogue *catalogue) const
+{
+    AdfsCatalogueScanner scanner(adfsImage);
+    scanner.setMaximumThreads(scanThreads);
+
+    return scanner.scan(catalogue);
+}
+
+// Find the nodes matching any of the path patterns (each node once, in the
+// order the patterns were given)
+QVector<qint64> CliImageReport::matchPathPatterns(const AdfsCatalogue &catalogue) const
+{
+    AdfsPathIndex pathIndex;
+    pathIndex.build(&catalogue);
+
+    QVector<qint64> nodeNumbers;
+    QSet<qint64> matchedNodes;
+    for (const QString &pathPattern : pathPatterns) {
+        for (qint64 nodeNumber : pathIndex.match(pathPattern)) {
+            if (matchedNodes.contains(nodeNumber)) continue;
+
+            matchedNodes.insert(nodeNumber);
+            nodeNumbers.append(nodeNumber);
+        }
+    }
+
+    return nodeNumbers;
+}
+
+// Format a 64-bit hash as 16 hexadecimal digits
+QString CliImageReport::getHashString(quint64 hash) const
+{
+    return QString("%1").arg(hash, 16, 16, QChar('0'));
+}
@@ -0,0 +1,94 @@
+/************************************************************************
+
+    cliimagereport.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef CLIIMAGEREPORT_H
+#define CLIIMAGEREPORT_H
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonObject>
+
+#include "discimage.h"
+#include "adfsimage.h"
+#include "adfscatalogue.h"
+#include "discimageprober.h"
+#include "cliduplicatereport.h"
+
+// Produces the JSON lines output of a command line tool command for a single
+// disc image.  Each image is processed independently, so one report object can
+// be shared by any number of worker threads
+class CliImageReport
+{
+public:
+    enum Command {
+        ListCommand,        // ls - list the root directory (or the whole catalogue, or matching paths)
+        StatCommand,        // stat - summarise the image and its file system
+        FreeSpaceCommand,   // df - report the free space on the image
+        ExtractCommand,     // extract - extract every file or matching paths (with .inf files)
+        ProbeCommand,       // probe - identify the format of the image
+        HashCommand,        // hash - hash the image and every file on it
+        CheckCommand        // fsck - check the integrity of the file system
+    };
+
+    CliImageReport(Command commandParam, bool recursiveParam);
+
+    void setOutputDirectory(const QString &outputDirectoryParam);
+    void setPathPatterns(const QStringList &pathPatternsParam);
+    void setSha256Enabled(bool sha256EnabledParam);
+    void setDuplicateReport(CliDuplicateReport *duplicateReportParam);
+    void setScanThreads(qint64 scanThreadsParam);
+
+    bool process(const QString &filename, QByteArray *output) const;
+
+private:
+    Command command;
+    bool recursive;
+    QString outputDirectory;
+    QStringList pathPatterns;
+    bool sha256Enabled;
+    CliDuplicateReport *duplicateReport;
+    qint64 scanThreads;
+
+    bool appendList(const QString &filename, AdfsImage *adfsImage, QByteArray *output) const;
+    bool appendStat(const QString &filename, AdfsImage *adfsImage, QByteArray *output) const;
+    bool appendFreeSpace(const QString &filename, AdfsImage *adfsImage, QByteArray *output) const;
+    bool appendNewMapFreeSpace(const QString &filename, AdfsNewMap *newMap, QByteArray *output) const;
+    bool appendExtract(const QString &filename, AdfsImage *adfsImage, QByteArray *output) const;
+    bool appendHashes(const QString &filename, AdfsImage *adfsImage, QByteArray *output) const;
+    bool appendCheck(const QString &filename, AdfsImage *adfsImage, QByteArray *output) const;
+    bool appendProbe(const QString &filename, const DiscImageProber &discImageProber, QByteArray *output) const;
+    void appendNode(const QString &filename, const AdfsCatalogue &catalogue, qint64 nodeNumber, QByteArray *output) const;
+    void appendEntry(const QString &filename, const QString &path, const AdfsDirectoryEntry &entry, QByteArray *output) const;
+    void appendError(const QString &filename, const QString &error, QByteArray *output) const;
+    void appendJsonLine(const QJsonObject &object, QByteArray *output) const;
+
+    bool readCatalogue(AdfsImage *adfsImage, AdfsCatalogue *catalogue) const;
+    QVector<qint64> matchPathPatterns(const AdfsCatalogue &catalogue) const;
+    QString getHashString(quint64 hash) const;
+};
+
+#endif // CLIIMAGEREPORT_H
@@ -0,0 +1,320 @@
+/************************************************************************
+
+    main.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include "cliimagereport.h"
+#include "cliimagediff.h"
+#include "compressedimagefile.h"
+#include "tracerecorder.h"
+#include "logringbuffer.h"
+
+// Images processed in each batch, per worker thread.  The output of a batch is
+// held in memory until the whole batch is complete, so this bounds the memory
+// used however many images are given
+static const qint64 imagesPerThreadPerBatch = 16;
+
+// A disc image waiting to be processed and its output
+struct CliImageJob
+{
+    QString filename;
+    QByteArray output;
+    bool valid;
+};
+
+// Debug output from the core classes is only wanted with --verbose
+static bool verboseOutput = false;
+
+static void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    Q_UNUSED(context);
+
+    if (type == QtDebugMsg && !verboseOutput) return;
+    fprintf(stderr, "%s\n", message.toLocal8Bit().constData());
+}
+
+// Read the next batch of image filenames from the command line arguments and
+// then the file list (if any); directories are expanded as they are reached
+static bool readBatch(QStringList *arguments, QTextStream *fileList, qint64 batchSize, QVector<CliImageJob> *batch)
+{
+    batch->clear();
+
+    while (batch->size() < batchSize) {
+        CliImageJob job;
+        job.valid = false;
+
+        if (!arguments->isEmpty()) {
+            job.filename = arguments->takeFirst();
+        } else if (fileList != nullptr && !fileList->atEnd()) {
+            job.filename = fileList->readLine().trimmed();
+            if (job.filename.isEmpty()) continue;
+        } else {
+            break;
+        }
+
+        // A directory stands for every file within it (and its sub-directories)
+        if (QFileInfo(job.filename).isDir()) {
+            QStringList directoryFiles;
+            QDirIterator directoryIterator(job.filename, QDir::Files, QDirIterator::Subdirectories);
+            while (directoryIterator.hasNext()) directoryFiles.append(directoryIterator.next());
+
+            directoryFiles.sort();
+            *arguments = directoryFiles + *arguments;
+            continue;
+        }
+
+        // As does a zip archive for every image within it
+        if (job.filename.endsWith(".zip", Qt::CaseInsensitive) && QFileInfo(job.filename).isFile()) {
+            *arguments = CompressedImageFile::getArchiveImages(job.filename) + *arguments;
+            continue;
+        }
+
+        batch->append(job);
+    }
+
+    return !batch->isEmpty();
+}
+
+// Write the Chrome trace and the counters of each traced phase (as JSON lines
+// on standard error)
+static void writeTrace(const QString &traceFilename)
+{
+    if (!TraceRecorder::writeChromeTrace(traceFilename)) {
+        fprintf(stderr, "oaecli: Cannot write trace '%s'\n", traceFilename.toLocal8Bit().constData());
+    }
+
+    for (const TracePhaseCounters &counters : TraceRecorder::getPhaseCounters()) {
+        QJsonObject object;
+        object.insert("phase", counters.name);
+        object.insert("category", counters.category);
+        object.insert("count", counters.count);
+        object.insert("totalMicroseconds", counters.totalNanoseconds / 1000);
+        object.insert("maximumMicroseconds", counters.maximumNanoseconds / 1000);
+        object.insert("bytes", counters.bytes);
+        fprintf(stderr, "%s\n", QJsonDocument(object).toJson(QJsonDocument::Compact).constData());
+    }
+
+    if (TraceRecorder::getDroppedEvents() > 0) {
+        fprintf(stderr, "oaecli: Trace is incomplete (%lld events dropped)\n", TraceRecorder::getDroppedEvents());
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("oaecli");
+    QCoreApplication::setApplicationVersion("1.0");
+
+    qInstallMessageHandler(messageHandler);
+
+    // Define the command line
+    QCommandLineParser parser;
+    parser.setApplicationDescription("OpenAcornExplorer command line tool.  Writes one JSON object per line to "
+                                     "standard output: a line per file or directory for ls, and a line per image "
+                                     "for stat, df, extract, probe and fsck.  hash writes a line per file and then per image, "
+                                     "and with --duplicates ends with a line per set of identical images or files.  diff compares "
+                                     "two images, writing a line per file or directory added, removed or changed and then a summary.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("command", "ls, stat, df, extract, probe, hash, fsck or diff");
+    parser.addPositionalArgument("images", "Disc images (or directories of disc images) to process", "[images...]");
+
+    QCommandLineOption recursiveOption(QStringList() << "R" << "recursive", "List directories recursively (ls)");
+    QCommandLineOption fileListOption(QStringList() << "f" << "file-list",
+                                      "Read further image filenames, one per line, from <file> ('-' for standard input)", "file");
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs", "Number of images to process in parallel", "jobs");
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+                                    "Directory to extract images to (extract; default the current directory)", "directory", ".");
+    QCommandLineOption pathOption(QStringList() << "p" << "path",
+                                  "Only list or extract the ADFS paths matching <pattern>, which may use the '#' and '*' "
+                                  "wildcards (ls, extract; may be given more than once)", "pattern");
+    QCommandLineOption sha256Option("sha256", "Also hash with SHA-256 (hash)");
+    QCommandLineOption duplicatesOption("duplicates", "Report identical images and files across all of the images (hash)");
+    QCommandLineOption traceOption("trace", "Trace disc image reads and parsing, writing a Chrome trace to <file> and "
+                                   "the time spent in each phase to standard error", "file");
+    QCommandLineOption logDumpOption("log-dump", "Keep the most recent debug output in memory and write it to <file> "
+                                     "on exit", "file");
+    QCommandLineOption verboseOption(QStringList() << "v" << "verbose", "Show debug output");
+    parser.addOption(recursiveOption);
+    parser.addOption(fileListOption);
+    parser.addOption(jobsOption);
+    parser.addOption(outputOption);
+    parser.addOption(pathOption);
+    parser.addOption(sha256Option);
+    parser.addOption(duplicatesOption);
+    parser.addOption(traceOption);
+    parser.addOption(logDumpOption);
+    parser.addOption(verboseOption);
+
+    parser.process(a);
+    verboseOutput = parser.isSet(verboseOption);
+
+    // Unless the debug output is wanted, disable it so that it is not even
+    // formatted
+    if (parser.isSet(logDumpOption)) {
+        LogRingBuffer::install();
+    } else if (!verboseOutput) {
+        QLoggingCategory::setFilterRules("oae.*.debug=false");
+    }
+
+    QStringList arguments = parser.positionalArguments();
+    if (arguments.isEmpty()) {
+        fprintf(stderr, "oaecli: No command given\n");
+        return 2;
+    }
+
+    // Get the command
+    QString commandName = arguments.takeFirst();
+    // diff compares two images rather than reporting on each image in turn
+    bool diffCommand = (commandName == "diff");
+    CliImageReport::Command command = CliImageReport::ListCommand;
+    if (diffCommand) {
+        if (arguments.size() != 2) {
+            fprintf(stderr, "oaecli: diff compares two images\n");
+            return 2;
+        }
+    } else if (commandName == "ls") command = CliImageReport::ListCommand;
+    else if (commandName == "stat") command = CliImageReport::StatCommand;
+    else if (commandName == "df") command = CliImageReport::FreeSpaceCommand;
+    else if (commandName == "extract") command = CliImageReport::ExtractCommand;
+    else if (commandName == "probe") command = CliImageReport::ProbeCommand;
+    else if (commandName == "hash") command = CliImageReport::HashCommand;
+    else if (commandName == "fsck") command = CliImageReport::CheckCommand;
+    else {
+        fprintf(stderr, "oaecli: Unknown command '%s'\n", commandName.toLocal8Bit().constData());
+        return 2;
+    }
+
+    // Open the file list
+    QFile fileListFile;
+    QTextStream *fileList = nullptr;
+    if (parser.isSet(fileListOption)) {
+        QString fileListName = parser.value(fileListOption);
+
+        bool fileListOpen;
+        if (fileListName == "-") fileListOpen = fileListFile.open(stdin, QIODevice::ReadOnly | QIODevice::Text);
+        else {
+            fileListFile.setFileName(fileListName);
+            fileListOpen = fileListFile.open(QIODevice::ReadOnly | QIODevice::Text);
+        }
+
+        if (!fileListOpen) {
+            fprintf(stderr, "oaecli: Cannot open file list '%s'\n", fileListName.toLocal8Bit().constData());
+            return 2;
+        }
+        fileList = new QTextStream(&fileListFile);
+    }
+
+    // Set the number of images to process in parallel
+    if (parser.isSet(jobsOption)) {
+        bool jobsValid = false;
+        qint64 jobs = parser.value(jobsOption).toLongLong(&jobsValid);
+        if (!jobsValid || jobs < 1) {
+            fprintf(stderr, "oaecli: Invalid number of jobs\n");
+            delete fileList;
+            return 2;
+        }
+        QThreadPool::globalInstance()->setMaxThreadCount(static_cast<int>(jobs));
+    }
+
+    QFile standardOutput;
+    standardOutput.open(stdout, QIODevice::WriteOnly);
+
+    if (parser.isSet(traceOption)) TraceRecorder::setEnabled(true);
+
+    int exitStatus = 0;
+    if (diffCommand) {
+        // The exit status is 0 if the images are identical, 1 if they differ
+        // and 2 if they could not be compared
+        CliImageDiff imageDiff;
+        QByteArray diffOutput;
+        if (!imageDiff.process(arguments[0], arguments[1], &diffOutput)) exitStatus = 2;
+        else if (!imageDiff.isIdentical()) exitStatus = 1;
+        standardOutput.write(diffOutput);
+    } else {
+        // Process the images a batch at a time, writing each batch's output in the
+        // order the images were given
+        CliImageReport report(command, parser.isSet(recursiveOption));
+        report.setOutputDirectory(parser.value(outputOption));
+        report.setPathPatterns(parser.values(pathOption));
+        report.setSha256Enabled(parser.isSet(sha256Option));
+
+        CliDuplicateReport duplicateReport;
+        if (parser.isSet(duplicatesOption)) report.setDuplicateReport(&duplicateReport);
+        qint64 batchSize = QThreadPool::globalInstance()->maxThreadCount() * imagesPerThreadPerBatch;
+        bool allImagesValid = true;
+
+        QVector<CliImageJob> batch;
+        while (readBatch(&arguments, fileList, batchSize, &batch)) {
+            // A single image (such as the only image given) is scanned on all cores
+            report.setScanThreads(batch.size() == 1 ? QThread::idealThreadCount() : 1);
+
+            QtConcurrent::blockingMap(batch, [&report](CliImageJob &job) {
+                job.valid = report.process(job.filename, &job.output);
+            });
+
+            for (const CliImageJob &job : batch) {
+                if (!job.valid) allImagesValid = false;
+                standardOutput.write(job.output);
+            }
+            standardOutput.flush();
+        }
+
+        // The duplicates can only be reported once every image has been hashed
+        if (parser.isSet(duplicatesOption)) {
+            QByteArray duplicateOutput;
+            duplicateReport.appendReport(&duplicateOutput);
+            standardOutput.write(duplicateOutput);
+        }
+
+        if (!allImagesValid) exitStatus = 1;
+    }
+
+    delete fileList;
+
+    if (parser.isSet(traceOption)) {
+        TraceRecorder::setEnabled(false);
+        writeTrace(parser.value(traceOption));
+    }
+
+    if (parser.isSet(logDumpOption) && !LogRingBuffer::dump(parser.value(logDumpOption))) {
+        fprintf(stderr, "oaecli: Cannot write log dump '%s'\n", parser.value(logDumpOption).toLocal8Bit().constData());
+    }
+
+    return exitStatus;
+}
@@ -0,0 +1,37 @@
+#-------------------------------------------------
+#
+# OpenAcornExplorer core unit tests
+#
+#-------------------------------------------------
+
+QT       += core testlib
+QT       -= gui
+
+CONFIG   += console testcase
+CONFIG   -= app_bundle
+
+TARGET = oaetests
+TEMPLATE = app
+
+# The following define makes your compiler emit warnings if you use
+# any feature of Qt which has been marked as deprecated (the exact warnings
+# depend on your compiler). Please consult the documentation of the
+# deprecated API in order to know how to port your code away from it.
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../OpenAcornExplorer/core.pri)
+
+SOURCES += \
+    main.cpp \
+    tst_compressedimagefile.cpp \
+    tst_adfscataloguescanner.cpp \
+    tst_discimage.cpp \
+    tst_adfsfreespaceindex.cpp \
+    tst_adfsnewmap.cpp
+
+HEADERS += \
+    tst_compressedimagefile.h \
+    tst_adfscataloguescanner.h \
+    tst_discimage.h \
+    tst_adfsfreespaceindex.h \
+    tst_adfsnewmap.h
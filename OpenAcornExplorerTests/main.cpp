@@ -0,0 +1,66 @@
+/************************************************************************
+
+    main.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include <QCoreApplication>
+#include <QtTest>
+
+#include "tst_compressedimagefile.h"
+#include "tst_adfscataloguescanner.h"
+#include "tst_discimage.h"
+#include "tst_adfsfreespaceindex.h"
+#include "tst_adfsnewmap.h"
+
+// Runs each of the test classes in turn; the exit status is non-zero if any
+// test failed
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    int status = 0;
+    {
+        TestCompressedImageFile test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        TestAdfsCatalogueScanner test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        TestDiscImage test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        TestAdfsFreeSpaceIndex test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        TestAdfsNewMap test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+
+    return status;
+}
@@ -0,0 +1,134 @@
+/************************************************************************
+
+    tst_adfscataloguescanner.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "tst_adfscataloguescanner.h"
+
+#include <QDir>
+
+#include "discimage.h"
+#include "discimageprober.h"
+#include "adfsimage.h"
+#include "adfscataloguescanner.h"
+
+// More workers than most machines have cores, so that workers run out of work,
+// steal from each other and wait for more
+static const qint64 parallelThreads = 8;
+static const qint64 parallelScans = 20;
+
+void TestAdfsCatalogueScanner::scanInParallel_data()
+{
+    QTest::addColumn<QString>("filename");
+
+    QDir imageDirectory(QFINDTESTDATA("../ADFS Test images"));
+    QStringList images = imageDirectory.entryList(QStringList() << "*.adf" << "*.adl", QDir::Files, QDir::Name);
+    QVERIFY(!images.isEmpty());
+
+    for (const QString &image : images) {
+        QTest::newRow(image.toLocal8Bit().constData()) << imageDirectory.filePath(image);
+    }
+}
+
+// Scan each image on one thread, then repeatedly on several; every scan must
+// give the same catalogue
+void TestAdfsCatalogueScanner::scanInParallel()
+{
+    QFETCH(QString, filename);
+
+    DiscImageProber discImageProber;
+    QVERIFY(discImageProber.probe(filename));
+    DiscImage discImage(filename, DiscImage::MappedAccess, discImageProber.getBestFormat());
+    AdfsImage adfsImage(&discImage);
+    if (!adfsImage.isValid()) QSKIP("Not a supported ADFS image");
+
+    AdfsCatalogue expectedCatalogue;
+    AdfsCatalogueScanner serialScanner(&adfsImage);
+    serialScanner.setMaximumThreads(1);
+    QVERIFY(serialScanner.scan(&expectedCatalogue));
+    QCOMPARE(serialScanner.getStatistics().directoriesStolen, Q_INT64_C(0));
+
+    for (qint64 scanNumber = 0; scanNumber < parallelScans; scanNumber++) {
+        AdfsCatalogue catalogue;
+        AdfsCatalogueScanner parallelScanner(&adfsImage);
+        parallelScanner.setMaximumThreads(parallelThreads);
+        QVERIFY(parallelScanner.scan(&catalogue));
+
+        QCOMPARE(parallelScanner.getStatistics().threads, parallelThreads);
+        QCOMPARE(parallelScanner.getStatistics().directoriesRead, serialScanner.getStatistics().directoriesRead);
+        QCOMPARE(parallelScanner.getStatistics().directoriesInvalid, serialScanner.getStatistics().directoriesInvalid);
+        QVERIFY(isSameCatalogue(catalogue, expectedCatalogue));
+    }
+}
+
+// A scan stopped by the directory callback finishes (without waiting workers
+// being left behind) and reports that it was stopped
+void TestAdfsCatalogueScanner::stopScan()
+{
+    QString filename = QFINDTESTDATA("../ADFS Test images/ADFS L 640K Stress.adl");
+    QVERIFY(!filename.isEmpty());
+
+    DiscImageProber discImageProber;
+    QVERIFY(discImageProber.probe(filename));
+    DiscImage discImage(filename, DiscImage::MappedAccess, discImageProber.getBestFormat());
+    AdfsImage adfsImage(&discImage);
+    QVERIFY(adfsImage.isValid());
+
+    qint64 callbacks = 0;
+    AdfsCatalogue catalogue;
+    AdfsCatalogueScanner scanner(&adfsImage);
+    scanner.setMaximumThreads(parallelThreads);
+    scanner.setDirectoryCallback([&callbacks](const AdfsDirectoryRecord &, qint64, qint64) {
+        callbacks++;
+        return false;
+    });
+
+    QVERIFY(!scanner.scan(&catalogue));
+    QVERIFY(scanner.getStatistics().stopped);
+    QCOMPARE(callbacks, Q_INT64_C(1));
+}
+
+// Private methods ----------------------------------------------------------------------------------------------------
+
+bool TestAdfsCatalogueScanner::isSameCatalogue(const AdfsCatalogue &catalogue, const AdfsCatalogue &expectedCatalogue)
+{
+    if (catalogue.getNumberOfNodes() != expectedCatalogue.getNumberOfNodes()) return false;
+
+    for (qint64 nodeNumber = 0; nodeNumber < catalogue.getNumberOfNodes(); nodeNumber++) {
+        const AdfsCatalogueNode &node = catalogue.getNode(nodeNumber);
+        const AdfsCatalogueNode &expectedNode = expectedCatalogue.getNode(nodeNumber);
+
+        if (catalogue.getNodePath(nodeNumber) != expectedCatalogue.getNodePath(nodeNumber)) return false;
+        if (node.parent != expectedNode.parent || node.firstChild != expectedNode.firstChild ||
+                node.childCount != expectedNode.childCount || node.row != expectedNode.row) return false;
+        if (node.entry.attributes != expectedNode.entry.attributes ||
+                node.entry.loadAddress != expectedNode.entry.loadAddress ||
+                node.entry.executionAddress != expectedNode.entry.executionAddress ||
+                node.entry.length != expectedNode.entry.length ||
+                node.entry.startSector != expectedNode.entry.startSector) return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,51 @@
+/************************************************************************
+
+    tst_adfscataloguescanner.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef TST_ADFSCATALOGUESCANNER_H
+#define TST_ADFSCATALOGUESCANNER_H
+
+#include <QtTest>
+
+#include "adfscatalogue.h"
+
+// Parallel catalogue scans of the bundled test images, compared against a
+// scan on a single thread
+class TestAdfsCatalogueScanner : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void scanInParallel_data();
+    void scanInParallel();
+    void stopScan();
+
+private:
+    // Private methods
+    bool isSameCatalogue(const AdfsCatalogue &catalogue, const AdfsCatalogue &expectedCatalogue);
+};
+
+#endif // TST_ADFSCATALOGUESCANNER_H
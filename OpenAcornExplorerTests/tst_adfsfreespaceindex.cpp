@@ -0,0 +1,307 @@
+/************************************************************************
+
+    tst_adfsfreespaceindex.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "tst_adfsfreespaceindex.h"
+
+#include "discimage.h"
+#include "discimageprober.h"
+#include "adfsimage.h"
+
+Q_DECLARE_METATYPE(AdfsFreeSpaceIndex::AllocationPolicy)
+
+// Number of sectors on the hand-built disc
+static const qint64 testDiscSectors = 640;
+
+void TestAdfsFreeSpaceIndex::buildFromImage_data()
+{
+    QTest::addColumn<QString>("filename");
+
+    QTest::newRow("S") << QFINDTESTDATA("../ADFS Test images/ADFS S 160K.adf");
+    QTest::newRow("M") << QFINDTESTDATA("../ADFS Test images/ADFS M 320K.adf");
+    QTest::newRow("L") << QFINDTESTDATA("../ADFS Test images/ADFS L 640K.adl");
+    QTest::newRow("L stress") << QFINDTESTDATA("../ADFS Test images/ADFS L 640K Stress.adl");
+}
+
+// The index of a bundled old map image holds the same free sectors as the map
+void TestAdfsFreeSpaceIndex::buildFromImage()
+{
+    QFETCH(QString, filename);
+    QVERIFY(!filename.isEmpty());
+
+    DiscImageProber discImageProber;
+    QVERIFY(discImageProber.probe(filename));
+    DiscImage discImage(filename, DiscImage::FileAccess, discImageProber.getBestFormat());
+    AdfsImage adfsImage(&discImage);
+    QVERIFY(adfsImage.isValid());
+    QCOMPARE(adfsImage.getMapType(), AdfsImage::OldMap);
+
+    AdfsFreeSpaceIndex freeSpaceIndex;
+    QVERIFY(freeSpaceIndex.build(adfsImage.getFreeSpaceMap()));
+    QVERIFY(isSameAsScan(freeSpaceIndex, scanFreeSectors(adfsImage.getFreeSpaceMap())));
+}
+
+// Free space entries that are adjacent in the map become a single extent
+void TestAdfsFreeSpaceIndex::mergeAdjacentEntries()
+{
+    QMap<qint64, qint64> freeSpaceEntries;
+    freeSpaceEntries.insert(10, 5);
+    freeSpaceEntries.insert(15, 5);
+    freeSpaceEntries.insert(20, 1);
+    freeSpaceEntries.insert(30, 2);
+
+    AdfsFreeSpaceMap freeSpaceMap;
+    QVERIFY(freeSpaceMap.setMap(createMap(testDiscSectors, freeSpaceEntries)));
+
+    AdfsFreeSpaceIndex freeSpaceIndex;
+    QVERIFY(freeSpaceIndex.build(&freeSpaceMap));
+    QCOMPARE(freeSpaceIndex.getNumberOfFreeExtents(), Q_INT64_C(2));
+    QCOMPARE(freeSpaceIndex.getFreeExtents().value(10), Q_INT64_C(11));
+    QCOMPARE(freeSpaceIndex.getLargestFreeExtent(), Q_INT64_C(11));
+    QVERIFY(isSameAsScan(freeSpaceIndex, scanFreeSectors(&freeSpaceMap)));
+}
+
+// A map with overlapping entries is not valid, and leaves the index empty
+void TestAdfsFreeSpaceIndex::rejectOverlappingEntries()
+{
+    QMap<qint64, qint64> freeSpaceEntries;
+    freeSpaceEntries.insert(10, 8);
+    freeSpaceEntries.insert(15, 5);
+
+    AdfsFreeSpaceMap freeSpaceMap;
+    QVERIFY(freeSpaceMap.setMap(createMap(testDiscSectors, freeSpaceEntries)));
+
+    AdfsFreeSpaceIndex freeSpaceIndex;
+    QVERIFY(!freeSpaceIndex.build(&freeSpaceMap));
+    QCOMPARE(freeSpaceIndex.getNumberOfFreeExtents(), Q_INT64_C(0));
+    QCOMPARE(freeSpaceIndex.getFreeSectors(), Q_INT64_C(0));
+}
+
+void TestAdfsFreeSpaceIndex::allocateAndFree_data()
+{
+    QTest::addColumn<AdfsFreeSpaceIndex::AllocationPolicy>("policy");
+
+    QTest::newRow("first fit") << AdfsFreeSpaceIndex::FirstFit;
+    QTest::newRow("best fit") << AdfsFreeSpaceIndex::BestFit;
+}
+
+// A sequence of allocations and frees (of varying sizes) gives the same
+// sectors as a linear search of the free sectors, and the index written back
+// to the map gives the same free sectors again
+void TestAdfsFreeSpaceIndex::allocateAndFree()
+{
+    QFETCH(AdfsFreeSpaceIndex::AllocationPolicy, policy);
+
+    // Free extents of different lengths, so the policies choose differently
+    QMap<qint64, qint64> freeSpaceEntries;
+    for (qint64 entry = 0; entry < 16; entry++) freeSpaceEntries.insert(entry * 40, 1 + (entry * 7) % 24);
+
+    AdfsFreeSpaceMap freeSpaceMap;
+    QVERIFY(freeSpaceMap.setMap(createMap(testDiscSectors, freeSpaceEntries)));
+    QVector<bool> freeSectors = scanFreeSectors(&freeSpaceMap);
+
+    AdfsFreeSpaceIndex freeSpaceIndex;
+    QVERIFY(freeSpaceIndex.build(&freeSpaceMap));
+    QVERIFY(isSameAsScan(freeSpaceIndex, freeSectors));
+
+    // Allocations made, as start sector -> length (a simple generator keeps the
+    // sequence the same on every run)
+    QMap<qint64, qint64> allocations;
+    quint32 seed = 12345;
+
+    for (qint64 step = 0; step < 400; step++) {
+        seed = seed * 1103515245 + 12345;
+        qint64 numberOfSectors = 1 + (seed >> 16) % 20;
+
+        if ((seed >> 8) % 3 != 0 || allocations.isEmpty()) {
+            qint64 expectedSector = findFreeRun(freeSectors, numberOfSectors, policy);
+            qint64 startSector = freeSpaceIndex.allocate(numberOfSectors, policy);
+            QCOMPARE(startSector, expectedSector);
+
+            if (startSector >= 0) {
+                for (qint64 sector = startSector; sector < startSector + numberOfSectors; sector++) freeSectors[sector] = false;
+                allocations.insert(startSector, numberOfSectors);
+            }
+        } else {
+            qint64 startSector = allocations.keys().at(static_cast<int>((seed >> 12) % allocations.size()));
+            qint64 length = allocations.take(startSector);
+            QVERIFY(freeSpaceIndex.free(startSector, length));
+
+            for (qint64 sector = startSector; sector < startSector + length; sector++) freeSectors[sector] = true;
+        }
+
+        QVERIFY2(isSameAsScan(freeSpaceIndex, freeSectors), qPrintable(QString("Step %1").arg(step)));
+    }
+
+    QVERIFY(freeSpaceIndex.writeToMap(&freeSpaceMap));
+    AdfsFreeSpaceMap writtenMap;
+    QVERIFY(writtenMap.setMap(freeSpaceMap.getMap()));
+    QCOMPARE(scanFreeSectors(&writtenMap), freeSectors);
+}
+
+// Freeing the sectors between two extents merges all three into one extent,
+// and sectors that are already free cannot be freed again
+void TestAdfsFreeSpaceIndex::freeMergesNeighbours()
+{
+    QMap<qint64, qint64> freeSpaceEntries;
+    freeSpaceEntries.insert(100, 10);
+    freeSpaceEntries.insert(120, 10);
+
+    AdfsFreeSpaceMap freeSpaceMap;
+    QVERIFY(freeSpaceMap.setMap(createMap(testDiscSectors, freeSpaceEntries)));
+    AdfsFreeSpaceIndex freeSpaceIndex;
+    QVERIFY(freeSpaceIndex.build(&freeSpaceMap));
+
+    QVERIFY(!freeSpaceIndex.free(105, 10));
+    QVERIFY(!freeSpaceIndex.free(115, 10));
+    QVERIFY(!freeSpaceIndex.free(testDiscSectors - 5, 10));
+    QCOMPARE(freeSpaceIndex.getFreeSectors(), Q_INT64_C(20));
+
+    QVERIFY(freeSpaceIndex.free(110, 10));
+    QCOMPARE(freeSpaceIndex.getNumberOfFreeExtents(), Q_INT64_C(1));
+    QCOMPARE(freeSpaceIndex.getFreeExtents().value(100), Q_INT64_C(30));
+    QCOMPARE(freeSpaceIndex.getLargestFreeExtent(), Q_INT64_C(30));
+    QVERIFY(freeSpaceIndex.isFree(100));
+    QVERIFY(freeSpaceIndex.isFree(129));
+    QVERIFY(!freeSpaceIndex.isFree(130));
+
+    // The merged extent is the largest, and the only one that fits
+    QCOMPARE(freeSpaceIndex.allocate(25, AdfsFreeSpaceIndex::BestFit), Q_INT64_C(100));
+    QCOMPARE(freeSpaceIndex.getFreeExtents().value(125), Q_INT64_C(5));
+}
+
+// A free that needs a new extent fails when the map's free space list is full,
+// but a free that merges with an existing extent does not
+void TestAdfsFreeSpaceIndex::freeWhenMapIsFull()
+{
+    AdfsFreeSpaceMap freeSpaceMap;
+    QMap<qint64, qint64> freeSpaceEntries;
+    for (qint64 entry = 0; entry < freeSpaceMap.getMaximumFreeSpaceEntries(); entry++) freeSpaceEntries.insert(entry * 4, 2);
+    QVERIFY(freeSpaceMap.setMap(createMap(testDiscSectors, freeSpaceEntries)));
+
+    AdfsFreeSpaceIndex freeSpaceIndex;
+    QVERIFY(freeSpaceIndex.build(&freeSpaceMap));
+    QCOMPARE(freeSpaceIndex.getNumberOfFreeExtents(), freeSpaceMap.getMaximumFreeSpaceEntries());
+
+    QVERIFY(!freeSpaceIndex.free(testDiscSectors - 1, 1));
+    QVERIFY(freeSpaceIndex.free(2, 1));
+    QCOMPARE(freeSpaceIndex.getFreeExtents().value(0), Q_INT64_C(3));
+}
+
+// Private methods ----------------------------------------------------------------------------------------------------
+
+// Create the two sectors of an old map with the given free space entries
+QByteArray TestAdfsFreeSpaceIndex::createMap(qint64 totalSectors, const QMap<qint64, qint64> &freeSpaceEntries)
+{
+    // Bytes 252-254 of sector 0 hold the number of sectors on the disc
+    QByteArray mapData(512, 0);
+    mapData[252] = static_cast<char>(totalSectors & 0xFF);
+    mapData[253] = static_cast<char>((totalSectors >> 8) & 0xFF);
+    mapData[254] = static_cast<char>((totalSectors >> 16) & 0xFF);
+
+    // The free space entries (and the checksums) are written by the map itself
+    AdfsFreeSpaceMap freeSpaceMap;
+    freeSpaceMap.setMap(mapData);
+    freeSpaceMap.setFreeSpaceEntries(freeSpaceEntries);
+
+    return freeSpaceMap.getMap();
+}
+
+// Mark the free sectors on the disc by scanning every entry in the map
+QVector<bool> TestAdfsFreeSpaceIndex::scanFreeSectors(AdfsFreeSpaceMap *freeSpaceMap)
+{
+    QVector<bool> freeSectors(static_cast<int>(freeSpaceMap->getTotalSectorsOnDisc()), false);
+
+    for (qint64 freeSpaceNumber = 0; freeSpaceNumber < freeSpaceMap->getNumberOfFreeSpaceEntries(); freeSpaceNumber++) {
+        qint64 startSector = freeSpaceMap->getFreeSpaceStartSector(freeSpaceNumber);
+        for (qint64 sector = startSector; sector < startSector + freeSpaceMap->getFreeSpaceLength(freeSpaceNumber); sector++) {
+            freeSectors[static_cast<int>(sector)] = true;
+        }
+    }
+
+    return freeSectors;
+}
+
+// Get the runs of free sectors (start sector -> length)
+QMap<qint64, qint64> TestAdfsFreeSpaceIndex::getFreeRuns(const QVector<bool> &freeSectors)
+{
+    QMap<qint64, qint64> freeRuns;
+
+    qint64 sector = 0;
+    while (sector < freeSectors.size()) {
+        if (!freeSectors.at(sector)) {
+            sector++;
+            continue;
+        }
+
+        qint64 startSector = sector;
+        while (sector < freeSectors.size() && freeSectors.at(sector)) sector++;
+        freeRuns.insert(startSector, sector - startSector);
+    }
+
+    return freeRuns;
+}
+
+// Find a run of free sectors by searching every run; -1 if none is large enough
+qint64 TestAdfsFreeSpaceIndex::findFreeRun(const QVector<bool> &freeSectors, qint64 numberOfSectors, AdfsFreeSpaceIndex::AllocationPolicy policy)
+{
+    qint64 foundSector = -1;
+    qint64 foundLength = 0;
+
+    QMap<qint64, qint64> freeRuns = getFreeRuns(freeSectors);
+    for (QMap<qint64, qint64>::const_iterator i = freeRuns.constBegin(); i != freeRuns.constEnd(); ++i) {
+        if (i.value() < numberOfSectors) continue;
+
+        if (policy == AdfsFreeSpaceIndex::FirstFit) return i.key();
+        if (foundSector < 0 || i.value() < foundLength) {
+            foundSector = i.key();
+            foundLength = i.value();
+        }
+    }
+
+    return foundSector;
+}
+
+// Compare the index with the free sectors found by a linear scan
+bool TestAdfsFreeSpaceIndex::isSameAsScan(const AdfsFreeSpaceIndex &freeSpaceIndex, const QVector<bool> &freeSectors)
+{
+    QMap<qint64, qint64> freeRuns = getFreeRuns(freeSectors);
+    if (freeSpaceIndex.getFreeExtents() != freeRuns) return false;
+
+    qint64 largestRun = 0;
+    qint64 totalFree = 0;
+    for (qint64 length : freeRuns) {
+        largestRun = qMax(largestRun, length);
+        totalFree += length;
+    }
+    if (freeSpaceIndex.getLargestFreeExtent() != largestRun || freeSpaceIndex.getFreeSectors() != totalFree) return false;
+
+    for (qint64 sector = 0; sector < freeSectors.size(); sector++) {
+        if (freeSpaceIndex.isFree(sector) != freeSectors.at(sector)) return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,60 @@
+/************************************************************************
+
+    tst_adfsfreespaceindex.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef TST_ADFSFREESPACEINDEX_H
+#define TST_ADFSFREESPACEINDEX_H
+
+#include <QtTest>
+
+#include "adfsfreespaceindex.h"
+
+// Allocating, freeing and merging free extents with the free space index,
+// checked against a linear scan of the sectors marked free by the old map
+class TestAdfsFreeSpaceIndex : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void buildFromImage_data();
+    void buildFromImage();
+    void mergeAdjacentEntries();
+    void rejectOverlappingEntries();
+    void allocateAndFree_data();
+    void allocateAndFree();
+    void freeMergesNeighbours();
+    void freeWhenMapIsFull();
+
+private:
+    // Private methods
+    QByteArray createMap(qint64 totalSectors, const QMap<qint64, qint64> &freeSpaceEntries);
+    QVector<bool> scanFreeSectors(AdfsFreeSpaceMap *freeSpaceMap);
+    QMap<qint64, qint64> getFreeRuns(const QVector<bool> &freeSectors);
+    qint64 findFreeRun(const QVector<bool> &freeSectors, qint64 numberOfSectors, AdfsFreeSpaceIndex::AllocationPolicy policy);
+    bool isSameAsScan(const AdfsFreeSpaceIndex &freeSpaceIndex, const QVector<bool> &freeSectors);
+};
+
+#endif // TST_ADFSFREESPACEINDEX_H
@@ -0,0 +1,216 @@
+/************************************************************************
+
+    tst_adfsnewmap.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "tst_adfsnewmap.h"
+
+// The map has one 256 byte zone with the minimum zone spare, 15 bit fragment
+// ids and 128 bytes per map bit.  The bitstream follows the 4 byte zone header
+// and the 60 byte disc record, and covers a disc of 200 map bits
+static const qint64 bitstreamStart = 64 * 8;
+static const qint64 bytesPerMapBit = 128;
+static const qint64 discMapBits = 200;
+
+Q_DECLARE_METATYPE(QVector<AdfsDiscExtent>)
+
+// Build the map's zone (fragments are given as map bit, length in map bits
+// and fragment id)
+void TestAdfsNewMap::initTestCase()
+{
+    mapData = QByteArray(256, 0);
+
+    // Disc record: sector size, id length, bytes per map bit, zones, zone spare
+    // and disc size
+    qint64 discSize = discMapBits * bytesPerMapBit;
+    mapData[4 + 0] = 8;
+    mapData[4 + 4] = 15;
+    mapData[4 + 5] = 7;
+    mapData[4 + 9] = 1;
+    mapData[4 + 10] = 32;
+    mapData[4 + 16] = static_cast<char>(discSize & 0xFF);
+    mapData[4 + 17] = static_cast<char>((discSize >> 8) & 0xFF);
+    mapData[4 + 18] = static_cast<char>((discSize >> 16) & 0xFF);
+
+    // The map and root directory, an object in two fragments either side of
+    // free space and a one fragment object, followed by more free space.  Each
+    // free fragment's id is the offset to the next free fragment
+    addFragment(0, 32, 2);
+    addFragment(32, 32, 5);
+    addFragment(64, 32, 168 - 64);
+    addFragment(96, 40, 7);
+    addFragment(136, 32, 5);
+    addFragment(168, 32, 0);
+
+    // The zone header links to the first free fragment (from bit 8)
+    setBits(8, 15, static_cast<quint32>(bitstreamStart + 64 - 8));
+
+    // A single zone's cross check byte is &FF, and the check byte covers the
+    // rest of the zone
+    mapData[3] = static_cast<char>(0xFF);
+    mapData[0] = static_cast<char>(AdfsNewMap::calculateZoneCheck(mapData.constData(), mapData.size()));
+}
+
+// The fragments are indexed by id, and the parts of a fragmented object are
+// held in order
+void TestAdfsNewMap::fragmentIndex()
+{
+    AdfsNewMap newMap;
+    QVERIFY(newMap.setMap(mapData));
+
+    QCOMPARE(newMap.getNumberOfZones(), Q_INT64_C(1));
+    QCOMPARE(newMap.getIdLength(), Q_INT64_C(15));
+    QCOMPARE(newMap.getBytesPerMapBit(), bytesPerMapBit);
+    QCOMPARE(newMap.getDiscSize(), discMapBits * bytesPerMapBit);
+    QCOMPARE(newMap.getMapPosition(), Q_INT64_C(0));
+
+    QCOMPARE(newMap.getNumberOfFragments(), Q_INT64_C(3));
+    QCOMPARE(newMap.getNumberOfFragmentExtents(), Q_INT64_C(4));
+
+    QVector<AdfsDiscExtent> extents = newMap.getFragmentExtents(5);
+    QCOMPARE(extents.size(), 2);
+    QCOMPARE(extents.at(0).bytePosition, 32 * bytesPerMapBit);
+    QCOMPARE(extents.at(0).length, 32 * bytesPerMapBit);
+    QCOMPARE(extents.at(1).bytePosition, 136 * bytesPerMapBit);
+    QCOMPARE(extents.at(1).length, 32 * bytesPerMapBit);
+
+    QCOMPARE(newMap.resolveAddress(2 << 8), Q_INT64_C(0));
+    QCOMPARE(newMap.resolveAddress(7 << 8), 96 * bytesPerMapBit);
+}
+
+void TestAdfsNewMap::objectExtents_data()
+{
+    QTest::addColumn<qint64>("indirectAddress");
+    QTest::addColumn<qint64>("length");
+    QTest::addColumn<QVector<AdfsDiscExtent> >("expectedExtents");
+
+    QTest::newRow("whole fragment")
+            << static_cast<qint64>(7 << 8) << 40 * bytesPerMapBit
+            << QVector<AdfsDiscExtent>({{96 * bytesPerMapBit, 40 * bytesPerMapBit}});
+    QTest::newRow("start of a fragment")
+            << static_cast<qint64>(7 << 8) << Q_INT64_C(1000)
+            << QVector<AdfsDiscExtent>({{96 * bytesPerMapBit, 1000}});
+    QTest::newRow("fragmented object")
+            << static_cast<qint64>(5 << 8) << 64 * bytesPerMapBit
+            << QVector<AdfsDiscExtent>({{32 * bytesPerMapBit, 32 * bytesPerMapBit}, {136 * bytesPerMapBit, 32 * bytesPerMapBit}});
+
+    // A shared object starts a multiple of the sector size into the fragment
+    // (here its second sector), and continues into the fragment's next part
+    QTest::newRow("shared object")
+            << static_cast<qint64>((5 << 8) | 2) << 32 * bytesPerMapBit
+            << QVector<AdfsDiscExtent>({{32 * bytesPerMapBit + 256, 32 * bytesPerMapBit - 256}, {136 * bytesPerMapBit, 256}});
+}
+
+void TestAdfsNewMap::objectExtents()
+{
+    QFETCH(qint64, indirectAddress);
+    QFETCH(qint64, length);
+    QFETCH(QVector<AdfsDiscExtent>, expectedExtents);
+
+    AdfsNewMap newMap;
+    QVERIFY(newMap.setMap(mapData));
+
+    QVector<AdfsDiscExtent> extents;
+    QVERIFY(newMap.getObjectExtents(indirectAddress, length, &extents));
+    QCOMPARE(extents.size(), expectedExtents.size());
+
+    qint64 extentsLength = 0;
+    for (qint64 extentNumber = 0; extentNumber < extents.size(); extentNumber++) {
+        QCOMPARE(extents.at(extentNumber).bytePosition, expectedExtents.at(extentNumber).bytePosition);
+        QCOMPARE(extents.at(extentNumber).length, expectedExtents.at(extentNumber).length);
+        extentsLength += extents.at(extentNumber).length;
+    }
+    QCOMPARE(extentsLength, length);
+}
+
+// Objects in fragments that are not in the map, or that are longer than their
+// fragment, have no extents
+void TestAdfsNewMap::missingAndShortFragments()
+{
+    AdfsNewMap newMap;
+    QVERIFY(newMap.setMap(mapData));
+
+    QVector<AdfsDiscExtent> extents;
+    QVERIFY(!newMap.getObjectExtents(9 << 8, 256, &extents));
+    QVERIFY(extents.isEmpty());
+    QVERIFY(!newMap.getObjectExtents(7 << 8, 40 * bytesPerMapBit + 1, &extents));
+    QVERIFY(extents.isEmpty());
+    QVERIFY(newMap.getFragmentExtents(9).isEmpty());
+    QCOMPARE(newMap.resolveAddress(9 << 8), Q_INT64_C(-1));
+}
+
+// The free fragments (found from the zone header's free link) are free space,
+// not fragments
+void TestAdfsNewMap::freeSpace()
+{
+    AdfsNewMap newMap;
+    QVERIFY(newMap.setMap(mapData));
+
+    QVector<AdfsDiscExtent> freeExtents = newMap.getFreeExtents();
+    QCOMPARE(freeExtents.size(), 2);
+    QCOMPARE(freeExtents.at(0).bytePosition, 64 * bytesPerMapBit);
+    QCOMPARE(freeExtents.at(0).length, 32 * bytesPerMapBit);
+    QCOMPARE(freeExtents.at(1).bytePosition, 168 * bytesPerMapBit);
+    QCOMPARE(freeExtents.at(1).length, 32 * bytesPerMapBit);
+    QCOMPARE(newMap.getFreeBytes(), 64 * bytesPerMapBit);
+
+    QVERIFY(newMap.getFragmentExtents(168 - 64).isEmpty());
+}
+
+// A zone with an incorrect check byte is rejected, leaving the index empty
+void TestAdfsNewMap::rejectInvalidZoneCheck()
+{
+    QByteArray corruptMapData = mapData;
+    corruptMapData[0] = static_cast<char>(corruptMapData.at(0) ^ 0x01);
+
+    AdfsNewMap newMap;
+    QVERIFY(!newMap.setMap(corruptMapData));
+    QCOMPARE(newMap.getNumberOfFragments(), Q_INT64_C(0));
+    QCOMPARE(newMap.getFreeBytes(), Q_INT64_C(0));
+}
+
+// Private methods ----------------------------------------------------------------------------------------------------
+
+// Write a number of bits to the map, least significant bit first
+void TestAdfsNewMap::setBits(qint64 bitPosition, qint64 numberOfBits, quint32 value)
+{
+    for (qint64 bit = 0; bit < numberOfBits; bit++) {
+        int byte = static_cast<int>((bitPosition + bit) >> 3);
+        char mask = static_cast<char>(1 << ((bitPosition + bit) & 7));
+
+        if ((value >> bit) & 1) mapData[byte] = static_cast<char>(mapData.at(byte) | mask);
+        else mapData[byte] = static_cast<char>(mapData.at(byte) & ~mask);
+    }
+}
+
+// Write a fragment: its id, then zero bits terminated by a one bit
+void TestAdfsNewMap::addFragment(qint64 mapBit, qint64 numberOfBits, quint32 fragmentId)
+{
+    qint64 bitPosition = bitstreamStart + mapBit;
+
+    setBits(bitPosition, 15, fragmentId);
+    setBits(bitPosition + 15, numberOfBits - 16, 0);
+    setBits(bitPosition + numberOfBits - 1, 1, 1);
+}
@@ -0,0 +1,59 @@
+/************************************************************************
+
+    tst_adfsnewmap.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef TST_ADFSNEWMAP_H
+#define TST_ADFSNEWMAP_H
+
+#include <QtTest>
+
+#include "adfsnewmap.h"
+
+// The fragment index of a small hand-built single zone E format map: the
+// extents of each object (including a fragmented and a shared object) and
+// the free space
+class TestAdfsNewMap : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void fragmentIndex();
+    void objectExtents_data();
+    void objectExtents();
+    void missingAndShortFragments();
+    void freeSpace();
+    void rejectInvalidZoneCheck();
+
+private:
+    QByteArray mapData;
+
+    // Private methods
+    void setBits(qint64 bitPosition, qint64 numberOfBits, quint32 value);
+    void addFragment(qint64 mapBit, qint64 numberOfBits, quint32 fragmentId);
+};
+
+#endif // TST_ADFSNEWMAP_H
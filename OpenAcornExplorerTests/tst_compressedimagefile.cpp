@@ -0,0 +1,198 @@
+/************************************************************************
+
+    tst_compressedimagefile.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "tst_compressedimagefile.h"
+
+#include <QStandardPaths>
+#include <QtEndian>
+
+#include <zlib.h>
+
+#include "compressedimagefile.h"
+
+// Size of each read, and of the test image
+static const qint64 readSize = 1024;
+static const qint64 imageSize = 4 * 1024 * 1024;
+
+void TestCompressedImageFile::initTestCase()
+{
+    // Keep the checkpoint index cache away from the user's own
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(temporaryDirectory.isValid());
+
+    // Random words from a small vocabulary compress into many short deflate
+    // blocks, so reads restart from both kinds of checkpoint
+    quint32 seed = 1;
+    auto nextRandom = [&seed]() {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) & 0x7FFF;
+    };
+
+    QVector<QByteArray> words;
+    for (qint64 wordNumber = 0; wordNumber < 3000; wordNumber++) {
+        QByteArray word;
+        qint64 wordLength = 2 + nextRandom() % 8;
+        for (qint64 letter = 0; letter < wordLength; letter++) word.append(static_cast<char>('a' + nextRandom() % 10));
+        words.append(word);
+    }
+
+    image.reserve(static_cast<int>(imageSize + 16));
+    while (image.size() < imageSize) {
+        image.append(words[static_cast<int>(nextRandom() % words.size())]);
+        image.append(' ');
+    }
+    image.resize(static_cast<int>(imageSize));
+
+    // Read at offsets spread throughout the image
+    for (qint64 offset = 0; offset + readSize <= imageSize; offset += (imageSize / 97) & ~255) offsets.append(offset);
+}
+
+// Read the same offsets forwards through the first half of the image, then
+// backwards, then forwards through the whole image (going back to the start
+// between each read so that every read restarts from a checkpoint).  The
+// checkpoints added along the way are saved in the index cache when the file
+// is closed; reading again with only those checkpoints must give the same data
+void TestCompressedImageFile::readGzipForwardsBackwardsForwards()
+{
+    QString filename = temporaryDirectory.path() + "/image.adl.gz";
+    QVERIFY(writeGzip(filename));
+
+    CompressedImageFile imageFile(filename);
+    QVERIFY(imageFile.open(QIODevice::ReadOnly));
+    QCOMPARE(imageFile.size(), imageSize);
+
+    for (qint64 offset : offsets) {
+        if (offset < imageSize / 2) QVERIFY2(readAndCompare(&imageFile, offset), qPrintable(QString::number(offset)));
+    }
+
+    for (qint64 index = offsets.size() - 1; index >= 0; index--) {
+        if (offsets[index] < imageSize / 2) QVERIFY2(readAndCompare(&imageFile, offsets[index]), qPrintable(QString::number(offsets[index])));
+    }
+
+    for (qint64 offset : offsets) {
+        QVERIFY(readAndCompare(&imageFile, 0));
+        QVERIFY2(readAndCompare(&imageFile, offset), qPrintable(QString::number(offset)));
+    }
+
+    QVERIFY(imageFile.getStatistics().checkpoints > 1);
+    imageFile.close();
+
+    // Reopen with the saved index
+    QVERIFY(imageFile.open(QIODevice::ReadOnly));
+    QVERIFY(imageFile.getStatistics().indexLoaded);
+
+    for (qint64 index = offsets.size() - 1; index >= 0; index--) {
+        QVERIFY2(readAndCompare(&imageFile, offsets[index]), qPrintable(QString::number(offsets[index])));
+    }
+
+    imageFile.close();
+}
+
+// Stored (uncompressed) zip members are read directly
+void TestCompressedImageFile::readStoredZipMember()
+{
+    QString filename = temporaryDirectory.path() + "/archive.zip";
+    QVERIFY(writeStoredZip(filename, "image.adl"));
+
+    CompressedImageFile imageFile(filename + "#image.adl");
+    QVERIFY(imageFile.open(QIODevice::ReadOnly));
+    QCOMPARE(imageFile.size(), imageSize);
+
+    for (qint64 offset : offsets) QVERIFY(readAndCompare(&imageFile, offset));
+    for (qint64 index = offsets.size() - 1; index >= 0; index--) QVERIFY(readAndCompare(&imageFile, offsets[index]));
+
+    imageFile.close();
+}
+
+// Private methods ----------------------------------------------------------------------------------------------------
+
+// Read from the device at an offset and compare with the uncompressed image
+bool TestCompressedImageFile::readAndCompare(QIODevice *device, qint64 offset)
+{
+    if (!device->seek(offset)) return false;
+
+    QByteArray data = device->read(readSize);
+    return data == image.mid(static_cast<int>(offset), static_cast<int>(readSize));
+}
+
+bool TestCompressedImageFile::writeGzip(const QString &filename)
+{
+    gzFile gzipFile = gzopen(QFile::encodeName(filename).constData(), "wb");
+    if (gzipFile == nullptr) return false;
+
+    bool success = gzwrite(gzipFile, image.constData(), static_cast<unsigned>(image.size())) == image.size();
+    return (gzclose(gzipFile) == Z_OK) && success;
+}
+
+// Write a zip archive holding the image as a single stored member
+bool TestCompressedImageFile::writeStoredZip(const QString &filename, const QString &memberName)
+{
+    QByteArray name = memberName.toLatin1();
+    quint32 crc = static_cast<quint32>(crc32(0, reinterpret_cast<const Bytef *>(image.constData()),
+                                             static_cast<uInt>(image.size())));
+
+    // Fields shared by the local header and the central directory entry
+    // (version needed, flags, method, time, date, CRC, sizes and name length)
+    QByteArray commonFields(22, 0);
+    uchar *common = reinterpret_cast<uchar *>(commonFields.data());
+    qToLittleEndian<quint16>(20, common);
+    qToLittleEndian<quint32>(crc, common + 10);
+    qToLittleEndian<quint32>(static_cast<quint32>(image.size()), common + 14);
+    qToLittleEndian<quint32>(static_cast<quint32>(image.size()), common + 18);
+
+    QByteArray localHeader(4, 0);
+    qToLittleEndian<quint32>(0x04034b50, reinterpret_cast<uchar *>(localHeader.data()));
+    localHeader += commonFields;
+    localHeader += QByteArray(4, 0);
+    qToLittleEndian<quint16>(static_cast<quint16>(name.size()), reinterpret_cast<uchar *>(localHeader.data()) + 26);
+    localHeader += name;
+
+    QByteArray directoryEntry(6, 0);
+    qToLittleEndian<quint32>(0x02014b50, reinterpret_cast<uchar *>(directoryEntry.data()));
+    qToLittleEndian<quint16>(20, reinterpret_cast<uchar *>(directoryEntry.data()) + 4);
+    directoryEntry += commonFields;
+    directoryEntry += QByteArray(18, 0);
+    qToLittleEndian<quint16>(static_cast<quint16>(name.size()), reinterpret_cast<uchar *>(directoryEntry.data()) + 28);
+    directoryEntry += name;
+
+    qint64 directoryPosition = localHeader.size() + image.size();
+    QByteArray endRecord(22, 0);
+    uchar *end = reinterpret_cast<uchar *>(endRecord.data());
+    qToLittleEndian<quint32>(0x06054b50, end);
+    qToLittleEndian<quint16>(1, end + 8);
+    qToLittleEndian<quint16>(1, end + 10);
+    qToLittleEndian<quint32>(static_cast<quint32>(directoryEntry.size()), end + 12);
+    qToLittleEndian<quint32>(static_cast<quint32>(directoryPosition), end + 16);
+
+    QFile zipFile(filename);
+    if (!zipFile.open(QIODevice::WriteOnly)) return false;
+
+    bool success = zipFile.write(localHeader) == localHeader.size() && zipFile.write(image) == image.size() &&
+            zipFile.write(directoryEntry) == directoryEntry.size() && zipFile.write(endRecord) == endRecord.size();
+    zipFile.close();
+    return success;
+}
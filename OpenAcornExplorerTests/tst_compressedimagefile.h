@@ -0,0 +1,56 @@
+/************************************************************************
+
+    tst_compressedimagefile.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef TST_COMPRESSEDIMAGEFILE_H
+#define TST_COMPRESSEDIMAGEFILE_H
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+// Random access reads from gzip and zip compressed images, compared against
+// the uncompressed image
+class TestCompressedImageFile : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void readGzipForwardsBackwardsForwards();
+    void readStoredZipMember();
+
+private:
+    QTemporaryDir temporaryDirectory;
+    QByteArray image;
+    QVector<qint64> offsets;
+
+    // Private methods
+    bool readAndCompare(QIODevice *device, qint64 offset);
+    bool writeGzip(const QString &filename);
+    bool writeStoredZip(const QString &filename, const QString &memberName);
+};
+
+#endif // TST_COMPRESSEDIMAGEFILE_H
@@ -0,0 +1,194 @@
+/************************************************************************
+
+    tst_discimage.cpp
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#include "tst_discimage.h"
+
+#include "discimage.h"
+
+Q_DECLARE_METATYPE(DiscImage::AccessMode)
+Q_DECLARE_METATYPE(DiscImage::CommitMode)
+
+// Sectors written by the tests (two adjacent sectors and one further on)
+static const qint64 firstSector = 10;
+static const qint64 otherSector = 300;
+
+void TestDiscImage::initTestCase()
+{
+    QVERIFY(temporaryDirectory.isValid());
+
+    originalFilename = QFINDTESTDATA("../ADFS Test images/ADFS S 160K.adf");
+    QVERIFY(!originalFilename.isEmpty());
+    filename = temporaryDirectory.path() + "/image.adf";
+}
+
+// Each test writes to a fresh copy of the image
+void TestDiscImage::init()
+{
+    QFile::remove(filename);
+    QVERIFY(QFile::copy(originalFilename, filename));
+    QVERIFY(QFile::setPermissions(filename, QFile::ReadOwner | QFile::WriteOwner));
+}
+
+void TestDiscImage::writeReadBackCommit_data()
+{
+    QTest::addColumn<DiscImage::AccessMode>("accessMode");
+    QTest::addColumn<DiscImage::CommitMode>("commitMode");
+
+    QTest::newRow("file, in place") << DiscImage::FileAccess << DiscImage::InPlaceCommit;
+    QTest::newRow("file, safe") << DiscImage::FileAccess << DiscImage::SafeCommit;
+    QTest::newRow("mapped, in place") << DiscImage::MappedAccess << DiscImage::InPlaceCommit;
+    QTest::newRow("mapped, safe") << DiscImage::MappedAccess << DiscImage::SafeCommit;
+}
+
+// Written sectors are read back (but not written to the file) until they are
+// committed; after the commit the image and the file both hold them
+void TestDiscImage::writeReadBackCommit()
+{
+    QFETCH(DiscImage::AccessMode, accessMode);
+    QFETCH(DiscImage::CommitMode, commitMode);
+
+    DiscImage discImage(filename, accessMode);
+    QVERIFY(discImage.isValid());
+    QVERIFY(!discImage.isReadOnly());
+    QCOMPARE(discImage.isMapped(), accessMode == DiscImage::MappedAccess);
+
+    qint64 sectorSize = discImage.getSectorSize();
+    QByteArray originalData = discImage.readSector(firstSector - 1, 4);
+    QByteArray newData = getSectorPattern(2 * sectorSize, 1);
+    QByteArray otherData = getSectorPattern(sectorSize, 2);
+
+    QVERIFY(discImage.writeSector(firstSector, 2, newData.constData()));
+    QVERIFY(discImage.writeSector(otherSector, otherData));
+    QVERIFY(discImage.isModified());
+    QCOMPARE(discImage.getNumberOfModifiedSectors(), Q_INT64_C(3));
+
+    // The modified sectors are read back in place of the image's own, and are
+    // never viewed directly in the mapped image
+    QByteArray expectedData = originalData;
+    expectedData.replace(static_cast<int>(sectorSize), newData.size(), newData);
+    QCOMPARE(discImage.readSector(firstSector - 1, 4), expectedData);
+    QCOMPARE(discImage.readSector(otherSector), otherData);
+    QVERIFY(discImage.getSectorView(firstSector).isNull());
+
+    // Nothing is written to the file before the commit
+    {
+        DiscImage fileImage(filename, DiscImage::FileAccess);
+        QCOMPARE(fileImage.readSector(firstSector - 1, 4), originalData);
+    }
+
+    QVERIFY(discImage.commit(commitMode));
+    QVERIFY(!discImage.isModified());
+    QCOMPARE(discImage.getNumberOfModifiedSectors(), Q_INT64_C(0));
+    QVERIFY(discImage.isValid());
+    QCOMPARE(discImage.isMapped(), accessMode == DiscImage::MappedAccess);
+    QVERIFY(discImage.getIoStatistics().sectorsWritten >= 3);
+
+    // The image (including a remapped image) and the file hold the new data
+    QCOMPARE(discImage.readSector(firstSector - 1, 4), expectedData);
+    QCOMPARE(discImage.readSector(otherSector), otherData);
+    if (accessMode == DiscImage::MappedAccess) {
+        DiscSectorView sectorView = discImage.getSectorView(firstSector, 2);
+        QVERIFY(!sectorView.isNull());
+        QCOMPARE(sectorView.toRawByteArray(), newData);
+    }
+
+    DiscImage fileImage(filename, DiscImage::FileAccess);
+    QCOMPARE(fileImage.readSector(firstSector - 1, 4), expectedData);
+    QCOMPARE(fileImage.readSector(otherSector), otherData);
+}
+
+// Discarded sectors are neither read back nor committed
+void TestDiscImage::discardChanges()
+{
+    DiscImage discImage(filename, DiscImage::MappedAccess);
+    QVERIFY(discImage.isValid());
+
+    QByteArray originalData = discImage.readSector(firstSector);
+    QVERIFY(discImage.writeSector(firstSector, getSectorPattern(discImage.getSectorSize(), 3)));
+    discImage.discardChanges();
+
+    QVERIFY(!discImage.isModified());
+    QCOMPARE(discImage.readSector(firstSector), originalData);
+    QVERIFY(discImage.commit(DiscImage::SafeCommit));
+
+    DiscImage fileImage(filename, DiscImage::FileAccess);
+    QCOMPARE(fileImage.readSector(firstSector), originalData);
+}
+
+// A write that extends beyond the image is rejected as a whole
+void TestDiscImage::writeOutsideImage()
+{
+    DiscImage discImage(filename, DiscImage::FileAccess);
+    QVERIFY(discImage.isValid());
+
+    qint64 sectorSize = discImage.getSectorSize();
+    qint64 lastSector = QFileInfo(filename).size() / sectorSize - 1;
+
+    QVERIFY(!discImage.writeSector(lastSector, 2, getSectorPattern(2 * sectorSize, 4).constData()));
+    QVERIFY(!discImage.isModified());
+}
+
+// The sector cache reads whole tracks, but an image truncated part way through
+// its last track can still be read up to the end of the file
+void TestDiscImage::readTruncatedImage()
+{
+    qint64 sectorSize = 0;
+    qint64 numberOfSectors = 0;
+    QByteArray expectedData;
+    {
+        DiscImage fileImage(filename, DiscImage::FileAccess);
+        QVERIFY(fileImage.isValid());
+        sectorSize = fileImage.getSectorSize();
+        numberOfSectors = QFileInfo(filename).size() / sectorSize - 3;
+        expectedData = fileImage.readSector(numberOfSectors - 2, 2);
+    }
+
+    QFile imageFile(filename);
+    QVERIFY(imageFile.resize(numberOfSectors * sectorSize));
+
+    DiscImage discImage(filename, DiscImage::FileAccess);
+    QVERIFY(discImage.isValid());
+    discImage.setCacheSize(64 * 1024);
+
+    // Read twice, so that the second read would use any cached track
+    QCOMPARE(discImage.readSector(numberOfSectors - 2, 2), expectedData);
+    QCOMPARE(discImage.readSector(numberOfSectors - 2, 2), expectedData);
+
+    QByteArray sectorData(static_cast<int>(sectorSize), 0);
+    QVERIFY(!discImage.readSector(numberOfSectors, 1, sectorData.data()));
+}
+
+// Private methods ----------------------------------------------------------------------------------------------------
+
+QByteArray TestDiscImage::getSectorPattern(qint64 numberOfBytes, char seed)
+{
+    QByteArray pattern;
+    pattern.resize(static_cast<int>(numberOfBytes));
+    for (qint64 byte = 0; byte < numberOfBytes; byte++) pattern[static_cast<int>(byte)] = static_cast<char>(seed + byte * 7);
+
+    return pattern;
+}
@@ -0,0 +1,58 @@
+/************************************************************************
+
+    tst_discimage.h
+
+    OpenAcornExplorer - Acorn 8-bit and 32-bit disc image manipulation
+    Copyright (C) 2018 Simon Inns
+
+    This file is part of OpenAcornExplorer.
+
+    OpenAcornExplorer is free software: you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation, either version 3 of the
+    License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    Email: simon.inns@gmail.com
+
+************************************************************************/
+
+
+#ifndef TST_DISCIMAGE_H
+#define TST_DISCIMAGE_H
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+// Buffered sector writes, reading them back and committing them to a copy of
+// a bundled test image, with each access and commit mode
+class TestDiscImage : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void writeReadBackCommit_data();
+    void writeReadBackCommit();
+    void discardChanges();
+    void writeOutsideImage();
+    void readTruncatedImage();
+
+private:
+    QTemporaryDir temporaryDirectory;
+    QString originalFilename;
+    QString filename;
+
+    // Private methods
+    QByteArray getSectorPattern(qint64 numberOfBytes, char seed);
+};
+
+#endif // TST_DISCIMAGE_H